@@ -0,0 +1,391 @@
+// udpscope_bench：Core 热路径微基准
+//
+//   udpscope_bench [--filter SUBSTR] [--min-time SEC] [--out FILE]
+//
+// 每项重复运行直到累计耗时 >= min-time，输出一个 JSON 文档（默认 stdout），
+// 每条结果含 frames_per_s 与 ns_per_frame，便于不同构建、不同 CPU 之间对比。
+// “帧”指该项一次操作处理的单位：解包/环写入为 UDP 帧，扫描与包络为 (帧 × 通道)，平滑为样本点。
+// 请用 Release 构建运行（-DCMAKE_BUILD_TYPE=Release）。
+
+#include "Core.hpp"
+#include "Unpack.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string filter;
+    double      min_time = 0.3;
+    std::string out;
+};
+
+struct Result {
+    std::string name;
+    std::string params;      // 已格式化的 JSON 对象
+    uint64_t    iterations = 0;
+    double      frames_per_s = 0;
+    double      ns_per_frame = 0;
+};
+
+// 防止编译器把结果优化掉
+volatile uint64_t g_sink = 0;
+
+std::string cpu_model() {
+    FILE* f = std::fopen("/proc/cpuinfo", "r");
+    if (!f) return "unknown";
+    char line[512];
+    std::string model = "unknown";
+    while (std::fgets(line, sizeof(line), f)) {
+        if (std::strncmp(line, "model name", 10) != 0) continue;
+        const char* p = std::strchr(line, ':');
+        if (p) {
+            model = p + 1 + (p[1] == ' ');
+            while (!model.empty() && (model.back() == '\n' || model.back() == '"')) model.pop_back();
+        }
+        break;
+    }
+    std::fclose(f);
+    return model;
+}
+
+class Runner {
+public:
+    explicit Runner(const Options& opt) : opt_(opt) {}
+
+    // op 每次调用处理 frames_per_op 个“帧”
+    void run(const std::string& name, const std::string& params, double frames_per_op, const std::function<void()>& op) {
+        if (!opt_.filter.empty() && name.find(opt_.filter) == std::string::npos) return;
+        using clock = std::chrono::steady_clock;
+        op(); // 预热
+
+        uint64_t iters = 0;
+        const auto t0 = clock::now();
+        double elapsed = 0;
+        uint64_t batch = 1;
+        while (elapsed < opt_.min_time) {
+            for (uint64_t i = 0; i < batch; ++i) op();
+            iters += batch;
+            elapsed = std::chrono::duration<double>(clock::now() - t0).count();
+            if (elapsed < opt_.min_time / 10) batch *= 2;
+        }
+
+        Result r;
+        r.name = name;
+        r.params = params;
+        r.iterations = iters;
+        const double frames = frames_per_op * double(iters);
+        r.frames_per_s = frames / elapsed;
+        r.ns_per_frame = elapsed * 1e9 / frames;
+        results_.push_back(r);
+        // 同名项按参数区分，参数原样附在行尾（与 JSON 里的 params 相同）
+        std::fprintf(stderr, "%-40s %14.0f frames/s %10.2f ns/frame  %s\n", name.c_str(), r.frames_per_s, r.ns_per_frame,
+                     params.c_str());
+    }
+
+    void write_json(FILE* f) const {
+        std::fprintf(f, "{\n  \"cpu\": \"%s\",\n  \"unpack_kernel\": \"%s\",\n  \"compiler\": \"%s\",\n  \"results\": [\n",
+                     cpu_model().c_str(), unpack_kernel_name(), __VERSION__);
+        for (size_t i = 0; i < results_.size(); ++i) {
+            const Result& r = results_[i];
+            std::fprintf(f, "    {\"name\": \"%s\", \"params\": %s, \"iterations\": %llu, "
+                            "\"frames_per_s\": %.1f, \"ns_per_frame\": %.3f}%s\n",
+                         r.name.c_str(), r.params.c_str(), static_cast<unsigned long long>(r.iterations),
+                         r.frames_per_s, r.ns_per_frame, i + 1 < results_.size() ? "," : "");
+        }
+        std::fprintf(f, "  ]\n}\n");
+    }
+
+private:
+    Options opt_;
+    std::vector<Result> results_;
+};
+
+std::string params(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+std::string params(const char* fmt, ...) {
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    std::vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    return buf;
+}
+
+// 按打包格式设置一组自洽的 g_cfg（1024 样本/帧，8 字节头，11 字节尾）
+ParserConfig config_for(PackMode m, int samples = 1024) {
+    return parser_config_for(m, samples, 8, 11);
+}
+
+// 填满环：每通道一条不同周期的三角波加噪声，帧间隔 1/fps 秒
+void fill_ring(DecodedFrameRing& ring, uint64_t frames, double fps) {
+    const int spf = ring.samples_per_frame();
+    std::vector<uint16_t> f(static_cast<size_t>(spf));
+    std::minstd_rand rng(1);
+    const int64_t dt = static_cast<int64_t>(1e9 / fps);
+    for (uint64_t i = 0; i < frames; ++i) {
+        for (int c = 0; c < spf; ++c) {
+            const uint32_t ph = static_cast<uint32_t>((i * static_cast<uint64_t>(c + 1)) & 1023);
+            f[c] = static_cast<uint16_t>(100 + (ph < 512 ? ph : 1023 - ph) + (rng() & 31));
+        }
+        ring.push_frame(f.data(), static_cast<int64_t>(i) * dt);
+    }
+}
+
+void bench_unpack(Runner& r) {
+    constexpr int kFrames = 256; // 每次操作解一批，避免单帧计时被调用开销主导
+    const ParserConfig saved = g_cfg;
+    for (PackMode m : {PackMode::RAW10_PACKED, PackMode::RAW16_LE, PackMode::RAW16_BE, PackMode::RAW12_PACKED,
+                       PackMode::RAW14_PACKED, PackMode::MIPI_RAW10, PackMode::MIPI_RAW12}) {
+        g_cfg = config_for(m);
+        std::vector<uint8_t>  in(static_cast<size_t>(g_cfg.frame_size_bytes) * kFrames);
+        std::vector<uint16_t> out(static_cast<size_t>(g_cfg.samples_per_frame));
+        std::mt19937 rng(7);
+        for (auto& b : in) b = static_cast<uint8_t>(rng());
+
+        auto op = [&] {
+            for (int i = 0; i < kFrames; ++i)
+                unpack_payload(&in[static_cast<size_t>(i) * g_cfg.frame_size_bytes + g_cfg.header_bytes], out.data());
+            g_sink += out[0];
+        };
+        const std::string p = params("{\"mode\": \"%s\", \"samples\": %d, \"payload_bytes\": %d}",
+                                     pack_mode_name(m), g_cfg.samples_per_frame, g_cfg.payload_bytes);
+        r.run(std::string("unpack/") + pack_mode_name(m), p, kFrames, op);
+
+        // 同一格式走解析计划（抓包路径实际用的）：不读 g_cfg、不逐包校验，常见尺寸为定长特化
+        ParserPlan plan;
+        std::string why;
+        make_parser_plan(g_cfg, plan, why);
+        auto op_plan = [&] {
+            for (int i = 0; i < kFrames; ++i)
+                plan.unpack(&in[static_cast<size_t>(i) * plan.frame_size_bytes + plan.header_bytes], out.data());
+            g_sink += out[0];
+        };
+        r.run(std::string("unpack_plan/") + pack_mode_name(m), p, kFrames, op_plan);
+
+        // RAW10 再逐个内核测一遍（通用与定长特化）
+        if (m == PackMode::RAW10_PACKED) {
+            const std::string dflt = unpack_kernel_name();
+            for (const char* k : available_unpack_kernels()) {
+                select_unpack_kernel(k);
+                r.run(std::string("unpack/RAW10/") + k, p, kFrames, op);
+                make_parser_plan(g_cfg, plan, why);
+                r.run(std::string("unpack_plan/RAW10/") + k, p, kFrames, op_plan);
+            }
+            select_unpack_kernel(dflt.c_str());
+        }
+    }
+    g_cfg = saved;
+}
+
+void bench_ring(Runner& r) {
+    const ParserConfig saved = g_cfg;
+    g_cfg = config_for(PackMode::RAW10_PACKED);
+    const int spf = g_cfg.samples_per_frame;
+    constexpr size_t kCap = 200000;
+
+    for (RingLayout layout : {RingLayout::ROW_MAJOR, RingLayout::CHANNEL_TILED, RingLayout::PACKED}) {
+        for (bool pyr : {false, true}) {
+            RingOptions o;
+            o.layout = layout;
+            o.enable_pyramid = pyr;
+            DecodedFrameRing ring(kCap, o);
+            std::vector<uint16_t> f(static_cast<size_t>(spf), 512);
+            int64_t ts = 0;
+            constexpr int kBatch = 1024;
+            const char* lname = layout == RingLayout::ROW_MAJOR ? "row"
+                              : layout == RingLayout::CHANNEL_TILED ? "tiled" : "packed";
+            r.run(std::string("ring/push_frame/") + lname + (pyr ? "+pyramid" : ""),
+                  params("{\"layout\": \"%s\", \"pyramid\": %s, \"samples\": %d}", lname, pyr ? "true" : "false", spf),
+                  kBatch, [&] {
+                      for (int i = 0; i < kBatch; ++i) { f[0] = static_cast<uint16_t>(i); ring.push_frame(f.data(), ts += 50000); }
+                  });
+
+            if (pyr) continue;
+            fill_ring(ring, kCap, 20000.0);
+            const uint64_t w = ring.snapshot_write_index();
+            constexpr size_t kScan = 20000; // 1 秒 @ 20 kfps
+            r.run(std::string("ring/get_sample_scan/") + lname,
+                  params("{\"layout\": \"%s\", \"frames\": %zu}", lname, kScan), kScan, [&] {
+                      uint64_t acc = 0;
+                      for (uint64_t i = w - kScan; i < w; ++i) acc += ring.get_sample(i, 17);
+                      g_sink += acc;
+                  });
+            std::vector<uint16_t> buf(kScan);
+            r.run(std::string("ring/read_channel/") + lname,
+                  params("{\"layout\": \"%s\", \"frames\": %zu}", lname, kScan), kScan, [&] {
+                      ring.read_channel(17, w - kScan, kScan, buf.data());
+                      g_sink += buf[kScan / 2];
+                  });
+        }
+    }
+    g_cfg = saved;
+}
+
+void bench_envelope(Runner& r) {
+    const ParserConfig saved = g_cfg;
+    g_cfg = config_for(PackMode::RAW10_PACKED);
+    constexpr double kFps = 20000.0;
+    constexpr size_t kCap = 200000; // 10 秒
+
+    for (bool pyr : {false, true}) {
+        RingOptions o;
+        o.enable_pyramid = pyr;
+        DecodedFrameRing ring(kCap, o);
+        fill_ring(ring, kCap, kFps);
+        const uint64_t w = ring.snapshot_write_index();
+
+        for (double win : {0.1, 1.0, 10.0}) {
+            for (int bins : {400, 1200, 4000}) {
+                for (int chans : {1, 8, 32}) {
+                    const double frames = std::min<double>(win * kFps, kCap) * chans;
+                    r.run(std::string("envelope/") + (pyr ? "pyramid" : "raw"),
+                          params("{\"pyramid\": %s, \"window_s\": %g, \"bins\": %d, \"channels\": %d}",
+                                 pyr ? "true" : "false", win, bins, chans),
+                          frames, [&] {
+                              for (int c = 0; c < chans; ++c) {
+                                  const Envelope e = build_envelope(ring, w, c, win, bins);
+                                  g_sink += static_cast<uint64_t>(e.mean[0]);
+                              }
+                          });
+                }
+            }
+        }
+    }
+    g_cfg = saved;
+}
+
+void bench_smooth(Runner& r) {
+    for (int n : {1200, 4000, 65536}) {
+        std::vector<double> y0(static_cast<size_t>(n));
+        for (int i = 0; i < n; ++i) y0[i] = std::sin(i * 0.01) * 100.0;
+        std::vector<double> y;
+        r.run("smooth/ema", params("{\"samples\": %d, \"tau_ms\": 5}", n), n, [&] {
+            y = y0;
+            smooth_ema(y, 1e-4, 5.0);
+            g_sink += static_cast<uint64_t>(y[n / 2]);
+        });
+        r.run("smooth/mavg", params("{\"samples\": %d, \"w\": 15}", n), n, [&] {
+            y = y0;
+            smooth_mavg(y, 15);
+            g_sink += static_cast<uint64_t>(y[n / 2]);
+        });
+    }
+}
+
+// 绘图每帧做的取数工作（不含 QPainter 绘制）：每个可见通道 build_envelope、
+// 自动 Y 范围归约、窗口内原始曲线取样与均值高通
+void bench_plot_path(Runner& r) {
+    const ParserConfig saved = g_cfg;
+    g_cfg = config_for(PackMode::RAW10_PACKED);
+    constexpr double kFps = 20000.0;
+    DecodedFrameRing ring(200000);
+    fill_ring(ring, 200000, kFps);
+    const uint64_t w = ring.snapshot_write_index();
+
+    for (int plots : {1, 8, 32}) {
+        const double win = 1.0;
+        const int bins = 1200;
+        std::vector<uint16_t> raw;
+        r.run("plot/envelope_path",
+              params("{\"plots\": %d, \"window_s\": %g, \"bins\": %d}", plots, win, bins),
+              win * kFps * plots, [&] {
+                  for (int c = 0; c < plots; ++c) {
+                      const Envelope e = build_envelope(ring, w, c, win, bins);
+                      double lo = 1e300, hi = -1e300;
+                      for (int i = 0; i < bins; ++i) { lo = std::min(lo, e.ymin[i]); hi = std::max(hi, e.ymax[i]); }
+
+                      const auto range = ring.window_range(w, win);
+                      raw.resize(static_cast<size_t>(range.last - range.first));
+                      ring.read_channel(c, range.first, raw.size(), raw.data());
+
+                      std::vector<double> hp = e.mean;
+                      const double dt = (e.x.back() - e.x.front()) / (bins - 1);
+                      const double tau = 1.0 / (2.0 * M_PI * 50.0), alpha = tau / (tau + dt);
+                      double prev = 0.0;
+                      for (int i = 0; i < bins; ++i) { const double x = hp[i]; hp[i] = alpha * (prev + x - (i ? e.mean[i-1] : x)); prev = x; }
+                      g_sink += static_cast<uint64_t>(lo + hi + hp[bins / 2]) + raw[0];
+                  }
+              });
+    }
+    // 同样的通道数，改为所有绘图共用一次 build_envelopes
+    MultiEnvelope shared;
+    for (int plots : {1, 8, 32}) {
+        std::vector<int> chs;
+        for (int c = 0; c < plots; ++c) chs.push_back(c);
+        r.run("plot/shared_envelopes",
+              params("{\"plots\": %d, \"window_s\": %g, \"bins\": %d}", plots, 1.0, 1200),
+              kFps * plots, [&] {
+                  build_envelopes(ring, w, chs, 1.0, 1200, shared);
+                  g_sink += static_cast<uint64_t>(shared.mean[0]);
+              });
+    }
+    // 原始曲线的逐像素列 M4（1000 列）：代价随列数而非窗口帧数增长
+    {
+        std::vector<double> mx, my;
+        for (double win : {0.1, 1.0, 8.0}) {
+            r.run("plot/raw_m4", params("{\"window_s\": %g, \"columns\": %d}", win, 1000), win * kFps, [&] {
+                g_sink += decimate_m4(ring, w, 3, win, 1000, mx, my);
+            });
+        }
+    }
+    // 滑动包络的稳态：写指针每次前进一个重绘周期（60 Hz）的帧数再更新。
+    // 在已填满的环上回放写指针，走到头时回到中段重建一次（约每 300 次一次，计入耗时）
+    {
+        constexpr uint64_t kPerTick = static_cast<uint64_t>(kFps / 60);
+        for (int plots : {1, 8, 32}) {
+            std::vector<int> chs;
+            for (int c = 0; c < plots; ++c) chs.push_back(c);
+            SlidingEnvelope slide;
+            uint64_t n = w / 2;
+            r.run("plot/sliding_envelopes",
+                  params("{\"plots\": %d, \"window_s\": %g, \"bins\": %d, \"new_frames\": %d}",
+                         plots, 1.0, 1200, static_cast<int>(kPerTick)),
+                  kPerTick * plots, [&] {
+                      n += kPerTick;
+                      if (n > w) { n = w / 2; slide.reset(); }
+                      slide.update(ring, n, chs, 1.0, 1200, shared);
+                      g_sink += static_cast<uint64_t>(shared.mean[0]);
+                  });
+        }
+    }
+    g_cfg = saved;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--filter" && i + 1 < argc)        opt.filter = argv[++i];
+        else if (a == "--min-time" && i + 1 < argc) opt.min_time = std::atof(argv[++i]);
+        else if (a == "--out" && i + 1 < argc)      opt.out = argv[++i];
+        else {
+            std::fprintf(stderr, "usage: %s [--filter SUBSTR] [--min-time SEC] [--out FILE]\n", argv[0]);
+            return a == "--help" || a == "-h" ? 0 : 2;
+        }
+    }
+
+    Runner r(opt);
+    bench_unpack(r);
+    bench_ring(r);
+    bench_envelope(r);
+    bench_smooth(r);
+    bench_plot_path(r);
+
+    FILE* f = opt.out.empty() ? stdout : std::fopen(opt.out.c_str(), "w");
+    if (!f) { std::fprintf(stderr, "cannot open %s\n", opt.out.c_str()); return 1; }
+    r.write_json(f);
+    if (f != stdout) std::fclose(f);
+    return 0;
+}
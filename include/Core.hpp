@@ -5,9 +5,32 @@
 #include <cstring>
 #include <algorithm>
 #include <cmath>
+#include <memory>
+#include <mutex>
+#include <string>
 
 // ========================= 可配置的解析参数 =========================
-enum class PackMode { RAW10_PACKED, RAW16_LE }; // 可扩展：RAW12、RAW14、MIPI 等
+// 新增的取值追加在末尾，保持已有枚举值不变
+enum class PackMode {
+    RAW10_PACKED,  // 5 字节 4 样本，b4 为高 2 位
+    RAW16_LE,
+    RAW12_PACKED,  // 3 字节 2 样本，LSB 优先位流
+    RAW14_PACKED,  // 7 字节 4 样本，LSB 优先位流
+    MIPI_RAW10,    // MIPI CSI-2：5 字节 4 样本，b4 为低 2 位
+    MIPI_RAW12,    // MIPI CSI-2：3 字节 2 样本，b2 为低 4 位
+    RAW16_BE,
+};
+
+// 打包几何：group_bytes 字节对应 group_samples 个样本
+struct PackGeometry {
+    int group_bytes;
+    int group_samples;
+    int bits;          // 该格式的原生位宽
+};
+PackGeometry pack_geometry(PackMode m);
+const char*  pack_mode_name(PackMode m);
+// pack_mode_name 的逆，不区分大小写；另接受简写 RAW10/RAW12/RAW14（= *_PACKED）与 RAW16（= RAW16_LE）
+bool         pack_mode_from_name(const std::string& name, PackMode& out);
 
 struct ParserConfig {
     int frame_size_bytes  = 1299; // 整个 UDP 负载长度
@@ -20,20 +43,95 @@ struct ParserConfig {
 
     PackMode pack         = PackMode::RAW10_PACKED;
 
+    // 头部序号字段：seq_offset < 0 表示不跟踪；偏移相对 UDP 负载起始，须整体落在 header 内
+    int  seq_offset       = -1;
+    int  seq_bytes        = 4;    // 1 / 2 / 4 / 8，序号按 2^(8*seq_bytes) 回绕
+    bool seq_big_endian   = true;
+    int  reorder_window   = 0;    // 重排窗口（帧）；0 表示只统计、不重排
+
     inline uint16_t max_sample() const {
         if (bits_per_sample >= 16) return 0xFFFF;
         return static_cast<uint16_t>((1u << bits_per_sample) - 1u);
     }
+
+    // frame 指向 UDP 负载起始
+    inline uint64_t read_seq(const uint8_t* frame) const {
+        const uint8_t* p = frame + seq_offset;
+        uint64_t v = 0;
+        if (seq_big_endian) for (int i = 0; i < seq_bytes; ++i) v = (v << 8) | p[i];
+        else                for (int i = seq_bytes - 1; i >= 0; --i) v = (v << 8) | p[i];
+        return v;
+    }
 };
 
 // 全局配置：在 Core.cpp 中定义为默认值，你可以在任何 cpp 中修改 g_cfg 的字段
 extern ParserConfig g_cfg;
 
+// 检查一组解析参数是否自洽；不通过时 why 给出原因
+bool validate_parser_config(const ParserConfig& cfg, std::string& why);
+// 两份配置的全部字段是否相同
+bool same_parser_config(const ParserConfig& a, const ParserConfig& b);
+
+// 按打包格式推出一组自洽的参数：payload 恰好容纳 samples_per_frame 个样本（不足一组的部分向上取整），
+// 位宽取格式原生位宽，其余字段保持默认
+ParserConfig parser_config_for(PackMode pack, int samples_per_frame, int header_bytes, int tail_bytes);
+
 // ========================= 运行时统计 =========================
 struct RuntimeStats {
     std::atomic<uint64_t> frames_rx{0};
     std::atomic<uint64_t> bytes_rx{0};
     std::atomic<uint64_t> frames_drop{0};
+
+    // frames_drop 按原因细分：L2/L3/UDP 解析失败、长度不符（含 MSG_TRUNC）。
+    // 解包不会失败：帧长与格式已由解析计划（ParserPlan）校验过，长度相符的包一定能解
+    std::atomic<uint64_t> drop_parse{0};
+    std::atomic<uint64_t> drop_size{0};
+
+    // 进用户态之前的丢包：kernel_drops 为 pcap_stats ps_drop / PACKET_STATISTICS tp_drops / SO_RXQ_OVFL；
+    // if_drops 为网卡侧（ps_ifdrop，或 sysfs rx_dropped + rx_missed_errors 自开始抓包起的增量）
+    std::atomic<uint64_t> kernel_drops{0};
+    std::atomic<uint64_t> if_drops{0};
+
+    // 头部序号（ParserConfig::seq_offset >= 0 时）。kernel/if 丢包为 0 而 seq_lost 增长，
+    // 说明丢在发送端或链路上；seq_lost 也包含本地 parse/size 丢弃的帧
+    std::atomic<uint64_t> seq_lost{0};       // 缺口（迟到补上的会被扣回）
+    std::atomic<uint64_t> seq_reordered{0};  // 晚于更大序号到达、仍按序写入
+    std::atomic<uint64_t> seq_duplicate{0};
+    std::atomic<uint64_t> seq_late{0};       // 到达时已被判为丢失，丢弃
+    std::atomic<uint64_t> seq_wraps{0};
+    std::atomic<uint64_t> seq_resync{0};     // 序号大幅回退（发送端重启），重新同步
+
+    // UDP_SOCKET 模式：recvmmsg 批次统计与套接字溢出丢包（SO_RXQ_OVFL，内核累计值）
+    std::atomic<uint64_t> udp_batches{0};
+    std::atomic<uint64_t> udp_batch_last{0};
+    std::atomic<uint64_t> udp_batch_max{0};
+    std::atomic<uint64_t> sock_drops{0};
+
+    // 解析配置热切换：写入主环的帧当前所用配置的 epoch（见 ParserPlanChannel），以及切换次数
+    std::atomic<uint64_t> parser_epoch{0};
+    std::atomic<uint64_t> parser_switches{0};
+
+    // 离线回放：已回放的包/帧数、墙钟耗时与是否已到结尾（不控速时即整条流水线的吞吐）
+    std::atomic<uint64_t> replay_packets{0};
+    std::atomic<int64_t>  replay_wall_ns{0};
+    std::atomic<bool>     replay_done{false};
+
+    // 录制器（主环的第二个消费者）：已写帧数/字节数、当前积压帧数、因落后太多被跳过的帧数
+    std::atomic<uint64_t> rec_frames{0};
+    std::atomic<uint64_t> rec_bytes{0};
+    std::atomic<uint64_t> rec_backlog{0};
+    std::atomic<uint64_t> rec_overrun{0};
+
+    // 扇出模式：每个抓包线程/队列的统计（rx_queues 为实际使用的队列数）
+    static constexpr int kMaxRxQueues = 16;
+    struct QueueStats {
+        std::atomic<uint64_t> frames_enq{0};  // 解码进本队列的帧；写入主环的帧计入上面的 frames_rx
+        std::atomic<uint64_t> bytes_rx{0};
+        std::atomic<uint64_t> frames_drop{0};
+        std::atomic<uint64_t> queue_full{0};  // 合并线程来不及搬运而丢弃
+    };
+    std::atomic<int> rx_queues{0};
+    QueueStats queues[kMaxRxQueues];
 };
 
 // ========================= 解包接口（按 g_cfg.pack） =========================
@@ -42,50 +140,587 @@ struct RuntimeStats {
 // 返回：true=成功，false=长度/模式不匹配
 bool unpack_payload(const uint8_t* payload, uint16_t* out);
 
+// 同上，但始终使用标量参考内核（用于与 SIMD 结果比对）
+bool unpack_payload_scalar(const uint8_t* payload, uint16_t* out);
+
+// 反方向：按 cfg.pack 把 samples_per_frame 个样本打包进 payload（payload_bytes 字节，多余部分填 0）。
+// 显式传 cfg 而不是读 g_cfg：帧生成器的格式与本进程的解析配置相互独立
+bool pack_payload(const uint16_t* in, uint8_t* payload, const ParserConfig& cfg);
+
+// ========================= 解析计划 =========================
+// 由 ParserConfig 一次性构造：校验、组数与内核选择都前置，热路径不再读 g_cfg、不再逐包校验，
+// 只剩一次长度比较和一次间接调用。常见格式（RAW10 1280 B / 1024 样本、RAW16 BE 1024 样本）
+// 用组数编译期固定的特化内核，其余配置走通用内核。
+using UnpackKernel = void (*)(const uint8_t* p, int count, uint16_t* out);
+
+struct ParserPlan {
+    ParserConfig cfg;                  // 构造时的配置快照（序号字段等）
+    int          frame_size_bytes = 0;
+    int          header_bytes     = 0;
+    int          count            = 0; // 传给内核：RAW16 为样本数，其余为组数
+    UnpackKernel kernel           = nullptr;
+    const char*  kernel_name      = "";
+    bool         specialised      = false; // 命中定长特化
+    uint64_t     epoch            = 0;     // 由 ParserPlanChannel 发布时分配，0 表示未发布
+
+    bool valid() const { return kernel != nullptr; }
+    // payload 指向数据区起始（已跳过 header_bytes）；计划构造时已校验过长度，不会失败
+    inline void unpack(const uint8_t* payload, uint16_t* out) const { kernel(payload, count, out); }
+};
+
+// cfg 不自洽时返回 false，why 给出原因（同 validate_parser_config）
+bool make_parser_plan(const ParserConfig& cfg, ParserPlan& plan, std::string& why);
+
+// ========================= 解析配置热切换 =========================
+// RCU 式发布：GUI 线程 publish 一份新的不可变计划，抓包线程每包只做一次原子读比较 epoch，变了才换指针。
+// 旧计划由 shared_ptr 回收，读者手里那份在它自己换下之前一直有效，发布方从不等待读者。
+// epoch 在进程内单调递增（跨 PcapWorker 重启也不重复），直接用作主环分段的标识。
+class ParserPlanChannel {
+public:
+    // cfg 不自洽时返回 0（why 给出原因），否则返回新计划的 epoch
+    uint64_t publish(const ParserConfig& cfg, std::string& why);
+    uint64_t epoch() const { return epoch_.load(std::memory_order_acquire); }
+    std::shared_ptr<const ParserPlan> load() const { return std::atomic_load_explicit(&plan_, std::memory_order_acquire); }
+
+private:
+    std::shared_ptr<const ParserPlan> plan_; // 只经 std::atomic_load/store 访问
+    std::atomic<uint64_t> epoch_{0};
+};
+
+// 读者侧缓存，每个线程一份；构造前 channel 至少已发布过一次
+class ParserPlanView {
+public:
+    explicit ParserPlanView(const ParserPlanChannel& ch) : ch_(ch), hold_(ch.load()), seen_(hold_->epoch) {}
+    const ParserPlan& current() {
+        if (ch_.epoch() != seen_) { hold_ = ch_.load(); seen_ = hold_->epoch; }
+        return *hold_;
+    }
+
+private:
+    const ParserPlanChannel&          ch_;
+    std::shared_ptr<const ParserPlan> hold_;
+    uint64_t                          seen_;
+};
+
+// ========================= 区间统计 =========================
+// 某通道在一段帧范围内的 min/max/sum/count
+struct RangeStats {
+    uint16_t vmin  = 0xFFFF;
+    uint16_t vmax  = 0;
+    uint64_t sum   = 0;
+    uint64_t count = 0;
+
+    inline void add(uint16_t v) {
+        vmin = std::min(vmin, v); vmax = std::max(vmax, v);
+        sum += v; ++count;
+    }
+    inline void merge(uint16_t mn, uint16_t mx, uint64_t s, uint64_t n) {
+        vmin = std::min(vmin, mn); vmax = std::max(vmax, mx);
+        sum += s; count += n;
+    }
+};
+
+// ========================= 大块匿名映射 =========================
+// 环的样本/时间戳存储：按需提交（页面首次写入才占物理内存，未写过的页读出为 0），
+// 构造不清零，几百 MB 的环创建是瞬时的；不小于 2 MiB 的映射按 2 MiB 对齐并建议透明大页（MADV_HUGEPAGE）。
+// 映射失败时抛 std::bad_alloc（与 std::vector 一致）
+class MappedBuffer {
+public:
+    MappedBuffer() = default;
+    explicit MappedBuffer(size_t bytes);
+    ~MappedBuffer();
+    MappedBuffer(const MappedBuffer&) = delete;
+    MappedBuffer(MappedBuffer&& o) noexcept { *this = std::move(o); }
+    MappedBuffer& operator=(const MappedBuffer&) = delete;
+    MappedBuffer& operator=(MappedBuffer&& o) noexcept {
+        std::swap(ptr_, o.ptr_); std::swap(size_, o.size_); std::swap(huge_, o.huge_);
+        return *this;
+    }
+
+    void*  data() const       { return ptr_; }
+    size_t size() const       { return size_; }
+    bool   huge_pages() const { return huge_; } // MADV_HUGEPAGE 是否被接受
+
+private:
+    void*  ptr_  = nullptr;
+    size_t size_ = 0;
+    bool   huge_ = false;
+};
+
+// ========================= 多级摘要金字塔 =========================
+// 每通道维护多级 min/max/sum：第 L 级每块覆盖 2^(base_log2+L) 帧。
+// 写线程每推入一帧更新最细一级的累加器，块满时逐级向上合并（均摊 O(1)）。
+// 查询 [f0,f1) 时按对齐的最大块拆分，只有首尾不足一个基块的部分读原始样本，
+// 因此包络构建为 O(bins × (2^base_log2 + 级数)) 而不是 O(frames)。
+// 存储按块主序（块内各通道相邻），块满时整行写入是连续的。
+class FramePyramid {
+public:
+    FramePyramid(size_t frame_capacity, int channels, int base_log2);
+
+    // 写线程：abs 为该帧绝对索引，须从 0 起连续递增
+    void on_frame(uint64_t abs, const uint16_t* samples);
+
+    int      base_log2() const { return base_log2_; }
+    int      levels() const    { return static_cast<int>(levels_.size()); }
+    size_t   memory_bytes() const;
+
+    // 读：累加第 level 级绝对块号 blk 的统计（调用方保证该块已完成且仍在保留范围内）
+    inline void accumulate_block(int level, uint64_t blk, int ch, RangeStats& acc) const {
+        const Level& lv = levels_[static_cast<size_t>(level)];
+        const size_t i = static_cast<size_t>(blk % lv.nblocks) * static_cast<size_t>(channels_) + static_cast<size_t>(ch);
+        acc.merge(lv.mn[i], lv.mx[i], lv.sum[i], uint64_t(1) << (base_log2_ + level));
+    }
+
+    // 同上，一次合并相邻通道 [c0, c0+n)：块内各通道相邻，循环可向量化
+    inline void accumulate_block_span(int level, uint64_t blk, int c0, int n,
+                                      uint16_t* mn, uint16_t* mx, uint64_t* sum) const {
+        const Level& lv = levels_[static_cast<size_t>(level)];
+        const size_t i = static_cast<size_t>(blk % lv.nblocks) * static_cast<size_t>(channels_) + static_cast<size_t>(c0);
+        const uint16_t* a = &lv.mn[i];
+        const uint16_t* b = &lv.mx[i];
+        const uint32_t* s = &lv.sum[i];
+        for (int c = 0; c < n; ++c) {
+            mn[c]   = std::min(mn[c], a[c]);
+            mx[c]   = std::max(mx[c], b[c]);
+            sum[c] += s[c];
+        }
+    }
+
+private:
+    struct Level {
+        size_t nblocks = 0;
+        MappedBuffer mem;          // 按需提交，与环的样本存储一样不在构造时清零
+        uint16_t* mn  = nullptr;
+        uint16_t* mx  = nullptr;
+        uint32_t* sum = nullptr;   // 2^16 帧 × 0xFFFF 仍在 uint32 范围内，故最高到 2^16 帧一块
+    };
+
+    int channels_;
+    int base_log2_;
+    std::vector<Level> levels_;
+
+    // 当前未满基块的累加器
+    std::vector<uint16_t> acc_mn_, acc_mx_;
+    std::vector<uint32_t> acc_sum_;
+};
+
 // ========================= 解码后帧环（SPSC） =========================
+// ROW_MAJOR：slot * samples_per_frame + ch（逐帧连续，写入最快）
+// CHANNEL_TILED：每 tile_frames 帧为一块，块内按通道转置为 [ch][frame]，
+//                单通道扫描在块内连续，可向量化；push_frame 仍接收逐帧样本。
+//                写入先按行暂存，每满 kStageFrames 帧整批转置进块（每通道写一整条缓存行），
+//                还没转置的最新几帧由读取方直接从暂存行读。
+// PACKED：逐帧连续，样本按当前格式的原生位宽（10/12/14）LSB 优先紧密打包，读时解包。
+//         同样内存多存 16/bits 倍的历史；原生 16 位的格式没有可省的，退回 ROW_MAJOR。
+// 主环中连续按同一解析配置写入的一段帧：[first, 下一段的 first)
+struct RingSegment {
+    uint64_t     first = 0;
+    uint64_t     epoch = 0;
+    ParserConfig cfg;
+};
+
+enum class RingLayout { ROW_MAJOR, CHANNEL_TILED, PACKED };
+
+struct RingOptions {
+    bool       enable_pyramid    = true; // 维护多级摘要，包络查询不再逐帧扫描（RX 线程每帧约多 0.2 µs/千通道，
+                                         // 每 bin 数百帧以上的长窗口才明显受益；不画包络的进程应关掉）
+    int        pyramid_base_log2 = 6;    // 最细一级每块 64 帧
+    RingLayout layout            = RingLayout::ROW_MAJOR;
+    size_t     tile_frames       = 256;  // CHANNEL_TILED 每块帧数（向上取 2 的幂）
+};
+
 class DecodedFrameRing {
 public:
-    explicit DecodedFrameRing(size_t frame_capacity)
-    : capacity_(frame_capacity), data_(frame_capacity * static_cast<size_t>(g_cfg.samples_per_frame)) {
-        write_index_.store(0, std::memory_order_relaxed);
+    explicit DecodedFrameRing(size_t frame_capacity, const RingOptions& opt = RingOptions{});
+
+    // 按 opt 与当前 g_cfg，每帧在环内占用的字节（样本 + 时间戳 + 金字塔摊销）
+    static size_t bytes_per_frame(const RingOptions& opt);
+    // memory_budget_bytes 能容纳的帧数（至少 1），用于按内存预算而不是固定帧数建环
+    static size_t frames_for_budget(size_t memory_budget_bytes, const RingOptions& opt);
+
+    // ---- 写线程：零拷贝两段式写入 ----
+    // reserve_frame() 返回下一帧的写指针，解码直接写入；commit_frame() 以 release 发布。
+    // 未 commit（例如解码失败）时，下一次 reserve_frame() 返回同一位置。
+    // ROW_MAJOR 下指针即环内槽位；CHANNEL_TILED / PACKED 下为暂存行，commit 时转置进块或打包进槽位。
+    uint16_t* reserve_frame() {
+        if (layout_ == RingLayout::PACKED) return staging_.data();
+        const uint64_t w = write_index_.load(std::memory_order_relaxed);
+        if (layout_ == RingLayout::CHANNEL_TILED) return stage_row(w);
+        return &data_[static_cast<size_t>(w % capacity_) * static_cast<size_t>(spf_)];
     }
 
-    void push_frame(const uint16_t* samples) {
-        uint64_t w = write_index_.load(std::memory_order_relaxed);
-        size_t slot = static_cast<size_t>(w % capacity_);
-        uint16_t* dst = &data_[slot * static_cast<size_t>(g_cfg.samples_per_frame)];
-        std::memcpy(dst, samples, static_cast<size_t>(g_cfg.samples_per_frame) * sizeof(uint16_t));
+    // ts_ns：该帧的抓包时间戳（CLOCK_REALTIME 纳秒），写入与环平行的时间索引
+    void commit_frame(int64_t ts_ns) {
+        const uint64_t w = write_index_.load(std::memory_order_relaxed);
+        const size_t slot = static_cast<size_t>(w % capacity_);
+        ts_ns_[slot] = ts_ns;
+        const uint16_t* row;
+        if (layout_ == RingLayout::ROW_MAJOR) {
+            row = &data_[slot * static_cast<size_t>(spf_)];
+        } else if (layout_ == RingLayout::PACKED) {
+            row = staging_.data();
+            pack_row(row, packed_ + slot * row_bytes_);
+        } else {
+            row = stage_row(w);
+        }
+        if (pyramid_) pyramid_->on_frame(w, row);
+        if (layout_ == RingLayout::CHANNEL_TILED && ((w + 1) & stage_mask_) == 0) flush_stage(w + 1 - stage_mask_ - 1);
         write_index_.store(w + 1, std::memory_order_release);
+        // 暂存行按 seqlock 方式被读取：之后对暂存行的写不得早于上面的写指针发布（x86 上只是编译器屏障）
+        if (layout_ == RingLayout::CHANNEL_TILED) std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    // 已有完整帧时的便捷写入
+    void push_frame(const uint16_t* samples, int64_t ts_ns) {
+        std::memcpy(reserve_frame(), samples, static_cast<size_t>(spf_) * sizeof(uint16_t));
+        commit_frame(ts_ns);
     }
 
     uint64_t snapshot_write_index() const { return write_index_.load(std::memory_order_acquire); }
     size_t capacity() const { return capacity_; }
+    int samples_per_frame() const { return spf_; }
+    RingLayout layout() const { return layout_; }
+    int storage_bits() const { return layout_ == RingLayout::PACKED ? bits_ : 16; }
+    size_t memory_bytes() const;      // 样本 + 时间戳 + 金字塔的映射/分配大小
+    bool huge_pages() const { return samples_mem_.huge_pages(); }
 
     inline uint16_t get_sample(uint64_t abs_frame_index, int ch) const {
         size_t slot = static_cast<size_t>(abs_frame_index % capacity_);
-        return data_[slot * static_cast<size_t>(g_cfg.samples_per_frame) + static_cast<size_t>(ch)];
+        if (layout_ == RingLayout::ROW_MAJOR)
+            return data_[slot * static_cast<size_t>(spf_) + static_cast<size_t>(ch)];
+        if (layout_ == RingLayout::PACKED) return packed_sample(slot, ch);
+        if (abs_frame_index >= tiled_end_.load(std::memory_order_acquire)) {
+            const uint16_t v = stage_row(abs_frame_index)[ch];
+            if (!stage_reused(abs_frame_index)) return v;
+        }
+        return data_[(((slot >> tile_log2_) * static_cast<size_t>(spf_) + static_cast<size_t>(ch)) << tile_log2_) + (slot & tile_mask_)];
     }
 
+    // ---- 按解析配置分段 ----
+    // 热切换解析配置时环不重建，只在写指针处开新段；旧段的帧照常可查看，随环覆盖自然淘汰。
+    // 样本几何（每帧样本数，PACKED 下还有位宽）不同的配置不能共用环，需要重建
+    bool accepts(const ParserConfig& cfg) const;
+    // 写线程调用：之后 commit 的帧属于 epoch。配置与当前段相同时只记下新 epoch，不开新段
+    void begin_segment(uint64_t epoch, const ParserConfig& cfg);
+    // 仍有帧在环内的各段，按 first 升序（最老一段的 first 可能早于环内最老帧）
+    std::vector<RingSegment> segments(uint64_t widx_snapshot) const;
+
+    // ---- 时间索引 ----
+    inline int64_t timestamp_ns(uint64_t abs_frame_index) const {
+        return ts_ns_[static_cast<size_t>(abs_frame_index % capacity_)];
+    }
+
+    // [lo, hi) 中第一个时间戳 >= t_ns 的帧（二分查找；全部更早时返回 hi）
+    uint64_t lower_bound_time(int64_t t_ns, uint64_t lo, uint64_t hi) const;
+
+    // 以最新一帧为终点、长 window_seconds 的帧范围 [first, last)，只含仍在环内的帧
+    struct FrameRange { uint64_t first = 0, last = 0; int64_t t_end_ns = 0; };
+    FrameRange window_range(uint64_t widx_snapshot, double window_seconds) const;
+
+    // 按最近 lookback_seconds 内的时间戳实测帧率；数据不足时返回 0
+    double estimate_fps(uint64_t widx_snapshot, double lookback_seconds = 1.0) const;
+
+    // 批量读取 ch 通道 [f0, f0+n) 的样本到 out（调用方保证这些帧仍在环内）。
+    // CHANNEL_TILED 下按块 memcpy，ROW_MAJOR 下逐帧跨步读取。
+    void read_channel(int ch, uint64_t f0, size_t n, uint16_t* out) const;
+
+    // 读取第 abs 帧的全部通道（按通道顺序）到 out；调用方保证该帧仍在环内
+    void read_frame(uint64_t abs_frame_index, uint16_t* out) const;
+
+    // [f0, f1) 内 ch 通道的统计；有金字塔时走摘要，否则逐帧扫描。
+    // widx_snapshot 为调用方取到的写指针，f1 不得超过它。
+    RangeStats range_stats(uint64_t f0, uint64_t f1, int ch, uint64_t widx_snapshot) const;
+
+    // 多通道版本：相邻通道 [c0, c0+n) 一次遍历，各自累加进 mn/mx/sum（各 n 个，调用方初始化）。
+    // 返回累加的帧数（各通道相同）。ROW_MAJOR 下每帧读一段连续样本，跨通道向量化
+    uint64_t range_stats_span(uint64_t f0, uint64_t f1, int c0, int n, uint64_t widx_snapshot,
+                              uint16_t* mn, uint16_t* mx, uint64_t* sum) const;
+
 private:
-    size_t capacity_;
-    std::vector<uint16_t> data_; // capacity_ * samples_per_frame
+    // PACKED：槽位内第 ch 个样本的位偏移为 ch * bits_；每行末尾留足 4 字节，可直接做 32 位非对齐读
+    inline uint16_t packed_sample(size_t slot, int ch) const {
+        const size_t bit = static_cast<size_t>(ch) * static_cast<size_t>(bits_);
+        uint32_t v;
+        std::memcpy(&v, packed_ + slot * row_bytes_ + (bit >> 3), sizeof(v));
+        return static_cast<uint16_t>((v >> (bit & 7)) & bits_mask_);
+    }
+    void pack_row(const uint16_t* row, uint8_t* dst);
+
+    // CHANNEL_TILED 暂存区：2 × stage_frames_ 行，按绝对帧号轮用；一批转置后要再过一批才被覆盖
+    inline uint16_t* stage_row(uint64_t abs) {
+        return &staging_[static_cast<size_t>(abs & (2 * stage_mask_ + 1)) * static_cast<size_t>(spf_)];
+    }
+    inline const uint16_t* stage_row(uint64_t abs) const {
+        return &staging_[static_cast<size_t>(abs & (2 * stage_mask_ + 1)) * static_cast<size_t>(spf_)];
+    }
+    // 读完 abs 的暂存行后调用：写线程若已开始复用该行，读到的可能是新帧，应改从块里读（那时已转置完）
+    inline bool stage_reused(uint64_t abs) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return write_index_.load(std::memory_order_acquire) >= (abs & ~uint64_t(stage_mask_)) + 2 * (stage_mask_ + 1);
+    }
+    void flush_stage(uint64_t first); // 把 [first, first + stage_frames) 从暂存行转置进块
+    void unpack_row(size_t slot, int c0, int n, uint16_t* out) const;
+
+    void accumulate_raw(uint64_t f0, uint64_t f1, int ch, RangeStats& acc) const;
+    void accumulate_raw_span(uint64_t f0, uint64_t f1, int c0, int n, uint16_t* mn, uint16_t* mx, uint64_t* sum) const;
+
+    // 把 [f0, f1) 拆成金字塔的对齐块与首尾不足一个基块的原始段，依次交给 block(level, blk) / raw(a, b)
+    template <class RawFn, class BlockFn>
+    void decompose(uint64_t f0, uint64_t f1, RawFn raw, BlockFn block) const;
+
+    size_t     capacity_;
+    int        spf_;
+    RingLayout layout_;
+    int        tile_log2_ = 0;
+    size_t     tile_mask_ = 0;
+    int        bits_ = 16;         // PACKED：每样本位数
+    uint32_t   bits_mask_ = 0xFFFF;
+    size_t     row_bytes_ = 0;     // PACKED：每帧字节数
+    MappedBuffer samples_mem_;
+    MappedBuffer ts_mem_;
+    uint16_t* data_   = nullptr;   // ROW_MAJOR / CHANNEL_TILED：capacity_ * samples_per_frame
+    uint8_t*  packed_ = nullptr;   // PACKED：capacity_ * row_bytes_
+    std::vector<uint16_t> staging_; // CHANNEL_TILED / PACKED：reserve_frame 的暂存行
+    static constexpr size_t kStageFrames = 64; // 每通道 128 字节：整对缓存行，比 32 帧（单行）快约 1.5 倍
+    size_t     stage_mask_ = 0;    // CHANNEL_TILED：每批帧数 - 1
+    std::atomic<uint64_t> tiled_end_{0}; // CHANNEL_TILED：此前的帧都已转置进块
+    int64_t*  ts_ns_  = nullptr;   // 每帧抓包时间戳，与槽位一一对应
+    std::unique_ptr<FramePyramid> pyramid_;
     std::atomic<uint64_t> write_index_;
+
+    static constexpr size_t kMaxSegments = 64; // 更老的段即使还有帧在环内也并入下一段
+    mutable std::mutex       seg_mu_;          // 只在换配置与读分段时争用
+    std::vector<RingSegment> segs_;
+};
+
+// ========================= 序号跟踪与重排 =========================
+// 位于主环之前：按头部序号统计丢失/乱序/重复/回绕，并在 reorder_window 帧的窗口内
+// 把迟到的帧放回正确位置。按序到达的帧直接解码进主环槽位（零拷贝）；只有超前到达的帧
+// 暂存在窗口缓冲中，缺口补上或窗口被挤满时按序号依次写入主环。
+// 单线程使用：单线程抓包时由 RX 线程调用，扇出时由合并线程调用。
+class SeqReorderBuffer {
+public:
+    SeqReorderBuffer(DecodedFrameRing& ring, const ParserConfig& cfg, RuntimeStats& stats);
+
+    // 为序号 seq 的帧取解码目标（主环槽位或暂存槽位）；返回 nullptr 表示丢弃（重复/过迟，已计数）。
+    // 未启用序号跟踪时 seq 被忽略，总是返回主环槽位。
+    uint16_t* begin(uint64_t seq, int64_t ts_ns);
+    // 与 begin 成对调用；ok=false（解包失败）时该序号视为已处理但无数据，不计入 seq_lost
+    void end(bool ok);
+    // 解析配置热切换（序号字段/窗口可能变了）：暂存帧按序写出，之后按新参数从下一帧重新同步
+    void reconfigure(const ParserConfig& cfg);
+
+private:
+    static constexpr size_t kHistory = 4096; // 记住最近多少个序号是否已收到（判重复/过迟）
+
+    enum class Target { NONE, RING, STASH };
+
+    void configure(const ParserConfig& cfg);
+
+    int64_t distance(uint64_t seq) const;    // (seq - expected_) 按模 2^bits 的有符号距离
+    void advance(bool received);             // expected_ 前进一格
+    void step();                             // 处理 expected_ 对应的暂存槽（写入主环或计丢失）
+    void jump(uint64_t gap);                 // 暂存为空时一次跨过 gap 个缺失序号
+    void drain();                            // 写出从 expected_ 开始已连续的暂存帧
+    void resync(uint64_t seq);
+    bool history_get(uint64_t seq) const { return (history_[(seq % kHistory) / 64] >> (seq % 64)) & 1; }
+    void history_set(uint64_t seq, bool v) {
+        uint64_t& w = history_[(seq % kHistory) / 64];
+        w = v ? (w | (uint64_t(1) << (seq % 64))) : (w & ~(uint64_t(1) << (seq % 64)));
+    }
+
+    DecodedFrameRing& ring_;
+    RuntimeStats&     stats_;
+    bool     tracking_ = false;
+    uint64_t mask_     = ~uint64_t(0);
+    size_t   window_   = 0;
+    size_t   spf_;
+
+    bool     started_   = false;
+    uint64_t expected_  = 0;
+    size_t   head_      = 0; // expected_ 对应的暂存槽
+    size_t   stashed_   = 0;
+    int64_t  ahead_max_ = 0; // 暂存帧相对 expected_ 的最大超前距离
+
+    std::vector<uint16_t> stash_;
+    std::vector<int64_t>  stash_ts_;
+    std::vector<uint8_t>  stash_full_;
+    std::vector<uint64_t> history_;
+
+    Target   pending_      = Target::NONE;
+    int64_t  pending_ts_   = 0;
+    int64_t  pending_dist_ = 0;
+};
+
+// ========================= 定长帧队列（SPSC，有界） =========================
+// 扇出模式下每个抓包线程解码进自己的队列，再由合并线程按时间戳有序搬进主环。
+// 与 DecodedFrameRing 相同的 reserve/commit 写接口；满时 reserve 返回 nullptr，生产者从不阻塞。
+class FrameQueue {
+public:
+    FrameQueue(size_t capacity, int samples_per_frame);
+
+    // ---- 生产者 ----
+    uint16_t* reserve_frame() {
+        const uint64_t t = tail_.load(std::memory_order_relaxed);
+        if (t - head_.load(std::memory_order_acquire) >= capacity_) return nullptr;
+        return &data_[static_cast<size_t>(t & mask_) * static_cast<size_t>(spf_)];
+    }
+    // epoch：解码该帧所用解析计划的 epoch，合并线程据此在主环里分段
+    void commit_frame(int64_t ts_ns, uint64_t seq = 0, uint64_t epoch = 0) {
+        const uint64_t t = tail_.load(std::memory_order_relaxed);
+        ts_ns_[static_cast<size_t>(t & mask_)] = ts_ns;
+        seq_[static_cast<size_t>(t & mask_)]   = seq;
+        epoch_[static_cast<size_t>(t & mask_)] = epoch;
+        tail_.store(t + 1, std::memory_order_release);
+    }
+
+    // ---- 消费者 ----
+    // 队首帧；空时返回 nullptr
+    const uint16_t* front(int64_t& ts_ns, uint64_t& seq, uint64_t& epoch) const {
+        const uint64_t h = head_.load(std::memory_order_relaxed);
+        if (h == tail_.load(std::memory_order_acquire)) return nullptr;
+        ts_ns = ts_ns_[static_cast<size_t>(h & mask_)];
+        seq   = seq_[static_cast<size_t>(h & mask_)];
+        epoch = epoch_[static_cast<size_t>(h & mask_)];
+        return &data_[static_cast<size_t>(h & mask_) * static_cast<size_t>(spf_)];
+    }
+    void pop() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+private:
+    size_t capacity_;
+    size_t mask_;
+    int    spf_;
+    std::vector<uint16_t> data_;
+    std::vector<int64_t>  ts_ns_;
+    std::vector<uint64_t> seq_;   // 头部序号，由合并线程交给 SeqReorderBuffer
+    std::vector<uint64_t> epoch_;
+    alignas(64) std::atomic<uint64_t> head_{0};
+    alignas(64) std::atomic<uint64_t> tail_{0};
 };
 
 // ========================= 包络/平滑（与原逻辑一致） =========================
 struct Envelope {
-    std::vector<double> x;     // seconds, length = bins
+    std::vector<double> x;     // seconds relative to the newest frame (from capture timestamps), length = bins
     std::vector<double> ymin;  // min per bin
     std::vector<double> ymax;  // max per bin
     std::vector<double> mean;  // mean per bin
 };
 
+// 窗口内的帧范围由时间索引二分得到，bins 按帧均分，x 取各 bin 的实际时间
 Envelope build_envelope(const DecodedFrameRing& ring,
                         uint64_t widx_snapshot,
                         int channel,
-                        double fps,
                         double window_seconds,
                         int bins);
 
+// 多通道包络：对 channels 一次遍历窗口，各通道共用 bin 划分与 x。
+// 64 个绘图各调一次 build_envelope 会把同样的帧行读 64 遍；这里每个 bin 只读一遍，
+// 相邻通道（间隔不大时连同中间未选通道）按一段连续样本向量化归约
+struct MultiEnvelope {
+    std::vector<int>    channels;        // 升序、去重
+    int                 bins = 0;
+    double              window_seconds = 0;
+    uint64_t            widx = 0;        // 计算时的写指针快照
+    std::vector<double> x;               // bins 个，各通道共用
+    std::vector<double> ymin, ymax, mean; // 通道主序：[slot * bins + b]
+
+    int slot_of(int ch) const {          // 不在集合内返回 -1
+        const auto it = std::lower_bound(channels.begin(), channels.end(), ch);
+        return it != channels.end() && *it == ch ? static_cast<int>(it - channels.begin()) : -1;
+    }
+};
+
+// out 可复用（只在尺寸变化时重新分配）；channels 无需有序
+void build_envelopes(const DecodedFrameRing& ring,
+                     uint64_t widx_snapshot,
+                     const std::vector<int>& channels,
+                     double window_seconds,
+                     int bins,
+                     MultiEnvelope& out);
+
+// 滑动包络：bin 边界固定在绝对帧号上（第 k 个 bin 为 [k*fpb, (k+1)*fpb)），
+// 每次 update 只累加上次之后新到的帧——已完成的 bin 不再重算，最老的随窗口滑出，未满的头 bin 原地合并。
+// fpb 取窗口帧数 / bins 向上取整，偏离超过 ±10% 才重建，因此帧率抖动不会让 bin 边界在帧上来回漂
+// （build_envelopes 的 floor(b * frames_per_bin) 每次都重新划分，曲线会闪）。
+// 输出与 build_envelopes 同布局，恒为最近 bins 个 bin（最后一个可能未满）；
+// bins × fpb 与窗口帧数相差不超过约 10%，最左侧 bin 可能落在窗口之外一点。
+class SlidingEnvelope {
+public:
+    // bin 划分：第 k 个 bin 为 [k*fpb, (k+1)*fpb)。多个实例各管一部分通道时必须共用同一划分，
+    // 否则各自按自己的时机重建，bin 落在不同的帧上，x 对不齐
+    struct Grid {
+        int      bins = 0;
+        double   window = 0;
+        uint64_t fpb = 0;        // 0：尚未建立或窗口内没有帧
+        uint64_t start = 0;      // 建立时的起始帧（不早于当时环内最老的帧）
+        uint64_t first_bin = 0;  // start 所在的 bin，输出不早于它
+        uint64_t gen = 0;        // 每次重建递增，实例据此丢弃按旧划分累加的数据
+        uint64_t widx = 0;       // 本次规划对应的写指针
+        int64_t  t_end_ns = 0;   // 最新帧的时间戳（x 的零点）
+    };
+
+    // 按 widx 推进划分：首次、窗口或 bins 变化、fpb 偏离超过 ±10%、或距上次规划超过一整窗/已出环时重建。
+    // 共用划分时由一方调用一次，再把同一个 g 交给各实例的 update
+    static void plan(const DecodedFrameRing& ring, uint64_t widx_snapshot, double window_seconds, int bins, Grid& g);
+
+    // 换环后必须调用：累加状态引用的是旧环的帧号
+    void reset() { valid_ = false; own_.fpb = 0; }
+
+    // 参数同 build_envelopes；自带划分，通道集合、窗口或 bins 变化时自动重建
+    void update(const DecodedFrameRing& ring,
+                uint64_t widx_snapshot,
+                const std::vector<int>& channels,
+                double window_seconds,
+                int bins,
+                MultiEnvelope& out);
+
+    // 按外部给定的划分（先 plan 过）累加 channels；通道集合变化或本实例落后时只在该划分上重新累加
+    void update(const DecodedFrameRing& ring, const std::vector<int>& channels, const Grid& g, MultiEnvelope& out);
+
+    uint64_t frames_per_bin() const { return fpb_; }
+    uint64_t rebuilds() const       { return rebuilds_; } // 整体重建次数（换窗口、帧率大变、落后过多、换通道）
+
+private:
+    void restart(const DecodedFrameRing& ring, const Grid& g);
+    void accumulate(const DecodedFrameRing& ring, uint64_t f0, uint64_t f1, uint64_t widx, size_t slot);
+
+    struct Run { int c0, n; size_t first_slot, nslots; };
+
+    Grid             own_;           // 单独使用时的划分
+    bool             valid_ = false;
+    uint64_t         gen_ = 0;       // 累加状态所属划分的 gen
+    std::vector<int> chs_;
+    std::vector<Run> runs_;
+    int              bins_ = 0;
+    uint64_t         fpb_ = 1;
+    uint64_t         done_ = 0;      // 已累加到的帧（不含）
+    uint64_t         head_ = 0;      // 正在累加的 bin 号
+    uint64_t         first_bin_ = 0; // 本实例重新累加后第一个有数据的 bin
+    uint64_t         rebuilds_ = 0;
+
+    // 以 bin 号 % bins 为槽位的环；通道数据为 [槽位 * 通道数 + slot]
+    std::vector<uint16_t> mn_, mx_;
+    std::vector<uint64_t> sum_;
+    std::vector<uint64_t> cnt_;
+    std::vector<int64_t>  t0_, t1_;  // bin 内首尾帧的时间戳
+    std::vector<uint16_t> tmp_mn_, tmp_mx_;
+    std::vector<uint64_t> tmp_sum_;
+};
+
+// 原始曲线的 M4 降采样：窗口按时间均分为 columns 列（取绘图区的像素宽），每列输出首样本、min、max、尾样本，
+// 按时间顺序最多 4 点；min/max 走 range_stats（有金字塔时不逐帧扫描），位置取该列首尾时间的中点。
+// 折线逐像素栅格化时与画出窗口内全部样本的结果一致，单帧毛刺不会因抽样而消失。
+// x 为相对最新帧的秒数；返回点数
+size_t decimate_m4(const DecodedFrameRing& ring,
+                   uint64_t widx_snapshot,
+                   int channel,
+                   double window_seconds,
+                   int columns,
+                   std::vector<double>& x,
+                   std::vector<double>& y);
+
 void smooth_ema(std::vector<double>& y, double dt_sec, double tau_ms);
-void smooth_mavg(std::vector<double>& y, int w);
\ No newline at end of file
+void smooth_mavg(std::vector<double>& y, int w);
+
+// 一阶 RC 高通（原地），dt 为相邻点间隔（秒）；fc_hz <= 0 时不处理
+void high_pass_rc(double* y, size_t n, double dt, double fc_hz);
\ No newline at end of file
@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Core.hpp"
+#include "Metrics.hpp"
+
+// 某通道在当前快照里的切片（指针指向 EnvelopeAggregator 的前台缓冲，下次 acquire 前有效）
+struct EnvelopeSlice {
+    const double* x    = nullptr;
+    const double* ymin = nullptr;
+    const double* ymax = nullptr;
+    const double* mean = nullptr;
+    const double* hpf  = nullptr; // 快照的高通截止频率与调用方一致时非空
+    int      bins = 0;
+    uint64_t widx = 0;
+};
+
+// 所有绘图共用的包络聚合，在后台线程池上计算：
+//   GUI 线程每个重绘周期 request(widx) 投递最新写指针（不等待），再 acquire() 换入最近完成的快照；
+//   工作线程把通道分段并行更新各段的 SlidingEnvelope（共用一套 bin 划分，只累加上次之后的新帧）并算 mean 的高通，
+//   完成后发布到三缓冲。
+// paintGL 只读前台快照；计算赶不上刷新时继续画上一份完成的结果（旧一点，但界面不卡）。
+// 请求在忙时合并，只保留最新的一个。
+class EnvelopeAggregator {
+public:
+    // threads <= 0：取 min(4, 硬件线程数 / 2)，至少 1
+    explicit EnvelopeAggregator(int threads = 0);
+    ~EnvelopeAggregator();
+
+    // 换环前先 attachRing(nullptr)：会等在途的计算结束，之后旧环可以安全释放
+    void attachRing(const DecodedFrameRing* ring);
+    void setChannels(const std::vector<int>& channels);
+    void setView(double window_seconds, int bins);
+    void setHighPassCutHz(double hz);
+    // 可为空：每次多通道更新从开始计算到发布的耗时记入 ENVELOPE_PASS
+    void setMetrics(PipelineMetrics* m) { metrics_.store(m, std::memory_order_relaxed); }
+
+    // ---- GUI 线程 ----
+    void request(uint64_t widx);
+    bool acquire();                       // 换入了新快照时返回 true
+    bool hasSnapshot() const;
+    uint64_t snapshotWriteIndex() const;  // 前台快照对应的写指针
+    // ch 的切片；没有快照、通道不在集合内或窗口/bins 与调用方不一致时返回 false（调用方自行计算）
+    bool slice(int ch, double window_seconds, int bins, double hpf_cut_hz, EnvelopeSlice& out) const;
+
+private:
+    struct Config {
+        const DecodedFrameRing* ring = nullptr;
+        uint64_t         epoch = 0;   // attachRing 时递增，旧环算出的快照随之作废
+        uint64_t         version = 0; // 任何设置变化时递增，用于合并重复请求
+        std::vector<int> channels;
+        double           windowSec = 1.0;
+        int              bins      = 1200;
+        double           hpfCutHz  = 50.0;
+    };
+    struct Snapshot {
+        bool          valid = false;
+        uint64_t      epoch = 0;
+        double        hpfCutHz = 0;
+        MultiEnvelope env;
+        std::vector<double> hpf;      // 与 env.mean 同布局
+    };
+
+    void worker_loop(int index);
+    void compute_part(int part);
+    void publish();
+
+    // 配置与请求（mu_ 保护）
+    mutable std::mutex      mu_;
+    std::condition_variable cv_;       // 有新请求 / 新任务 / 退出
+    std::condition_variable idle_cv_;  // 任务完成
+    Config   cfg_;
+    uint64_t pending_widx_ = 0;
+    bool     pending_      = false;
+    bool     busy_         = false;
+    bool     quit_         = false;
+    uint64_t job_gen_      = 0;
+    uint64_t last_req_widx_    = ~uint64_t(0);
+    uint64_t last_req_version_ = ~uint64_t(0);
+
+    // 当前任务（busy_ 期间只由工作线程读写）
+    Config   job_;
+    uint64_t job_widx_ = 0;
+    int64_t  job_t0_   = 0;
+    int      job_parts_ = 0;
+    std::vector<std::vector<int>> part_channels_;
+    std::vector<MultiEnvelope>    part_env_;
+    std::vector<SlidingEnvelope>  part_slide_;  // 各段的滑动状态，跨任务保留
+    SlidingEnvelope::Grid         grid_;        // 各段共用的 bin 划分，由 0 号线程开任务时推进
+    uint64_t                      grid_epoch_ = 0;
+    std::vector<uint64_t>         part_epoch_;  // 各段滑动状态所属的环
+    std::atomic<int> parts_left_{0};
+
+    // 三缓冲：前台归 GUI，后台归当前任务的发布者，中间由 middle_ 原子交换（kFresh 表示有未取走的新结果）
+    static constexpr int kFresh = 4;
+    Snapshot         bufs_[3];
+    int              front_ = 0;
+    int              back_  = 2;
+    std::atomic<int> middle_{1};
+    uint64_t         gui_epoch_ = 0; // GUI 线程看到的 epoch
+
+    std::atomic<PipelineMetrics*> metrics_{nullptr};
+    std::vector<std::thread> threads_;
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Core.hpp"
+
+// ========================= 合成帧生成 =========================
+// 按任意 ParserConfig 构造完整 UDP 负载（header + payload + tail），用于没有真实传感器时的容量测试。
+// 样本是帧号的确定性函数：同一 (配置, 帧号) 总生成同样的字节，接收端可以逐帧校验。
+
+enum class GenWaveform {
+    SINE,     // 每通道一条正弦，通道 c 的频率为 freq_hz * (1 + c / 64)
+    RAMP,     // 锯齿：(帧号 + 通道) 按位宽回绕
+    COUNTER,  // 前 kCounterChannels 个通道按位宽切片放帧号（接收端 decode_counter 还原），其余为 RAMP
+};
+
+struct GeneratorConfig {
+    GenWaveform waveform  = GenWaveform::SINE;
+    double      amplitude = 0.8;     // 相对满量程 0..1
+    double      freq_hz   = 50.0;    // SINE 基频（按 fps 换算成每帧相位步进）
+    double      fps       = 20000.0; // 只用于 SINE 的相位，不控制发送速率
+    uint64_t    seq_start = 0;       // 写进头部序号字段的起始值（cfg.seq_offset >= 0 时）
+};
+
+class FrameGenerator {
+public:
+    static constexpr int kCounterChannels = 4;
+
+    FrameGenerator(const ParserConfig& cfg, const GeneratorConfig& gen);
+
+    // 配置不自洽（见 validate_parser_config）时为 false
+    bool ok(std::string& why) const;
+
+    int frame_bytes() const { return cfg_.frame_size_bytes; }
+    const ParserConfig& parser_config() const { return cfg_; }
+
+    // 生成第 index 帧的样本与完整负载；out 至少 frame_bytes() 字节
+    void samples(uint64_t index, uint16_t* out) const;
+    void make(uint64_t index, uint8_t* out);
+
+    // 从 COUNTER 波形的一帧样本还原帧号（低 kCounterChannels * bits 位）
+    static uint64_t decode_counter(const uint16_t* samples, const ParserConfig& cfg);
+
+private:
+    ParserConfig          cfg_;
+    GeneratorConfig       gen_;
+    std::string           why_;
+    std::vector<uint32_t> phase_inc_;   // SINE：每通道每帧的相位步进（2^32 为一周）
+    std::vector<uint16_t> sine_;        // SINE：一周 2^kSineLog2 点，已按幅度/位宽换算
+    std::vector<uint16_t> scratch_;
+
+    static constexpr int kSineLog2 = 12;
+};
+
+// ========================= UDP 发送 =========================
+struct SenderOptions {
+    char   dst_addr[64]  = "127.0.0.1";
+    int    dst_port      = 2827;
+    double rate_fps      = 20000.0; // <= 0 表示不控速（尽快）
+    uint64_t count       = 0;       // 发送帧数；0 表示一直发到 running 变为 false
+    int    batch         = 32;      // 每次 sendmmsg 最多的报文数
+    int    sndbuf_bytes  = 16 << 20;
+};
+
+struct SenderStats {
+    std::atomic<uint64_t> frames_sent{0};
+    std::atomic<uint64_t> bytes_sent{0};
+    std::atomic<uint64_t> send_errors{0};   // sendmmsg 失败（ENOBUFS 等）而放弃的帧
+    std::atomic<int64_t>  wall_ns{0};       // 第一帧到最后一帧的墙钟耗时
+};
+
+// 每批 sendmmsg 之前回调：帧号 [first, first + n) 与发送时刻（CLOCK_REALTIME 纳秒）。
+// 放在系统调用之前：回环上 sendmmsg 返回前接收端可能已经收到
+using SendCallback = std::function<void(uint64_t first, int n, int64_t ts_ns)>;
+
+// 在调用线程上按 rate_fps 均匀发送（按“到期帧数”成批，速率低时每批自然只有 1 帧）。
+// 出错返回 false 并给出 why；正常结束（发满 count 或 running 变 false）返回 true
+bool run_udp_sender(FrameGenerator& gen, const SenderOptions& opt, const std::atomic<bool>& running,
+                    SenderStats& stats, std::string& why, const SendCallback& on_send = {});
@@ -1,11 +1,16 @@
 #pragma once
+#include <QElapsedTimer>
 #include <QMainWindow>
 #include <QVector>
 #include <memory>
 #include "Core.hpp"
+#include "Metrics.hpp"
 #include "PcapWorker.hpp"
 
 class PlotWidget;
+class RepaintScheduler;
+class EnvelopeAggregator;
+class Recorder;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -20,26 +25,58 @@ private slots:
 
     void onApplyParserConfig();   // 解析配置（可热切换）
     void onRebuildPlots();        // 视图变化 → 重建
+    void onInspectChanged();      // 采样包检查参数
+    void onShowPackets();         // 查看最近采样的包
+    void onToggleRecord(bool on); // 开始/停止录制到文件
+    void onStatsUpdated(quint64 framesRx, quint64 framesDrop, quint64 bytesRx); // 刷新统计面板
+    void onDumpStats();           // 计数器与各阶段分位数存为 JSON
 
 private:
+    ParserConfig parserConfigFromUi() const;
     bool validateParserConfig(QString& why) const;
     void rebuildRingAndReconnect();
+    RingOptions ringOptions() const;
+    size_t ringFrames(const RingOptions& opt) const; // 按内存预算 / 历史秒数推出容量
     QVector<int> parseChannelExpr(const QString& expr, int maxCh) const;
     void rebuildPlots();
+    void stopRecording();
+    void buildStatsDock();
 
     // 数据与采集
     std::unique_ptr<DecodedFrameRing> ring_;
     std::unique_ptr<RuntimeStats> stats_;
+    std::unique_ptr<PacketInspector> inspector_;
+    std::unique_ptr<PipelineMetrics> metrics_;    // 各阶段耗时直方图（抓包线程、包络池与绘图共用）
     PcapWorker* worker_ = nullptr;
+    Recorder*   recorder_ = nullptr;
 
     // 顶部抓包控制
     QWidget* central_ = nullptr;
     class QLineEdit* ifEdit_ = nullptr;
     class QLineEdit* bpfEdit_ = nullptr;
+    class QComboBox* backendCombo_ = nullptr;
+    class QLineEdit* bindEdit_ = nullptr;      // UDP_SOCKET: "addr:port"
+    class QSpinBox*  rxThreadsSpin_ = nullptr; // TPACKET_V3 扇出线程数
+    class QComboBox* fanoutCombo_ = nullptr;   // 扇出策略
+    class QLineEdit* replayEdit_ = nullptr;    // REPLAY_FILE：文件路径
+    class QPushButton* replayBrowseBtn_ = nullptr;
+    class QDoubleSpinBox* replaySpeedSpin_ = nullptr; // 0 = 不控速
+    class QCheckBox* replayLoopCheck_ = nullptr;
     class QSpinBox*  binsSpin_ = nullptr;
     class QDoubleSpinBox* winSpin_ = nullptr;
+    class QSpinBox*  fpsSpin_ = nullptr;      // 0 = 跟随显示刷新率
     class QPushButton* startBtn_ = nullptr;
     class QPushButton* stopBtn_  = nullptr;
+    class QPushButton* recordBtn_ = nullptr;   // 可切换：录制中/停止
+    class QToolButton* statsBtn_ = nullptr;    // 显示/隐藏统计面板
+
+    // 统计面板
+    class QDockWidget*  statsDock_ = nullptr;
+    class QLabel*       statsLabel_ = nullptr; // 吞吐与丢包计数
+    class QTableWidget* statsTable_ = nullptr; // 每阶段一行：count / p50 / p90 / p99 / p99.9 / max
+    QElapsedTimer statsClock_;
+    quint64 lastFramesRx_ = 0;
+    quint64 lastBytesRx_  = 0;
 
     // 解析配置 UI
     class QComboBox* packCombo_ = nullptr;
@@ -49,7 +86,23 @@ private:
     class QSpinBox*  headerSpin_ = nullptr;
     class QSpinBox*  payloadSpin_ = nullptr;
     class QSpinBox*  tailSpin_ = nullptr;
+    class QSpinBox*  seqOffsetSpin_ = nullptr; // 头部序号偏移，-1 = 不跟踪
+    class QComboBox* seqBytesCombo_ = nullptr;
+    class QCheckBox* seqBeCheck_ = nullptr;
+    class QSpinBox*  reorderSpin_ = nullptr;   // 重排窗口（帧）
+    class QComboBox* layoutCombo_ = nullptr;   // 环存储布局
+    class QSpinBox*  ringMbSpin_ = nullptr;    // 环的内存预算（MB）
+    class QDoubleSpinBox* ringSecSpin_ = nullptr; // 目标历史秒数，0 = 用满预算
     class QPushButton* applyCfgBtn_ = nullptr;
+    // 当前环建立时的环设置；与界面一致且样本几何不变时，Apply Parser Config 热切换而不重建环
+    int    ringBuiltLayout_ = -1;
+    int    ringBuiltMb_     = 0;
+    double ringBuiltSec_    = 0;
+
+    // 采样包检查
+    class QComboBox* inspectCombo_ = nullptr;  // Off / 1-in-N / N per second
+    class QSpinBox*  inspectRateSpin_ = nullptr;
+    class QPushButton* packetsBtn_ = nullptr;
 
     // 视图控制
     class QLineEdit* channelEdit_ = nullptr;   // "0,1,5,10-20"
@@ -69,4 +122,6 @@ private:
     class QWidget*   plotsContainer_ = nullptr;
     class QGridLayout* grid_ = nullptr;
     QVector<PlotWidget*> plots_;
+    RepaintScheduler* scheduler_ = nullptr;
+    std::unique_ptr<EnvelopeAggregator> envAgg_; // 所有绘图共用的包络
 };
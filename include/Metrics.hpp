@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <time.h>
+#include "Core.hpp"
+
+// ========================= 计时 =========================
+// 阶段耗时用单调时钟（x86 上经 vDSO 读 TSC，一次约 20 ns，跨线程可比）；
+// 与抓包时间戳（CLOCK_REALTIME）比较的端到端延迟用实时时钟
+inline int64_t metrics_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+inline int64_t metrics_realtime_ns() {
+    timespec ts{};
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// ========================= 延迟直方图 =========================
+// HDR 式对数-线性分桶：[0, 16) 每纳秒一桶，之后每个 2 的幂区间均分 16 桶（相对误差 < 1/16），
+// 覆盖全部 int64 范围。record 只有几次 relaxed 原子操作，多个写线程无锁并发；
+// 读者随时取摘要（各桶不是同一瞬间的值，做统计足够）。
+class LatencyHistogram {
+public:
+    static constexpr int kSubBits = 4;
+    static constexpr int kSub     = 1 << kSubBits;
+    static constexpr int kBuckets = (64 - kSubBits + 1) * kSub;
+
+    void record(int64_t ns) {
+        const uint64_t v = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+        counts_[bucket_of(v)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(v, std::memory_order_relaxed);
+        uint64_t m = max_.load(std::memory_order_relaxed);
+        while (v > m && !max_.compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+    }
+
+    struct Summary {
+        uint64_t count = 0;
+        double   mean_ns = 0;
+        uint64_t p50_ns = 0, p90_ns = 0, p99_ns = 0, p999_ns = 0, max_ns = 0;
+    };
+    Summary summary() const;
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    void reset(); // 与 record 并发时可能漏掉个别样本
+
+    static int bucket_of(uint64_t v) {
+        if (v < uint64_t(kSub)) return static_cast<int>(v);
+        const int e = 63 - __builtin_clzll(v); // >= kSubBits
+        return (e - kSubBits + 1) * kSub + static_cast<int>((v >> (e - kSubBits)) & (kSub - 1));
+    }
+    // 桶 i 覆盖 [lower, lower + width)
+    static uint64_t bucket_lower(int i);
+    static uint64_t bucket_width(int i);
+
+private:
+    std::atomic<uint64_t> counts_[kBuckets] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+// ========================= 流水线各阶段 =========================
+// 抓包线程对每线程每 kSampleEvery 个包采一次（一次取时约 20 ns，逐包计时会与解包本身同量级）；
+// GUI 侧的阶段每次都记录
+enum class PipelineStage {
+    CAPTURE_TO_DEQUEUE, // 抓包时间戳 → RX 线程取到该包（内核队列 + 唤醒延迟）
+    UNPACK,             // 解包进槽位
+    RING_PUBLISH,       // 序号跟踪/重排 + 写入主环（转置/打包、金字塔、发布）
+    ENVELOPE_PASS,      // 后台包络池的一次多通道更新（请求 → 发布到三缓冲）
+    ENVELOPE_PLOT,      // 单个绘图取包络（共享快照切片，或回退时自行计算）
+    PAINT,              // 单个绘图 paintGL
+    PACKET_TO_PIXEL,    // 所画最新一帧的抓包时间戳 → paintGL 结束
+    kCount
+};
+const char* pipeline_stage_name(PipelineStage s);
+
+struct PipelineMetrics {
+    static constexpr uint32_t kSampleEvery = 64;
+
+    LatencyHistogram stage[static_cast<int>(PipelineStage::kCount)];
+
+    LatencyHistogram&       operator[](PipelineStage s)       { return stage[static_cast<int>(s)]; }
+    const LatencyHistogram& operator[](PipelineStage s) const { return stage[static_cast<int>(s)]; }
+    void reset();
+};
+
+// 计数器与各阶段分位数（纳秒）的 JSON；stats / metrics 可为空（对应部分省略）
+std::string pipeline_stats_json(const RuntimeStats* stats, const PipelineMetrics* metrics);
@@ -0,0 +1,97 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ========================= 各层长度解析 =========================
+// 支持 Ethernet(含 VLAN/QinQ)、Linux SLL/SLL2、NULL、RAW 链路类型；
+// 仅解析，不打印，供采样检查器与 GUI 使用。
+struct FrameLayers {
+    int      linktype        = 0;
+    size_t   caplen          = 0;
+    size_t   link_len        = 0;
+    uint16_t ether_type      = 0;
+    uint8_t  ip_version      = 0;  // 4 / 6，0 表示非 IP
+    size_t   ip_len          = 0;  // IP 头长度
+    uint8_t  proto           = 0;  // IPv4 proto / IPv6 next header
+    bool     is_udp          = false;
+    size_t   udp_len         = 0;  // UDP 头长度（8）
+    size_t   udp_payload_len = 0;
+    uint8_t  src[16]{};            // IPv4 用前 4 字节
+    uint8_t  dst[16]{};
+    uint16_t sport           = 0;
+    uint16_t dport           = 0;
+};
+
+// 返回是否解析成功；失败时 out 中已解析到的字段仍然有效
+bool decode_frame_layers(const uint8_t* pkt, size_t caplen, int linktype, FrameLayers& out);
+
+// 与原先 [LEN] 调试行相同的文字格式
+std::string format_frame_layers(const FrameLayers& l);
+
+// UDP_SOCKET 后端没有 L2/L3 头，记录的字节即 UDP 负载
+constexpr int kLinktypeUdpPayload = -1;
+
+// ========================= 采样包检查器 =========================
+// RX 线程按采样率把少量包（解析结果 + 前若干字节）写入无锁侧缓冲；
+// GUI 需要时调用 snapshot() 读取。未命中采样时热路径只有一两次整数比较：
+// PER_SECOND 的 1 秒窗口按调用方传入的抓包时间戳划分，不在每包读时钟。
+enum class InspectMode { OFF, ONE_IN_N, PER_SECOND };
+
+struct PacketSample {
+    uint64_t    packet_index = 0; // 检查器看到的第几个包
+    uint32_t    wirelen      = 0;
+    bool        decoded      = false;
+    FrameLayers layers;
+    uint16_t    nbytes       = 0;
+    uint8_t     bytes[64]{};      // 包头部原始字节
+};
+
+class PacketInspector {
+public:
+    explicit PacketInspector(size_t capacity = 256);
+
+    // 任意线程可调用；rate 对 ONE_IN_N 为 N，对 PER_SECOND 为每秒样本数
+    void configure(InspectMode mode, int rate);
+    InspectMode mode() const { return static_cast<InspectMode>(mode_.load(std::memory_order_relaxed)); }
+    int rate() const { return rate_.load(std::memory_order_relaxed); }
+
+    // RX 线程（单写者）：每包调用一次，命中采样时解析并记录；ts_ns 为该包的抓包时间戳
+    inline void offer(const uint8_t* pkt, size_t caplen, size_t wirelen, int linktype, int64_t ts_ns) {
+        const int m = mode_.load(std::memory_order_relaxed);
+        if (m == static_cast<int>(InspectMode::OFF)) return;
+        const uint64_t idx = seen_++;
+        if (!should_sample(static_cast<InspectMode>(m), ts_ns)) return;
+        record(idx, pkt, caplen, wirelen, linktype);
+    }
+
+    // GUI：读取最近最多 max 个样本（按时间先后），跳过正在被覆盖的槽
+    std::vector<PacketSample> snapshot(size_t max) const;
+
+    static std::string format_sample(const PacketSample& s);
+
+private:
+    bool should_sample(InspectMode m, int64_t ts_ns);
+    void record(uint64_t idx, const uint8_t* pkt, size_t caplen, size_t wirelen, int linktype);
+
+    struct Slot {
+        std::atomic<uint64_t> seq{0}; // 奇数：写入中；偶数：稳定
+        PacketSample sample;
+    };
+
+    std::atomic<int> mode_{static_cast<int>(InspectMode::OFF)};
+    std::atomic<int> rate_{1000};
+
+    // 以下仅 RX 线程访问
+    uint64_t seen_        = 0;
+    uint64_t n_counter_   = 0;
+    int64_t  sec_start_ns_ = 0;
+    int      sec_count_   = 0;
+
+    size_t                  capacity_;
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<uint64_t>   written_{0}; // 已写入样本总数
+};
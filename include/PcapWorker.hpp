@@ -1,11 +1,25 @@
 #pragma once
 #include <atomic>
+#include <memory>
 #include <thread>
+#include <vector>
 #include <pcap/pcap.h>
 #include <pcap/dlt.h>
 #include <QObject>
+#include <QTimer>
 #include <QtGlobal>
 #include "Core.hpp"
+#include "Metrics.hpp"
+#include "PacketInspector.hpp"
+
+// 抓包后端：libpcap 逐包读取，或 AF_PACKET TPACKET_V3 mmap 块环（一次唤醒处理整块），
+// 或本机即目的地址时直接绑定 UDP 套接字，recvmmsg 批量收包（跳过 L2/L3 解析），
+// 或离线回放 .pcap/.pcapng（与实时抓包同一解析路径）及本程序的 .udpsrec 录制文件
+enum class CaptureBackend { PCAP, TPACKET_V3, UDP_SOCKET, REPLAY_FILE };
+
+// PACKET_FANOUT 分发策略：HASH 按流（同一流始终进同一线程），CPU 按收包 CPU（跟随网卡 RSS），
+// LB 轮询（单流也能均分，但各线程间乱序，依赖合并线程按时间戳重排）
+enum class FanoutMode { HASH, CPU, LB };
 
 struct CaptureConfig {
     char ifname[64] = "enp3s0";
@@ -13,31 +27,103 @@ struct CaptureConfig {
     bool promisc    = true;
     int  snaplen    = 2048;
     int  timeout_ms = 1;
+
+    CaptureBackend backend = CaptureBackend::PCAP;
+
+    // TPACKET_V3 环参数（仅 backend == TPACKET_V3 时使用）
+    int  tp_block_size  = 1 << 22; // 每块字节数，须为页大小的整数倍
+    int  tp_block_count = 64;      // 块数；扇出时为所有线程的总数，按 rx_threads 平分（每个套接字至少 4 块）
+    int  tp_frame_size  = 2048;    // 帧槽大小（V3 下仅作对齐提示）
+    int  tp_retire_ms   = 1;       // 块未满时的超时退役时间
+
+    // UDP 套接字参数（仅 backend == UDP_SOCKET 时使用）
+    char bind_addr[64]  = "12.0.0.1";
+    int  bind_port      = 2827;
+    int  rcvbuf_bytes   = 64 << 20; // SO_RCVBUF(FORCE)
+    int  udp_batch      = 64;       // 每次 recvmmsg 最多取的报文数
+
+    // 扇出抓包（仅 backend == TPACKET_V3 且 rx_threads > 1 时使用）：
+    // N 个线程各开一个套接字加入同一 PACKET_FANOUT 组，各自解码进独立队列，
+    // 合并线程按抓包时间戳有序写入主环
+    int        rx_threads          = 1;
+    FanoutMode fanout              = FanoutMode::HASH;
+    int        fanout_queue_frames = 4096; // 每线程队列容量（帧）
+    int        fanout_holdback_us  = 2000; // 有队列为空时，队首帧至少等待这么久再发布
+
+    // 离线回放（仅 backend == REPLAY_FILE 时使用）
+    char   replay_path[512] = "";
+    double replay_speed     = 1.0;   // 按原始时间戳 × 倍速回放；<= 0 表示不控速（尽快）
+    bool   replay_loop      = false; // 到结尾后从头再来（时间戳顺延，保持环内单调）
 };
 
 class PcapWorker : public QObject {
     Q_OBJECT
 public:
-    PcapWorker(DecodedFrameRing& ring, const CaptureConfig& cfg, RuntimeStats& stats);
+    // inspector 可为空：为空时不做任何采样；metrics 可为空：为空时不计时
+    PcapWorker(DecodedFrameRing& ring, const CaptureConfig& cfg, RuntimeStats& stats,
+               PacketInspector* inspector = nullptr, PipelineMetrics* metrics = nullptr);
     ~PcapWorker();
 
+    // 抓包中热切换解析配置：校验后发布给抓包线程（下一包起生效），主环在切换处开新段。
+    // 每帧样本数（PACKED 下还有位宽）须与主环一致，否则需要停止抓包、重建环。
+    // 失败时发出 errorOccurred 并返回 false；未在抓包时只做校验，start() 取 g_cfg
+    bool applyParserConfig(const ParserConfig& cfg);
+
 public slots:
     void start();
     void stop();
 
 signals:
-    void frameAdvanced(quint64 widx);
+    // 抓包期间每 kStatsIntervalMs 发一次（GUI 线程），stop() 时再发最后一次
     void statsUpdated(quint64 framesRx, quint64 framesDrop, quint64 bytesRx);
     void errorOccurred(QString msg);
 
 private:
+    static constexpr int kStatsIntervalMs = 500;
+
     static bool extract_udp_payload(const u_char* data, size_t caplen, int linktype,
                                     const u_char*& udp_payload, size_t& udp_payload_len);
     void rx_loop();
+    void rx_loop_pcap();
+    void rx_loop_tpacket(int queue); // queue < 0：单线程直接写主环；否则为扇出线程编号
+    void rx_loop_udp();
+    void rx_loop_replay();
+    void replay_pcap();
+    void replay_recording();
+    void merge_loop();
+    // 主环写线程（单线程抓包时的 RX 线程 / 合并线程）遇到新 epoch 时调用：重排缓冲按新配置重来，主环开新段
+    void switch_segment(const ParserPlan& plan);
+    void emitStats();
+
+    // 抓包线程的输出去向：queue 为空时直接写主环
+    struct RxSink {
+        ParserPlanView*           plan    = nullptr; // 本线程的解析计划视图
+        FrameQueue*               queue   = nullptr;
+        RuntimeStats::QueueStats* qstats  = nullptr;
+        bool                      inspect = true;    // 检查器是单写者，扇出时只由 0 号线程采样
+        mutable uint32_t          tick    = 0;       // 本线程的包计数，每 kSampleEvery 个计一次时
+    };
+
+    // 单包处理：L2/L3 解析 → ingest_udp_payload
+    // ts_ns 为抓包时间戳（CLOCK_REALTIME 纳秒），随帧写入环的时间索引
+    void ingest_packet(const u_char* pkt, size_t caplen, size_t wirelen, int linktype, int64_t ts_ns,
+                       const RxSink& sink);
+    // UDP 负载：长度校验 → 按 plan_ 直接解包进下一槽位（主环或扇出队列）→ 发布
+    void ingest_udp_payload(const uint8_t* udp_payload, size_t udp_len, int64_t ts_ns, const RxSink& sink);
 
     std::atomic<bool> running_{false};
-    std::thread       rx_thread_;
+    std::vector<std::thread> rx_threads_;
+    std::thread       merge_thread_;
+    std::vector<std::unique_ptr<FrameQueue>> queues_; // 扇出模式下每线程一个
+    std::unique_ptr<SeqReorderBuffer> reorder_;       // 主环前的序号跟踪/重排（单线程或合并线程独占）
+    ParserPlanChannel plans_;                         // start() 时发布 g_cfg，之后由 applyParserConfig 热切换
+    uint64_t          ring_epoch_ = 0;                // 主环当前段的 epoch（只由主环写线程读写）
+    int               fanout_group_ = 0;
     DecodedFrameRing& ring_;
     CaptureConfig     cfg_;
     RuntimeStats&     stats_;
+    PacketInspector*  inspector_;
+    PipelineMetrics*  metrics_;
+    bool              timeDequeue_ = false; // 回放的时间戳不是实时的，不计抓包 → 取包延迟
+    QTimer            statsTimer_;
 };
\ No newline at end of file
@@ -1,12 +1,22 @@
 #pragma once
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
 #include <QColor>
 #include <QVector>
+#include <QPointF>
 #include <QRectF>
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 class DecodedFrameRing; // 仅前置声明，定义从别处引入
+class EnvelopeAggregator;
+class SlidingEnvelope;
+struct MultiEnvelope;
+struct PipelineMetrics;
 
 // 简单 envelope 容器
 struct EnvelopeQT {
@@ -14,15 +24,22 @@ struct EnvelopeQT {
     QVector<double> ymin;
     QVector<double> ymax;
     QVector<double> mean;  // 平均（每 bin）
+    QVector<double> hpf;   // 后台已算好的 mean 高通（截止频率一致时），否则为空
+    quint64 widx = 0;      // 计算时的写指针快照
 };
 
 class PlotWidget : public QOpenGLWidget, protected QOpenGLFunctions {
     Q_OBJECT
 public:
     explicit PlotWidget(QWidget* parent=nullptr);
+    ~PlotWidget() override;
 
     // 数据源
-    void attachRing(DecodedFrameRing* ring) { ring_ = ring; }
+    void attachRing(DecodedFrameRing* ring);
+    // 共享包络：设置后优先取其后台快照中本通道的切片，取不到（尚无快照、窗口/bins 不一致等）时自己计算
+    void attachEnvelopes(const EnvelopeAggregator* agg) { envAgg_ = agg; }
+    // 可为空：记录取包络、paintGL 耗时与抓包到上屏的延迟
+    void attachMetrics(PipelineMetrics* m)      { metrics_ = m; }
 
     // 基本参数
     void setChannel(int ch)          { ch_ = ch; update(); }
@@ -43,8 +60,12 @@ public:
     void setHighPassCutHz(double hz) { hpfCutHz_ = qMax(0.0, hz); update(); }
     double highPassCutHz() const     { return hpfCutHz_; }
 
-public slots:
-    void onFrameAdvanced(quint64 /*widx*/); // 仅触发重绘
+    // 曲线渲染：默认把包络/曲线上传到 VBO 由着色器绘制；关闭或着色器不可用时退回 QPainterPath
+    void setGpuCurves(bool on)       { gpuCurves_ = on; update(); }
+    bool gpuCurvesActive() const     { return gpuCurves_ && program_ != nullptr; }
+
+    // 最近一次 paintGL 所用的写指针快照（供 RepaintScheduler 判断是否需要重绘）
+    quint64 paintedWriteIndex() const { return paintedWidx_; }
 
 protected:
     void initializeGL() override;
@@ -58,6 +79,17 @@ private:
     // 一阶高通（对 mean 的副本做）
     static void highPassRC(QVector<double>& y, double dt, double fc_hz);
 
+    // 一次重绘要画的曲线，均为数据坐标：x 为相对最新帧的秒数，y 为样本值
+    struct Curves {
+        const EnvelopeQT* env = nullptr;
+        QVector<double>   hpf;   // showHPF_ 时为 mean 的高通
+        QVector<QPointF>  raw;   // showRaw_ 时为窗口内降采样后的原始样本
+        double ymin = 0, ymax = 1;
+    };
+    void drawCurvesGL(QPainter& p, const QRectF& plotR, const Curves& c);
+    void drawCurvesPainter(QPainter& p, const QRectF& plotR, const Curves& c);
+    bool initCurveProgram();
+
     // 图例绘制与命中
     void drawLegend(QPainter& p);
     int  hitLegendItem(const QPointF& pos) const; // 返回索引，-1=miss
@@ -65,6 +97,13 @@ private:
 private:
     // 数据 & 参数
     DecodedFrameRing* ring_{nullptr};
+    const EnvelopeAggregator* envAgg_{nullptr};
+    PipelineMetrics* metrics_{nullptr};
+    // 取不到共享快照时自己算：同样按绝对帧号滑动，只累加新帧
+    mutable std::unique_ptr<SlidingEnvelope> slide_;
+    mutable std::unique_ptr<MultiEnvelope>   slideOut_;
+    std::vector<double> rawX_, rawY_; // M4 降采样的原始曲线（复用，避免每帧分配）
+    quint64 paintedWidx_{~0ull};
     int     ch_{0};
     int     bins_{1200};
     double  windowSec_{1.0};
@@ -94,6 +133,14 @@ private:
     // HPF 参数
     double  hpfCutHz_{50.0};
 
+    // GPU 曲线：一个动态 VBO 依次放 包络三角带 / mean / HPF / raw，每次重绘整体重写
+    bool    gpuCurves_{true};
+    std::unique_ptr<QOpenGLShaderProgram> program_;
+    QOpenGLBuffer            vbo_{QOpenGLBuffer::VertexBuffer};
+    QOpenGLVertexArrayObject vao_;
+    std::vector<float>       verts_;
+    int     locPos_{-1}, locXform_{-1}, locColor_{-1};
+
     // 图例 item 的可点击区域
     struct LegendItem { QString name; QColor color; bool* flag; QRectF rect; };
     mutable QVector<LegendItem> legend_;
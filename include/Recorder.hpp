@@ -0,0 +1,39 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <thread>
+#include <QObject>
+#include <QString>
+#include "Core.hpp"
+#include "Recording.hpp"
+
+// ========================= 录制器 =========================
+// 主环的第二个消费者：独立线程从开始录制时的写指针起逐帧读出，写入 .udpsrec 文件。
+// 只读环、从不阻塞 RX 线程；磁盘跟不上时积压（rec_backlog）增长，
+// 落后超过环容量的部分被跳过并计入 rec_overrun。
+class Recorder : public QObject {
+    Q_OBJECT
+public:
+    Recorder(DecodedFrameRing& ring, RuntimeStats& stats, const QString& path,
+             const RecordingOptions& opt = RecordingOptions{});
+    ~Recorder();
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void errorOccurred(QString msg);
+
+private:
+    void loop();
+
+    std::atomic<bool> running_{false};
+    std::thread       thread_;
+    DecodedFrameRing& ring_;
+    RuntimeStats&     stats_;
+    std::string       path_;
+    RecordingOptions  opt_;
+    RecordingWriter   writer_;
+    uint64_t          start_index_ = 0;
+};
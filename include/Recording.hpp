@@ -0,0 +1,166 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Core.hpp"
+
+// ========================= 录制文件格式（.udpsrec） =========================
+// 全部小端，所有偏移与长度都是 4096 的整数倍，便于 O_DIRECT 写入与 mmap 读取：
+//
+//   [0, 4096)                  RecFileHeader（其余补 0）
+//   [4096 + k*chunk_bytes, …)  第 k 个块，定长 chunk_bytes：
+//       RecChunkHeader | int64 ts[frames_per_chunk] | uint16 data[frames_per_chunk][spf] | uint16 min[spf], max[spf]
+//   [index_offset, …)          RecIndexEntry[chunk_count]（补齐到 4096）
+//
+// 块内 data 为逐帧行主序；最后一个块可能不满（RecChunkHeader::frames < frames_per_chunk）。
+// 块定长，因此即使文件没有正常收尾（index_offset == 0），也能按块头逐块恢复。
+
+constexpr char     kRecMagic[8]    = {'U','D','P','S','R','E','C','1'};
+constexpr uint32_t kRecChunkMagic  = 0x4B4E4843; // "CHNK"
+constexpr uint32_t kRecVersion     = 1;
+constexpr size_t   kRecAlign       = 4096;
+constexpr uint32_t kRecFlagMinMax  = 1u << 0;
+
+// ParserConfig 的定长落盘形式
+struct RecParserConfig {
+    int32_t frame_size_bytes, header_bytes, payload_bytes, tail_bytes;
+    int32_t bits_per_sample, samples_per_frame, pack;
+    int32_t seq_offset, seq_bytes, seq_big_endian, reorder_window;
+    int32_t reserved[5];
+};
+
+struct RecFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_bytes;       // = kRecAlign
+    uint32_t samples_per_frame;
+    uint32_t frames_per_chunk;
+    uint64_t chunk_bytes;
+    uint32_t flags;              // kRecFlagMinMax
+    uint32_t reserved0;
+    RecParserConfig parser;
+    int64_t  start_ts_ns;        // 第一帧时间戳
+    uint64_t frame_count;        // 以下三项在收尾时写入
+    uint64_t chunk_count;
+    uint64_t index_offset;       // 0 表示未正常收尾
+};
+
+struct RecChunkHeader {
+    uint32_t magic;              // kRecChunkMagic
+    uint32_t frames;             // 本块有效帧数
+    uint64_t first_frame;        // 本块首帧在文件中的序号
+    int64_t  t_first_ns, t_last_ns;
+    uint32_t ts_offset;          // 相对块起始
+    uint32_t data_offset;
+    uint32_t minmax_offset;      // 无摘要时为 0
+    uint32_t reserved[5];
+};
+static_assert(sizeof(RecChunkHeader) == 64, "RecChunkHeader must stay 64 bytes");
+
+struct RecIndexEntry {
+    uint64_t offset;             // 块在文件中的偏移
+    uint64_t first_frame;
+    int64_t  t_first_ns, t_last_ns;
+    uint32_t frames;
+    uint32_t reserved;
+};
+
+// 块内布局与大小（由帧数、通道数与是否带摘要决定）
+struct RecChunkLayout {
+    uint32_t ts_offset, data_offset, minmax_offset;
+    uint64_t chunk_bytes;
+};
+RecChunkLayout rec_chunk_layout(uint32_t frames_per_chunk, uint32_t samples_per_frame, bool with_minmax);
+
+RecParserConfig rec_pack_parser_config(const ParserConfig& c);
+ParserConfig    rec_unpack_parser_config(const RecParserConfig& r);
+
+// ========================= 写入 =========================
+// 逐帧追加到对齐的块缓冲，块满时一次 pwrite 整块（默认 O_DIRECT，文件系统不支持时退回普通写）。
+// 单线程使用；写失败时 append/close 返回 false，why() 给出原因。
+struct RecordingOptions {
+    uint32_t frames_per_chunk = 1024;
+    bool     with_minmax      = true;
+    bool     direct_io        = true;
+};
+
+class RecordingWriter {
+public:
+    RecordingWriter() = default;
+    ~RecordingWriter();
+    RecordingWriter(const RecordingWriter&) = delete;
+    RecordingWriter& operator=(const RecordingWriter&) = delete;
+
+    bool open(const std::string& path, const ParserConfig& cfg, const RecordingOptions& opt, std::string& why);
+    // 追加一帧（samples 为 samples_per_frame 个样本）；块满时同步写盘
+    bool append(const uint16_t* samples, int64_t ts_ns);
+    // 写出最后一个不满的块、索引与最终文件头
+    bool close();
+
+    bool     is_open() const     { return fd_ >= 0; }
+    bool     direct() const      { return direct_; }
+    uint64_t frames() const      { return frames_; }
+    uint64_t bytes_written() const { return bytes_; }
+    const std::string& why() const { return why_; }
+
+private:
+    bool flush_chunk();
+    bool write_all(const void* buf, size_t len, uint64_t off);
+
+    int       fd_     = -1;
+    bool      direct_ = false;
+    uint32_t  spf_    = 0;
+    uint32_t  fpc_    = 0;
+    bool      minmax_ = false;
+    RecChunkLayout layout_{};
+
+    uint8_t*  hdr_buf_   = nullptr; // kRecAlign 字节，对齐
+    uint8_t*  chunk_buf_ = nullptr; // layout_.chunk_bytes 字节，对齐
+    uint32_t  fill_      = 0;       // 当前块已填帧数
+    uint64_t  frames_    = 0;
+    uint64_t  bytes_     = 0;
+    uint64_t  next_off_  = kRecAlign;
+    std::vector<RecIndexEntry> index_;
+    std::string why_;
+};
+
+// ========================= 只读访问（mmap） =========================
+// 整个文件只读映射，块数据直接返回指向映射区的指针，不做拷贝。
+class RecordingReader {
+public:
+    RecordingReader() = default;
+    ~RecordingReader();
+    RecordingReader(const RecordingReader&) = delete;
+    RecordingReader& operator=(const RecordingReader&) = delete;
+
+    bool open(const std::string& path, std::string& why);
+    void close();
+
+    const RecFileHeader& header() const { return *hdr_; }
+    ParserConfig parser_config() const { return rec_unpack_parser_config(hdr_->parser); }
+    uint64_t frame_count() const { return frames_; }
+    size_t   chunk_count() const { return index_.size(); }
+    const RecIndexEntry& chunk_entry(size_t k) const { return index_[k]; }
+
+    // 第 k 块的时间戳与样本（行主序，frames × spf）
+    const int64_t*  chunk_timestamps(size_t k) const;
+    const uint16_t* chunk_samples(size_t k) const;
+    // 第 k 块的每通道 min/max；文件不带摘要时返回 nullptr
+    const uint16_t* chunk_min(size_t k) const;
+    const uint16_t* chunk_max(size_t k) const;
+
+    // 第一个时间戳 >= t_ns 的帧序号（全部更早时返回 frame_count()）
+    uint64_t lower_bound_time(int64_t t_ns) const;
+
+private:
+    const uint8_t* chunk_base(size_t k) const { return base_ + index_[k].offset; }
+    const RecChunkHeader& chunk_header(size_t k) const { return *reinterpret_cast<const RecChunkHeader*>(chunk_base(k)); }
+
+    int            fd_   = -1;
+    const uint8_t* base_ = nullptr;
+    size_t         size_ = 0;
+    const RecFileHeader* hdr_ = nullptr;
+    uint64_t       frames_ = 0;
+    std::vector<RecIndexEntry> index_; // 来自文件索引，或未收尾时逐块扫描重建
+};
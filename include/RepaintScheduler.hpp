@@ -0,0 +1,41 @@
+#pragma once
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QVector>
+#include <cstdint>
+
+class DecodedFrameRing;
+class EnvelopeAggregator;
+class PlotWidget;
+
+// 按显示刷新率（或指定 FPS）轮询环的写指针，只重绘数据有变化且可见的绘图。
+// RX 线程不再向 GUI 投递任何逐包事件。
+class RepaintScheduler : public QObject {
+    Q_OBJECT
+public:
+    explicit RepaintScheduler(QObject* parent=nullptr);
+
+    void attachRing(const DecodedFrameRing* ring) { ring_ = ring; }
+    // 共享包络：每个周期向后台投递写指针并换入最新完成的快照，只重绘快照有更新的绘图
+    void attachEnvelopes(EnvelopeAggregator* agg) { envAgg_ = agg; }
+    void setPlots(const QVector<PlotWidget*>& plots);
+
+    // fps <= 0：跟随主屏刷新率
+    void setTargetFps(double fps);
+    double effectiveFps() const;
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void onTick();
+
+private:
+    QTimer timer_;
+    const DecodedFrameRing* ring_{nullptr};
+    EnvelopeAggregator* envAgg_{nullptr};
+    QVector<QPointer<PlotWidget>> plots_;
+    double targetFps_{0.0};
+};
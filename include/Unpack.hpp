@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// ========================= 解包内核 =========================
+// 各打包格式的底层内核；上层入口是 Core.hpp 的 unpack_payload()。
+// 标量版本是参考实现，SIMD 版本须与之逐样本一致（tests/unpack_test.cpp 逐个内核比对）。
+
+// RAW10：每 5 字节 4 个样本，b0..b3 为低 8 位，b4 依次放 4 个样本的高 2 位
+void unpack_raw10_scalar(const uint8_t* p, int groups, uint16_t* out);
+// RAW12：每 3 字节 2 个样本，LSB 优先的连续位流
+void unpack_raw12_scalar(const uint8_t* p, int groups, uint16_t* out);
+// RAW14：每 7 字节 4 个样本，LSB 优先的连续位流
+void unpack_raw14_scalar(const uint8_t* p, int groups, uint16_t* out);
+// MIPI CSI-2 RAW10：b0..b3 为高 8 位，b4 依次放 4 个样本的低 2 位
+void unpack_mipi_raw10_scalar(const uint8_t* p, int groups, uint16_t* out);
+// MIPI CSI-2 RAW12：b0/b1 为高 8 位，b2 低/高半字节为两个样本的低 4 位
+void unpack_mipi_raw12_scalar(const uint8_t* p, int groups, uint16_t* out);
+// RAW16：小端 / 大端
+void unpack_raw16le_scalar(const uint8_t* p, int samples, uint16_t* out);
+void unpack_raw16be_scalar(const uint8_t* p, int samples, uint16_t* out);
+
+// 打包：上面各解包内核的逆（帧生成器用来构造测试帧），超出格式位宽的高位被截掉
+void pack_raw10_scalar(const uint16_t* in, int groups, uint8_t* p);
+void pack_raw12_scalar(const uint16_t* in, int groups, uint8_t* p);
+void pack_raw14_scalar(const uint16_t* in, int groups, uint8_t* p);
+void pack_mipi_raw10_scalar(const uint16_t* in, int groups, uint8_t* p);
+void pack_mipi_raw12_scalar(const uint16_t* in, int groups, uint8_t* p);
+void pack_raw16le_scalar(const uint16_t* in, int samples, uint8_t* p);
+void pack_raw16be_scalar(const uint16_t* in, int samples, uint8_t* p);
+
+// RAW10 运行时分发：按 CPU 特性选择 AVX-512BW / AVX2 / SSSE3 / 标量。
+// 环境变量 UDPSCOPE_UNPACK=scalar|ssse3|avx2|avx512 可在启动时强制指定。
+void unpack_raw10(const uint8_t* p, int groups, uint16_t* out);
+
+const char* unpack_kernel_name();
+std::vector<const char*> available_unpack_kernels();
+// 强制选择内核；CPU 不支持或名字未知时返回 false。只应在开始抓包前调用。
+bool select_unpack_kernel(const char* name);
+
+// ------------------------ 解析计划用的内核 ------------------------
+// 统一签名 (payload, count, out)：count 对 RAW16 是样本数，其余为组数。
+// 常见尺寸（RAW10 256 组 = 1024 样本、RAW16 1024 样本）返回组数/样本数编译期固定的特化实例
+// （循环边界为常量、可完全展开，count 被忽略），否则返回通用内核；*fixed 告知是否命中特化。
+// RAW10 取当前选中的 SIMD 级别的实例，所以应在 select_unpack_kernel 之后调用。
+using UnpackKernel = void (*)(const uint8_t* p, int count, uint16_t* out);
+UnpackKernel raw10_plan_kernel(int groups, bool* fixed);
+UnpackKernel raw16_plan_kernel(bool big_endian, int samples, bool* fixed);
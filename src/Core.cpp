@@ -1,55 +1,924 @@
 #include "Core.hpp"
+#include "Unpack.hpp"
+
+#include <cctype>
+#include <new>
+#include <sys/mman.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 ParserConfig g_cfg{}; // 默认值即为原先的常量，可在运行时修改其字段
 
-// 专用：RAW10 (5 bytes -> 4 samples)
-static inline bool unpack10bit_block(const uint8_t* p, int groups, uint16_t* out) {
-    for (int g = 0, o = 0; g < groups; ++g) {
-        const uint8_t b0 = p[g*5 + 0];
-        const uint8_t b1 = p[g*5 + 1];
-        const uint8_t b2 = p[g*5 + 2];
-        const uint8_t b3 = p[g*5 + 3];
-        const uint8_t b4 = p[g*5 + 4];
-        out[o++] = static_cast<uint16_t>( b0 | ((b4 & 0x03) << 8) );
-        out[o++] = static_cast<uint16_t>( b1 | ((b4 & 0x0C) << 6) );
-        out[o++] = static_cast<uint16_t>( b2 | ((b4 & 0x30) << 4) );
-        out[o++] = static_cast<uint16_t>( b3 | ((b4 & 0xC0) << 2) );
+PackGeometry pack_geometry(PackMode m) {
+    switch (m) {
+    case PackMode::RAW10_PACKED: return {5, 4, 10};
+    case PackMode::RAW16_LE:     return {2, 1, 16};
+    case PackMode::RAW12_PACKED: return {3, 2, 12};
+    case PackMode::RAW14_PACKED: return {7, 4, 14};
+    case PackMode::MIPI_RAW10:   return {5, 4, 10};
+    case PackMode::MIPI_RAW12:   return {3, 2, 12};
+    case PackMode::RAW16_BE:     return {2, 1, 16};
+    }
+    return {0, 0, 0};
+}
+
+const char* pack_mode_name(PackMode m) {
+    switch (m) {
+    case PackMode::RAW10_PACKED: return "RAW10_PACKED";
+    case PackMode::RAW16_LE:     return "RAW16_LE";
+    case PackMode::RAW12_PACKED: return "RAW12_PACKED";
+    case PackMode::RAW14_PACKED: return "RAW14_PACKED";
+    case PackMode::MIPI_RAW10:   return "MIPI_RAW10";
+    case PackMode::MIPI_RAW12:   return "MIPI_RAW12";
+    case PackMode::RAW16_BE:     return "RAW16_BE";
+    }
+    return "UNKNOWN";
+}
+
+bool pack_mode_from_name(const std::string& name, PackMode& out) {
+    std::string up = name;
+    for (char& ch : up) ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+    if (up == "RAW10") up = "RAW10_PACKED";
+    else if (up == "RAW12") up = "RAW12_PACKED";
+    else if (up == "RAW14") up = "RAW14_PACKED";
+    else if (up == "RAW16") up = "RAW16_LE";
+    for (PackMode m : {PackMode::RAW10_PACKED, PackMode::RAW16_LE, PackMode::RAW12_PACKED, PackMode::RAW14_PACKED,
+                       PackMode::MIPI_RAW10, PackMode::MIPI_RAW12, PackMode::RAW16_BE}) {
+        if (up == pack_mode_name(m)) { out = m; return true; }
+    }
+    return false;
+}
+
+ParserConfig parser_config_for(PackMode pack, int samples_per_frame, int header_bytes, int tail_bytes) {
+    const PackGeometry g = pack_geometry(pack);
+    ParserConfig c;
+    c.pack              = pack;
+    c.bits_per_sample   = g.bits;
+    c.samples_per_frame = samples_per_frame;
+    c.payload_bytes     = (samples_per_frame + g.group_samples - 1) / g.group_samples * g.group_bytes;
+    c.header_bytes      = header_bytes;
+    c.tail_bytes        = tail_bytes;
+    c.frame_size_bytes  = header_bytes + c.payload_bytes + tail_bytes;
+    return c;
+}
+
+bool validate_parser_config(const ParserConfig& c, std::string& why) {
+    if (c.header_bytes + c.payload_bytes + c.tail_bytes != c.frame_size_bytes) { why = "HEADER + PAYLOAD + TAIL 必须等于 FRAME_SIZE_BYTES"; return false; }
+    if (c.bits_per_sample < 1 || c.bits_per_sample > 16) { why = "bits_per_sample 仅支持 1..16"; return false; }
+    if (c.samples_per_frame < 1) { why = "samples_per_frame 必须 >= 1"; return false; }
+
+    if (c.seq_offset >= 0) {
+        if (c.seq_bytes != 1 && c.seq_bytes != 2 && c.seq_bytes != 4 && c.seq_bytes != 8) { why = "seq_bytes 仅支持 1/2/4/8"; return false; }
+        if (c.seq_offset + c.seq_bytes > c.header_bytes) { why = "序号字段必须落在 header 内（seq_offset + seq_bytes <= header_bytes）"; return false; }
+    }
+    if (c.reorder_window < 0 || c.reorder_window > 65536) { why = "reorder_window 仅支持 0..65536"; return false; }
+
+    const PackGeometry g = pack_geometry(c.pack);
+    if (g.group_bytes == 0) { why = "未知 Pack 模式"; return false; }
+    const std::string name = pack_mode_name(c.pack);
+
+    if (c.pack == PackMode::RAW10_PACKED) {
+        if (c.payload_bytes % 5 != 0) { why = "RAW10: payload_bytes 必须是 5 的整数倍"; return false; }
+        if ((c.payload_bytes / 5) * 4 != c.samples_per_frame) { why = "RAW10: (payload/5)*4 必须等于 samples_per_frame"; return false; }
+        if (c.bits_per_sample != 10) { why = "RAW10: 建议 bits_per_sample = 10"; return false; }
+        return true;
+    }
+    if (g.bits == 16) {
+        if (c.payload_bytes < c.samples_per_frame * 2) { why = name + ": payload_bytes 必须 >= samples_per_frame * 2"; return false; }
+        return true;
+    }
+    if (c.samples_per_frame % g.group_samples != 0) {
+        why = name + ": samples_per_frame 必须是 " + std::to_string(g.group_samples) + " 的整数倍"; return false;
     }
+    if (c.payload_bytes < c.samples_per_frame / g.group_samples * g.group_bytes) {
+        why = name + ": payload_bytes 必须 >= samples_per_frame / " + std::to_string(g.group_samples)
+            + " * " + std::to_string(g.group_bytes);
+        return false;
+    }
+    if (c.bits_per_sample != g.bits) { why = name + ": bits_per_sample 应为 " + std::to_string(g.bits); return false; }
     return true;
 }
 
-bool unpack_payload(const uint8_t* payload, uint16_t* out) {
-    if (g_cfg.pack == PackMode::RAW10_PACKED) {
+bool same_parser_config(const ParserConfig& a, const ParserConfig& b) {
+    return a.frame_size_bytes == b.frame_size_bytes && a.header_bytes == b.header_bytes
+        && a.payload_bytes == b.payload_bytes && a.tail_bytes == b.tail_bytes
+        && a.bits_per_sample == b.bits_per_sample && a.samples_per_frame == b.samples_per_frame
+        && a.pack == b.pack && a.seq_offset == b.seq_offset && a.seq_bytes == b.seq_bytes
+        && a.seq_big_endian == b.seq_big_endian && a.reorder_window == b.reorder_window;
+}
+
+// 按 g_cfg.pack 选择内核；scalar=true 时 RAW10 走标量参考实现
+static bool unpack_with(const uint8_t* payload, uint16_t* out, bool scalar) {
+    const int n = g_cfg.samples_per_frame;
+    switch (g_cfg.pack) {
+    case PackMode::RAW10_PACKED: {
         // 校验：payload_bytes 必须是 5 的倍数，且 groups*4 == samples_per_frame
         if (g_cfg.payload_bytes % 5 != 0) return false;
         const int groups = g_cfg.payload_bytes / 5;
-        if (groups * 4 != g_cfg.samples_per_frame) return false;
-        return unpack10bit_block(payload, groups, out);
+        if (groups * 4 != n) return false;
+        if (scalar) unpack_raw10_scalar(payload, groups, out);
+        else        unpack_raw10(payload, groups, out);
+        return true;
     }
-    else if (g_cfg.pack == PackMode::RAW16_LE) {
-        // 小端 16bit 按样本数直接解包
-        const int need_bytes = g_cfg.samples_per_frame * 2;
-        if (g_cfg.payload_bytes < need_bytes) return false;
-        for (int i = 0; i < g_cfg.samples_per_frame; ++i) {
-            out[i] = static_cast<uint16_t>(payload[2*i] | (payload[2*i + 1] << 8));
-        }
+    case PackMode::RAW16_LE:
+    case PackMode::RAW16_BE:
+        if (g_cfg.payload_bytes < n * 2) return false;
+        if (g_cfg.pack == PackMode::RAW16_BE) unpack_raw16be_scalar(payload, n, out);
+        else                                  unpack_raw16le_scalar(payload, n, out);
         return true;
+    default: {
+        const PackGeometry g = pack_geometry(g_cfg.pack);
+        if (g.group_samples == 0 || n % g.group_samples != 0) return false;
+        const int groups = n / g.group_samples;
+        if (g_cfg.payload_bytes < groups * g.group_bytes) return false;
+        switch (g_cfg.pack) {
+        case PackMode::RAW12_PACKED: unpack_raw12_scalar(payload, groups, out); return true;
+        case PackMode::RAW14_PACKED: unpack_raw14_scalar(payload, groups, out); return true;
+        case PackMode::MIPI_RAW10:   unpack_mipi_raw10_scalar(payload, groups, out); return true;
+        case PackMode::MIPI_RAW12:   unpack_mipi_raw12_scalar(payload, groups, out); return true;
+        default: return false;
+        }
+    }
+    }
+}
+
+bool unpack_payload(const uint8_t* payload, uint16_t* out) {
+    return unpack_with(payload, out, false);
+}
+
+bool unpack_payload_scalar(const uint8_t* payload, uint16_t* out) {
+    return unpack_with(payload, out, true);
+}
+
+bool make_parser_plan(const ParserConfig& cfg, ParserPlan& plan, std::string& why) {
+    plan = ParserPlan{};
+    if (!validate_parser_config(cfg, why)) return false;
+    plan.cfg              = cfg;
+    plan.frame_size_bytes = cfg.frame_size_bytes;
+    plan.header_bytes     = cfg.header_bytes;
+    const PackGeometry g  = pack_geometry(cfg.pack);
+    const int n = cfg.samples_per_frame;
+    switch (cfg.pack) {
+    case PackMode::RAW10_PACKED:
+        plan.count  = n / 4;
+        plan.kernel = raw10_plan_kernel(plan.count, &plan.specialised);
+        plan.kernel_name = unpack_kernel_name();
+        break;
+    case PackMode::RAW16_LE:
+    case PackMode::RAW16_BE:
+        plan.count  = n;
+        plan.kernel = raw16_plan_kernel(cfg.pack == PackMode::RAW16_BE, n, &plan.specialised);
+        plan.kernel_name = "scalar";
+        break;
+    default:
+        plan.count = n / g.group_samples;
+        plan.kernel_name = "scalar";
+        switch (cfg.pack) {
+        case PackMode::RAW12_PACKED: plan.kernel = unpack_raw12_scalar; break;
+        case PackMode::RAW14_PACKED: plan.kernel = unpack_raw14_scalar; break;
+        case PackMode::MIPI_RAW10:   plan.kernel = unpack_mipi_raw10_scalar; break;
+        case PackMode::MIPI_RAW12:   plan.kernel = unpack_mipi_raw12_scalar; break;
+        default: break;
+        }
+    }
+    if (!plan.kernel) { why = "未知 Pack 模式"; return false; }
+    return true;
+}
+
+uint64_t ParserPlanChannel::publish(const ParserConfig& cfg, std::string& why) {
+    static std::atomic<uint64_t> next_epoch{1}; // 进程内全局，环里不同 worker 写下的段不会撞号
+    auto plan = std::make_shared<ParserPlan>();
+    if (!make_parser_plan(cfg, *plan, why)) return 0;
+    plan->epoch = next_epoch.fetch_add(1, std::memory_order_relaxed);
+    const uint64_t e = plan->epoch;
+    // 先换指针再发布 epoch：读者看到新 epoch 时一定能取到不旧于它的计划
+    std::atomic_store_explicit(&plan_, std::shared_ptr<const ParserPlan>(std::move(plan)), std::memory_order_release);
+    epoch_.store(e, std::memory_order_release);
+    return e;
+}
+
+bool pack_payload(const uint16_t* in, uint8_t* payload, const ParserConfig& cfg) {
+    const PackGeometry g = pack_geometry(cfg.pack);
+    const int n = cfg.samples_per_frame;
+    if (g.group_samples == 0 || n % g.group_samples != 0) return false;
+    const int groups = n / g.group_samples;
+    const int used   = groups * g.group_bytes;
+    if (cfg.payload_bytes < used) return false;
+    switch (cfg.pack) {
+    case PackMode::RAW10_PACKED: pack_raw10_scalar(in, groups, payload); break;
+    case PackMode::RAW12_PACKED: pack_raw12_scalar(in, groups, payload); break;
+    case PackMode::RAW14_PACKED: pack_raw14_scalar(in, groups, payload); break;
+    case PackMode::MIPI_RAW10:   pack_mipi_raw10_scalar(in, groups, payload); break;
+    case PackMode::MIPI_RAW12:   pack_mipi_raw12_scalar(in, groups, payload); break;
+    case PackMode::RAW16_LE:     pack_raw16le_scalar(in, n, payload); break;
+    case PackMode::RAW16_BE:     pack_raw16be_scalar(in, n, payload); break;
+    default: return false;
+    }
+    std::memset(payload + used, 0, static_cast<size_t>(cfg.payload_bytes - used));
+    return true;
+}
+
+// ------------------------ FramePyramid ------------------------
+
+FramePyramid::FramePyramid(size_t frame_capacity, int channels, int base_log2)
+: channels_(std::max(1, channels)), base_log2_(std::clamp(base_log2, 0, 16)) {
+    const size_t ch = static_cast<size_t>(channels_);
+    // 每级保留能覆盖整个环的块数，再多留 2 块给正在跨越边界的部分
+    for (int lg = base_log2_; lg <= 16; ++lg) {
+        const size_t bf = size_t(1) << lg;
+        if (bf > frame_capacity && !levels_.empty()) break;
+        Level lv;
+        lv.nblocks = frame_capacity / bf + 2;
+        const size_t n = lv.nblocks * ch;
+        lv.mem = MappedBuffer(n * (2 * sizeof(uint16_t) + sizeof(uint32_t)));
+        lv.sum = static_cast<uint32_t*>(lv.mem.data());
+        lv.mn  = reinterpret_cast<uint16_t*>(lv.sum + n);
+        lv.mx  = lv.mn + n;
+        levels_.push_back(std::move(lv));
+    }
+    acc_mn_.assign(ch, 0xFFFF);
+    acc_mx_.assign(ch, 0);
+    acc_sum_.assign(ch, 0);
+}
+
+size_t FramePyramid::memory_bytes() const {
+    size_t n = 0;
+    for (const Level& lv : levels_) n += lv.mem.size();
+    return n;
+}
+
+// 逐通道 min/max/和的三个内循环。-O2 下 GCC 不会为运行时长度的循环做向量化（需要余数循环与别名检查），
+// 而这是 RX 线程每帧都走的路径，所以在 x86-64 基线 SSE2 上手写：无符号 16 位 min/max 借符号位翻转
+// 用有符号指令，和先零扩展到 32 位再加。
+namespace {
+
+#ifdef __SSE2__
+inline __m128i pyr_flip(__m128i v) { return _mm_xor_si128(v, _mm_set1_epi16(static_cast<short>(0x8000))); }
+#endif
+
+// 基块的第一帧
+void pyr_init(size_t n, const uint16_t* v, uint16_t* mn, uint16_t* mx, uint32_t* sm) {
+    size_t c = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for (; c + 8 <= n; c += 8) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + c));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mn + c), x);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mx + c), x);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sm + c),     _mm_unpacklo_epi16(x, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sm + c + 4), _mm_unpackhi_epi16(x, zero));
+    }
+#endif
+    for (; c < n; ++c) { mn[c] = v[c]; mx[c] = v[c]; sm[c] = v[c]; }
+}
+
+// 把 (a_mn, a_mx, a_sm) 与 (b_mn, b_mx, b_sm) 合并进 out；b_sm 为空时 b 是一帧样本（b_mn 即样本），和加样本值
+void pyr_merge(size_t n, const uint16_t* a_mn, const uint16_t* a_mx, const uint32_t* a_sm,
+               const uint16_t* b_mn, const uint16_t* b_mx, const uint32_t* b_sm,
+               uint16_t* o_mn, uint16_t* o_mx, uint32_t* o_sm) {
+    size_t c = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for (; c + 8 <= n; c += 8) {
+        const __m128i an = pyr_flip(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a_mn + c)));
+        const __m128i ax = pyr_flip(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a_mx + c)));
+        const __m128i bn = pyr_flip(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b_mn + c)));
+        const __m128i bx = b_sm ? pyr_flip(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b_mx + c))) : bn;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(o_mn + c), pyr_flip(_mm_min_epi16(an, bn)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(o_mx + c), pyr_flip(_mm_max_epi16(ax, bx)));
+        __m128i blo, bhi;
+        if (b_sm) {
+            blo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b_sm + c));
+            bhi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b_sm + c + 4));
+        } else {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b_mn + c));
+            blo = _mm_unpacklo_epi16(x, zero);
+            bhi = _mm_unpackhi_epi16(x, zero);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(o_sm + c),
+                         _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a_sm + c)), blo));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(o_sm + c + 4),
+                         _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a_sm + c + 4)), bhi));
+    }
+#endif
+    for (; c < n; ++c) {
+        o_mn[c] = std::min(a_mn[c], b_mn[c]);
+        o_mx[c] = std::max(a_mx[c], b_sm ? b_mx[c] : b_mn[c]);
+        o_sm[c] = a_sm[c] + (b_sm ? b_sm[c] : b_mn[c]);
+    }
+}
+
+} // namespace
+
+void FramePyramid::on_frame(uint64_t abs, const uint16_t* samples) {
+    const size_t   ch   = static_cast<size_t>(channels_);
+    const uint64_t mask = (uint64_t(1) << base_log2_) - 1;
+    const uint64_t pos  = abs & mask;
+
+    uint16_t* mn = acc_mn_.data();
+    uint16_t* mx = acc_mx_.data();
+    uint32_t* sm = acc_sum_.data();
+    if (pos == 0) pyr_init(ch, samples, mn, mx, sm);
+    else          pyr_merge(ch, mn, mx, sm, samples, samples, nullptr, mn, mx, sm);
+    if (pos != mask) return;
+
+    // 基块完成：写入第 0 级
+    uint64_t blk = abs >> base_log2_;
+    {
+        Level& lv = levels_[0];
+        const size_t o = static_cast<size_t>(blk % lv.nblocks) * ch;
+        std::memcpy(&lv.mn[o],  mn, ch * sizeof(uint16_t));
+        std::memcpy(&lv.mx[o],  mx, ch * sizeof(uint16_t));
+        std::memcpy(&lv.sum[o], sm, ch * sizeof(uint32_t));
+    }
+
+    // 奇数块完成了一对：合并到上一级
+    for (size_t L = 1; L < levels_.size() && (blk & 1); ++L) {
+        const Level& lo = levels_[L - 1];
+        Level& hi = levels_[L];
+        const size_t a = static_cast<size_t>((blk - 1) % lo.nblocks) * ch;
+        const size_t b = static_cast<size_t>(blk % lo.nblocks) * ch;
+        blk >>= 1;
+        const size_t o = static_cast<size_t>(blk % hi.nblocks) * ch;
+        pyr_merge(ch, &lo.mn[a], &lo.mx[a], &lo.sum[a], &lo.mn[b], &lo.mx[b], &lo.sum[b],
+                  &hi.mn[o], &hi.mx[o], &hi.sum[o]);
+    }
+}
+
+// ------------------------ MappedBuffer ------------------------
+
+MappedBuffer::MappedBuffer(size_t bytes) {
+    if (bytes == 0) return;
+    constexpr size_t kHuge = size_t(2) << 20;
+    if (bytes < kHuge) { // 小块（金字塔高层、短环的时间戳）不值得占整个大页
+        size_ = (bytes + 4095) & ~size_t(4095);
+        ptr_  = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (ptr_ == MAP_FAILED) { ptr_ = nullptr; throw std::bad_alloc(); }
+        return;
+    }
+    const size_t len = (bytes + kHuge - 1) & ~(kHuge - 1);
+    // 多映射一个大页再裁掉首尾，使起点 2 MiB 对齐（透明大页只作用于对齐的整页）
+    void* raw = ::mmap(nullptr, len + kHuge, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (raw == MAP_FAILED) throw std::bad_alloc();
+    const uintptr_t base    = reinterpret_cast<uintptr_t>(raw);
+    const uintptr_t aligned = (base + kHuge - 1) & ~uintptr_t(kHuge - 1);
+    if (aligned > base) ::munmap(raw, aligned - base);
+    const size_t tail = base + len + kHuge - (aligned + len);
+    if (tail) ::munmap(reinterpret_cast<void*>(aligned + len), tail);
+    ptr_  = reinterpret_cast<void*>(aligned);
+    size_ = len;
+#ifdef MADV_HUGEPAGE
+    huge_ = ::madvise(ptr_, size_, MADV_HUGEPAGE) == 0;
+#endif
+}
+
+MappedBuffer::~MappedBuffer() {
+    if (ptr_) ::munmap(ptr_, size_);
+}
+
+// ------------------------ DecodedFrameRing ------------------------
+
+namespace {
+// PACKED 实际生效时的位宽；原生 16 位的格式返回 0（退回 ROW_MAJOR）
+int packed_bits_for(const ParserConfig& cfg) {
+    const int bits = pack_geometry(cfg.pack).bits;
+    return bits > 0 && bits < 16 ? bits : 0;
+}
+
+size_t packed_row_bytes(int spf, int bits) {
+    return (static_cast<size_t>(spf) * static_cast<size_t>(bits) + 7) / 8;
+}
+}
+
+DecodedFrameRing::DecodedFrameRing(size_t frame_capacity, const RingOptions& opt)
+: capacity_(std::max<size_t>(1, frame_capacity)), spf_(g_cfg.samples_per_frame), layout_(opt.layout) {
+    if (layout_ == RingLayout::PACKED && packed_bits_for(g_cfg) == 0) layout_ = RingLayout::ROW_MAJOR;
+    if (layout_ == RingLayout::CHANNEL_TILED) {
+        while ((size_t(1) << tile_log2_) < std::max<size_t>(1, opt.tile_frames)) ++tile_log2_;
+        tile_mask_ = (size_t(1) << tile_log2_) - 1;
+        capacity_  = (capacity_ + tile_mask_) & ~tile_mask_; // 容量对齐到整块，回绕时块边界不错位
+        stage_mask_ = std::min(kStageFrames, tile_mask_ + 1) - 1;   // 一批不跨块
+        staging_.resize(2 * (stage_mask_ + 1) * static_cast<size_t>(spf_));
+    }
+    if (layout_ == RingLayout::PACKED) {
+        bits_      = packed_bits_for(g_cfg);
+        bits_mask_ = (1u << bits_) - 1u;
+        row_bytes_ = packed_row_bytes(spf_, bits_);
+        staging_.resize(static_cast<size_t>(spf_));
+        // 末尾多留 4 字节：packed_sample 对最后一个样本也做 32 位读取
+        samples_mem_ = MappedBuffer(capacity_ * row_bytes_ + sizeof(uint32_t));
+        packed_ = static_cast<uint8_t*>(samples_mem_.data());
+    } else {
+        samples_mem_ = MappedBuffer(capacity_ * static_cast<size_t>(spf_) * sizeof(uint16_t));
+        data_ = static_cast<uint16_t*>(samples_mem_.data());
+    }
+    ts_mem_ = MappedBuffer(capacity_ * sizeof(int64_t));
+    ts_ns_  = static_cast<int64_t*>(ts_mem_.data());
+    if (opt.enable_pyramid)
+        pyramid_ = std::make_unique<FramePyramid>(capacity_, spf_, opt.pyramid_base_log2);
+    write_index_.store(0, std::memory_order_relaxed);
+    segs_.push_back(RingSegment{0, 0, g_cfg});
+}
+
+bool DecodedFrameRing::accepts(const ParserConfig& cfg) const {
+    if (cfg.samples_per_frame != spf_) return false;
+    return layout_ != RingLayout::PACKED || packed_bits_for(cfg) == bits_;
+}
+
+void DecodedFrameRing::begin_segment(uint64_t epoch, const ParserConfig& cfg) {
+    const uint64_t w = write_index_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lk(seg_mu_);
+    RingSegment& cur = segs_.back();
+    if (cur.epoch == epoch) return;
+    if (cur.first == w || same_parser_config(cur.cfg, cfg)) { // 空段或配置未变：原地改写
+        cur.epoch = epoch;
+        cur.cfg   = cfg;
+        return;
+    }
+    // 已被完全覆盖的老段（下一段的起点也已出环）不再保留
+    const uint64_t oldest = w > capacity_ ? w - capacity_ : 0;
+    size_t drop = 0;
+    while (drop + 1 < segs_.size() && segs_[drop + 1].first <= oldest) ++drop;
+    if (segs_.size() - drop >= kMaxSegments) ++drop;
+    segs_.erase(segs_.begin(), segs_.begin() + static_cast<std::ptrdiff_t>(drop));
+    segs_.push_back(RingSegment{w, epoch, cfg});
+}
+
+std::vector<RingSegment> DecodedFrameRing::segments(uint64_t widx_snapshot) const {
+    const uint64_t oldest = widx_snapshot > capacity_ ? widx_snapshot - capacity_ : 0;
+    std::lock_guard<std::mutex> lk(seg_mu_);
+    std::vector<RingSegment> out;
+    for (size_t i = 0; i < segs_.size(); ++i) {
+        if (segs_[i].first > widx_snapshot) break;                         // 快照之后才开的段
+        if (i + 1 < segs_.size() && segs_[i + 1].first <= oldest) continue; // 已整段出环
+        out.push_back(segs_[i]);
+    }
+    return out;
+}
+
+size_t DecodedFrameRing::bytes_per_frame(const RingOptions& opt) {
+    const int spf  = std::max(1, g_cfg.samples_per_frame);
+    const int bits = opt.layout == RingLayout::PACKED ? packed_bits_for(g_cfg) : 0;
+    size_t n = bits ? packed_row_bytes(spf, bits) : static_cast<size_t>(spf) * sizeof(uint16_t);
+    n += sizeof(int64_t);
+    // 金字塔：各级块数之和约为 2 × 帧数 / 2^base，每块每通道 min/max/sum 共 8 字节
+    if (opt.enable_pyramid)
+        n += (static_cast<size_t>(spf) * 8 * 2 + (size_t(1) << std::clamp(opt.pyramid_base_log2, 0, 16)) - 1)
+             >> std::clamp(opt.pyramid_base_log2, 0, 16);
+    return n;
+}
+
+size_t DecodedFrameRing::frames_for_budget(size_t memory_budget_bytes, const RingOptions& opt) {
+    return std::max<size_t>(1, memory_budget_bytes / bytes_per_frame(opt));
+}
+
+size_t DecodedFrameRing::memory_bytes() const {
+    return samples_mem_.size() + ts_mem_.size() + (pyramid_ ? pyramid_->memory_bytes() : 0);
+}
+
+void DecodedFrameRing::pack_row(const uint16_t* row, uint8_t* dst) {
+    // LSB 优先位流，攒满 32 位整块写出（小端，与 packed_sample 的读取一致）；累加器最多积 31 + 16 位
+    uint64_t acc = 0;
+    int      nb  = 0;
+    for (int c = 0; c < spf_; ++c) {
+        acc |= uint64_t(row[c] & bits_mask_) << nb;
+        nb  += bits_;
+        if (nb >= 32) {
+            const uint32_t word = static_cast<uint32_t>(acc);
+            std::memcpy(dst, &word, sizeof(word));
+            dst += sizeof(word); acc >>= 32; nb -= 32;
+        }
+    }
+    for (; nb > 0; nb -= 8) { *dst++ = static_cast<uint8_t>(acc); acc >>= 8; }
+}
+
+void DecodedFrameRing::unpack_row(size_t slot, int c0, int n, uint16_t* out) const {
+    for (int c = 0; c < n; ++c) out[c] = packed_sample(slot, c0 + c);
+}
+
+uint64_t DecodedFrameRing::lower_bound_time(int64_t t_ns, uint64_t lo, uint64_t hi) const {
+    while (lo < hi) {
+        const uint64_t mid = lo + (hi - lo) / 2;
+        if (timestamp_ns(mid) < t_ns) lo = mid + 1;
+        else                          hi = mid;
+    }
+    return lo;
+}
+
+DecodedFrameRing::FrameRange DecodedFrameRing::window_range(uint64_t widx_snapshot, double window_seconds) const {
+    FrameRange r;
+    r.last = widx_snapshot;
+    if (widx_snapshot == 0) return r;
+    const uint64_t oldest = widx_snapshot > capacity_ ? widx_snapshot - capacity_ : 0;
+    r.t_end_ns = timestamp_ns(widx_snapshot - 1);
+    const int64_t t0 = r.t_end_ns - static_cast<int64_t>(std::llround(window_seconds * 1e9));
+    r.first = lower_bound_time(t0, oldest, widx_snapshot);
+    return r;
+}
+
+double DecodedFrameRing::estimate_fps(uint64_t widx_snapshot, double lookback_seconds) const {
+    const FrameRange r = window_range(widx_snapshot, lookback_seconds);
+    if (r.last < r.first + 2) return 0.0;
+    const int64_t dt = r.t_end_ns - timestamp_ns(r.first);
+    if (dt <= 0) return 0.0;
+    return (double)(r.last - 1 - r.first) * 1e9 / (double)dt;
+}
+
+void DecodedFrameRing::read_channel(int ch, uint64_t f0, size_t n, uint16_t* out) const {
+    if (layout_ == RingLayout::PACKED) {
+        size_t slot = static_cast<size_t>(f0 % capacity_);
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = packed_sample(slot, ch);
+            if (++slot == capacity_) slot = 0;
+        }
+        return;
+    }
+    if (layout_ == RingLayout::ROW_MAJOR) {
+        size_t slot = static_cast<size_t>(f0 % capacity_);
+        const uint16_t* base = data_ + static_cast<size_t>(ch);
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = base[slot * static_cast<size_t>(spf_)];
+            if (++slot == capacity_) slot = 0;
+        }
+        return;
+    }
+    while (n > 0) {
+        // 已转置的部分按块 memcpy；最新还在暂存区的几帧逐行读，读完若暂存行已被复用就再来一轮（那时已转置）
+        const uint64_t te = tiled_end_.load(std::memory_order_acquire);
+        size_t nt = f0 < te ? static_cast<size_t>(std::min<uint64_t>(n, te - f0)) : 0;
+        while (nt > 0) {
+            const size_t slot = static_cast<size_t>(f0 % capacity_);
+            const size_t in   = slot & tile_mask_;
+            const size_t run  = std::min(nt, tile_mask_ + 1 - in);
+            const uint16_t* src = &data_[(((slot >> tile_log2_) * static_cast<size_t>(spf_) + static_cast<size_t>(ch)) << tile_log2_) + in];
+            std::memcpy(out, src, run * sizeof(uint16_t));
+            out += run; f0 += run; n -= run; nt -= run;
+        }
+        for (size_t i = 0; i < n; ++i) out[i] = stage_row(f0 + i)[ch];
+        if (n == 0 || !stage_reused(f0)) return;
+    }
+}
+
+void DecodedFrameRing::read_frame(uint64_t abs_frame_index, uint16_t* out) const {
+    const size_t slot = static_cast<size_t>(abs_frame_index % capacity_);
+    if (layout_ == RingLayout::ROW_MAJOR) {
+        std::memcpy(out, &data_[slot * static_cast<size_t>(spf_)], static_cast<size_t>(spf_) * sizeof(uint16_t));
+        return;
+    }
+    if (layout_ == RingLayout::PACKED) { unpack_row(slot, 0, spf_, out); return; }
+    if (abs_frame_index >= tiled_end_.load(std::memory_order_acquire)) {
+        std::memcpy(out, stage_row(abs_frame_index), static_cast<size_t>(spf_) * sizeof(uint16_t));
+        if (!stage_reused(abs_frame_index)) return;
+    }
+    const uint16_t* src = &data_[((slot >> tile_log2_) * static_cast<size_t>(spf_) << tile_log2_) + (slot & tile_mask_)];
+    for (int c = 0; c < spf_; ++c) out[c] = src[static_cast<size_t>(c) << tile_log2_];
+}
+
+void DecodedFrameRing::flush_stage(uint64_t first) {
+    // 每次取 kLanes 个通道：源是 stage_frames 行里各一小段，目的是 kLanes 条各写满 stage_frames 个样本的块内行，
+    // 两边都留在 L1 里，每条目的缓存行只被整条写一次
+    constexpr int kLanes = 8;
+    const size_t nf   = stage_mask_ + 1;
+    const size_t slot = static_cast<size_t>(first % capacity_);
+    const size_t spf  = static_cast<size_t>(spf_);
+    uint16_t* dst = &data_[((slot >> tile_log2_) * spf << tile_log2_) + (slot & tile_mask_)];
+    const uint16_t* src = stage_row(first); // 一批的各行在暂存区里连续
+    int c0 = 0;
+#ifdef __SSE2__
+    // 8 帧 × 8 通道一块，三轮 unpack 完成 8×8 的 16 位转置
+    if (nf % 8 == 0) {
+        for (; c0 + kLanes <= spf_; c0 += kLanes) {
+            for (size_t r0 = 0; r0 < nf; r0 += 8) {
+                __m128i a[8], t[8];
+                for (int k = 0; k < 8; ++k)
+                    a[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (r0 + static_cast<size_t>(k)) * spf + static_cast<size_t>(c0)));
+                for (int k = 0; k < 4; ++k) {
+                    t[k]     = _mm_unpacklo_epi16(a[2*k], a[2*k + 1]);
+                    t[k + 4] = _mm_unpackhi_epi16(a[2*k], a[2*k + 1]);
+                }
+                // t: 0..3 为通道 0-3 的帧对，4..7 为通道 4-7 的帧对
+                for (int h = 0; h < 2; ++h) {
+                    const __m128i* q = t + 4*h;
+                    a[4*h + 0] = _mm_unpacklo_epi32(q[0], q[1]);
+                    a[4*h + 1] = _mm_unpackhi_epi32(q[0], q[1]);
+                    a[4*h + 2] = _mm_unpacklo_epi32(q[2], q[3]);
+                    a[4*h + 3] = _mm_unpackhi_epi32(q[2], q[3]);
+                }
+                for (int h = 0; h < 2; ++h) {
+                    const __m128i* q = a + 4*h;
+                    uint16_t* d = dst + (static_cast<size_t>(c0 + 4*h) << tile_log2_) + r0;
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d),                                      _mm_unpacklo_epi64(q[0], q[2]));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + (size_t(1) << tile_log2_)),          _mm_unpackhi_epi64(q[0], q[2]));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + (size_t(2) << tile_log2_)),          _mm_unpacklo_epi64(q[1], q[3]));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + (size_t(3) << tile_log2_)),          _mm_unpackhi_epi64(q[1], q[3]));
+                }
+            }
+        }
+    }
+#endif
+    for (; c0 < spf_; c0 += kLanes) {
+        const int m = std::min(kLanes, spf_ - c0);
+        for (size_t r = 0; r < nf; ++r) {
+            const uint16_t* row = src + r * spf + static_cast<size_t>(c0);
+            uint16_t* d = dst + (static_cast<size_t>(c0) << tile_log2_) + r;
+            for (int k = 0; k < m; ++k) d[static_cast<size_t>(k) << tile_log2_] = row[k];
+        }
+    }
+    tiled_end_.store(first + nf, std::memory_order_release);
+}
+
+// 原始样本区间的归约：分段读到栈上缓冲后做可向量化的 min/max/sum
+void DecodedFrameRing::accumulate_raw(uint64_t f0, uint64_t f1, int ch, RangeStats& acc) const {
+    constexpr size_t kChunk = 256;
+    uint16_t buf[kChunk];
+    while (f0 < f1) {
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(kChunk, f1 - f0));
+        read_channel(ch, f0, n, buf);
+        uint16_t mn = 0xFFFF, mx = 0;
+        uint64_t sm = 0;
+        for (size_t i = 0; i < n; ++i) {
+            mn = std::min(mn, buf[i]);
+            mx = std::max(mx, buf[i]);
+            sm += buf[i];
+        }
+        acc.merge(mn, mx, sm, n);
+        f0 += n;
+    }
+}
+
+// 相邻通道段的原始样本归约。ROW_MAJOR：每帧一段连续样本，内层跨通道可向量化；
+// PACKED：每帧先把这一段解包到栈上再归约（只解要用的通道）。
+// 和先在 uint32 上累加（每 65536 帧落到 uint64 一次），通道按 kLanes 分批以放进栈上缓冲
+void DecodedFrameRing::accumulate_raw_span(uint64_t f0, uint64_t f1, int c0, int n,
+                                           uint16_t* mn, uint16_t* mx, uint64_t* sum) const {
+    if (layout_ == RingLayout::CHANNEL_TILED) {
+        // 块内按通道连续，逐通道走 accumulate_raw 反而是顺序读
+        for (int c = 0; c < n; ++c) {
+            RangeStats acc;
+            accumulate_raw(f0, f1, c0 + c, acc);
+            mn[c] = std::min(mn[c], acc.vmin);
+            mx[c] = std::max(mx[c], acc.vmax);
+            sum[c] += acc.sum;
+        }
+        return;
+    }
+    constexpr int    kLanes = 512;
+    constexpr size_t kPrefetchFrames = 16;
+    uint32_t s32[kLanes];
+    uint16_t unpacked[kLanes];
+    const bool packed = layout_ == RingLayout::PACKED;
+    for (int cb = 0; cb < n; cb += kLanes) {
+        const int m = std::min(kLanes, n - cb);
+        uint16_t* mnc = mn + cb;
+        uint16_t* mxc = mx + cb;
+        uint64_t f = f0;
+        while (f < f1) {
+            const uint64_t stop = std::min<uint64_t>(f1, f + 65536);
+            std::fill(s32, s32 + m, 0u);
+            size_t slot = static_cast<size_t>(f % capacity_);
+            for (; f < stop; ++f) {
+                // 行间跨度是整帧，硬件预取跟不上；提前取几帧后的同一段
+                const size_t ahead = (slot + kPrefetchFrames) % capacity_;
+                const uint16_t* row;
+                if (packed) {
+                    __builtin_prefetch(packed_ + ahead * row_bytes_ + static_cast<size_t>(c0 + cb) * static_cast<size_t>(bits_) / 8);
+                    unpack_row(slot, c0 + cb, m, unpacked);
+                    row = unpacked;
+                } else {
+                    __builtin_prefetch(&data_[ahead * static_cast<size_t>(spf_) + static_cast<size_t>(c0 + cb)]);
+                    row = &data_[slot * static_cast<size_t>(spf_) + static_cast<size_t>(c0 + cb)];
+                }
+                for (int c = 0; c < m; ++c) {
+                    mnc[c] = std::min(mnc[c], row[c]);
+                    mxc[c] = std::max(mxc[c], row[c]);
+                    s32[c] += row[c];
+                }
+                if (++slot == capacity_) slot = 0;
+            }
+            for (int c = 0; c < m; ++c) sum[cb + c] += s32[c];
+        }
+    }
+}
+
+template <class RawFn, class BlockFn>
+void DecodedFrameRing::decompose(uint64_t f0, uint64_t f1, RawFn raw, BlockFn block) const {
+    // 不足两个基块的区间最多只能用上一个块，拆开反而多一次原始段调用
+    if (!pyramid_ || f1 - f0 < (uint64_t(2) << pyramid_->base_log2())) { raw(f0, f1); return; }
+
+    const int base = pyramid_->base_log2();
+    const int nlev = pyramid_->levels();
+    uint64_t f = f0;
+    while (f < f1) {
+        // 选出从 f 开始、已对齐且不越过 f1 的最大块
+        int lv = -1;
+        for (int L = nlev - 1; L >= 0; --L) {
+            const uint64_t bf = uint64_t(1) << (base + L);
+            if ((f & (bf - 1)) == 0 && f + bf <= f1) { lv = L; break; }
+        }
+        if (lv < 0) {
+            // 不足一个基块：读原始样本直到下一个基块边界或 f1
+            const uint64_t bf = uint64_t(1) << base;
+            const uint64_t stop = std::min(f1, (f | (bf - 1)) + 1);
+            raw(f, stop);
+            f = stop;
+            continue;
+        }
+        block(lv, f >> (base + lv));
+        f += uint64_t(1) << (base + lv);
+    }
+}
+
+RangeStats DecodedFrameRing::range_stats(uint64_t f0, uint64_t f1, int ch, uint64_t widx_snapshot) const {
+    RangeStats acc;
+    f1 = std::min(f1, widx_snapshot);
+    if (f1 <= f0) return acc;
+    decompose(f0, f1,
+              [&](uint64_t a, uint64_t b) { accumulate_raw(a, b, ch, acc); },
+              [&](int lv, uint64_t blk)   { pyramid_->accumulate_block(lv, blk, ch, acc); });
+    return acc;
+}
+
+uint64_t DecodedFrameRing::range_stats_span(uint64_t f0, uint64_t f1, int c0, int n, uint64_t widx_snapshot,
+                                            uint16_t* mn, uint16_t* mx, uint64_t* sum) const {
+    f1 = std::min(f1, widx_snapshot);
+    if (f1 <= f0 || n <= 0) return 0;
+    decompose(f0, f1,
+              [&](uint64_t a, uint64_t b) { accumulate_raw_span(a, b, c0, n, mn, mx, sum); },
+              [&](int lv, uint64_t blk)   { pyramid_->accumulate_block_span(lv, blk, c0, n, mn, mx, sum); });
+    return f1 - f0;
+}
+
+// ------------------------ FrameQueue ------------------------
+
+FrameQueue::FrameQueue(size_t capacity, int samples_per_frame) : spf_(samples_per_frame) {
+    size_t c = 1;
+    while (c < std::max<size_t>(2, capacity)) c <<= 1; // 2 的幂，便于取模
+    capacity_ = c;
+    mask_     = c - 1;
+    data_.resize(capacity_ * static_cast<size_t>(spf_));
+    ts_ns_.resize(capacity_);
+    seq_.resize(capacity_);
+    epoch_.resize(capacity_);
+}
+
+// ------------------------ SeqReorderBuffer ------------------------
+
+SeqReorderBuffer::SeqReorderBuffer(DecodedFrameRing& ring, const ParserConfig& cfg, RuntimeStats& stats)
+: ring_(ring), stats_(stats), spf_(static_cast<size_t>(ring.samples_per_frame())) {
+    configure(cfg);
+}
+
+void SeqReorderBuffer::configure(const ParserConfig& cfg) {
+    tracking_ = cfg.seq_offset >= 0;
+    mask_     = cfg.seq_bytes >= 8 ? ~uint64_t(0) : (uint64_t(1) << (8 * cfg.seq_bytes)) - 1;
+    window_   = tracking_ ? static_cast<size_t>(std::max(0, cfg.reorder_window)) : 0;
+    if (window_ > 1) {
+        stash_.resize(window_ * spf_);
+        stash_ts_.resize(window_);
+        stash_full_.assign(window_, 0);
+    } else {
+        stash_.clear();
+        stash_ts_.clear();
+        stash_full_.clear();
+    }
+    history_.assign(kHistory / 64, 0);
+    started_   = false;
+    expected_  = 0;
+    head_      = 0;
+    stashed_   = 0;
+    ahead_max_ = 0;
+    pending_   = Target::NONE;
+}
+
+void SeqReorderBuffer::reconfigure(const ParserConfig& cfg) {
+    while (stashed_ > 0) step(); // 仍属旧配置的暂存帧先写出，缺口照常计为丢失
+    configure(cfg);
+}
+
+int64_t SeqReorderBuffer::distance(uint64_t seq) const {
+    const uint64_t u = (seq - expected_) & mask_;
+    if (mask_ == ~uint64_t(0)) return static_cast<int64_t>(u);
+    return (u > mask_ / 2) ? static_cast<int64_t>(u) - static_cast<int64_t>(mask_) - 1 : static_cast<int64_t>(u);
+}
+
+void SeqReorderBuffer::advance(bool received) {
+    history_set(expected_, received);
+    expected_ = (expected_ + 1) & mask_;
+    if (expected_ == 0) stats_.seq_wraps++;
+    if (!stash_full_.empty()) head_ = (head_ + 1) % window_;
+    if (ahead_max_ > 0) --ahead_max_;
+}
+
+void SeqReorderBuffer::step() {
+    if (!stash_full_.empty() && stash_full_[head_]) {
+        ring_.push_frame(&stash_[head_ * spf_], stash_ts_[head_]);
+        stash_full_[head_] = 0;
+        --stashed_;
+        advance(true);
+    } else {
+        stats_.seq_lost++;
+        advance(false);
+    }
+}
+
+void SeqReorderBuffer::jump(uint64_t gap) {
+    stats_.seq_lost += gap;
+    for (uint64_t i = 0; i < std::min<uint64_t>(gap, kHistory); ++i) history_set((expected_ + i) & mask_, false);
+    if (mask_ != ~uint64_t(0) && expected_ + gap > mask_) stats_.seq_wraps++;
+    expected_ = (expected_ + gap) & mask_;
+    if (!stash_full_.empty()) head_ = static_cast<size_t>((head_ + gap) % window_);
+    ahead_max_ = 0;
+}
+
+void SeqReorderBuffer::drain() {
+    while (stashed_ > 0 && stash_full_[head_]) step();
+}
+
+void SeqReorderBuffer::resync(uint64_t seq) {
+    stats_.seq_resync++;
+    std::fill(stash_full_.begin(), stash_full_.end(), uint8_t(0));
+    std::fill(history_.begin(), history_.end(), uint64_t(0));
+    stashed_   = 0;
+    head_      = 0;
+    ahead_max_ = 0;
+    expected_  = seq;
+}
+
+uint16_t* SeqReorderBuffer::begin(uint64_t seq, int64_t ts_ns) {
+    pending_ts_ = ts_ns;
+    if (!tracking_) { pending_ = Target::RING; return ring_.reserve_frame(); }
+
+    seq &= mask_;
+    if (!started_) { started_ = true; expected_ = seq; }
+
+    int64_t d = distance(seq);
+    if (d < 0) {
+        if (static_cast<uint64_t>(-d) <= kHistory) {
+            pending_ = Target::NONE;
+            if (history_get(seq)) { stats_.seq_duplicate++; return nullptr; }
+            // 已被判为丢失：数据到了但位置已过，扣回丢失计数
+            stats_.seq_late++;
+            if (stats_.seq_lost.load(std::memory_order_relaxed) > 0) stats_.seq_lost--;
+            return nullptr;
+        }
+        resync(seq);
+        d = 0;
+    }
+
+    if (d > 0) {
+        const int64_t w = static_cast<int64_t>(std::max<size_t>(window_, 1));
+        // 超出窗口：把 expected_ 推到 seq 能放进窗口为止，途经的缺口计为丢失
+        while (d >= w && stashed_ > 0) { step(); --d; }
+        if (d >= w) { jump(static_cast<uint64_t>(d - (w - 1))); d = w - 1; }
+        drain();
+        d = distance(seq);
+        if (d < 0) { pending_ = Target::NONE; stats_.seq_duplicate++; return nullptr; } // 已在暂存中，被 drain 写出
+    }
+
+    if (d == 0) {
+        if (!stash_full_.empty() && stash_full_[head_]) { pending_ = Target::NONE; stats_.seq_duplicate++; return nullptr; }
+        if (ahead_max_ > 0) stats_.seq_reordered++;
+        pending_ = Target::RING;
+        return ring_.reserve_frame();
+    }
+
+    const size_t slot = (head_ + static_cast<size_t>(d)) % window_;
+    if (stash_full_[slot]) { pending_ = Target::NONE; stats_.seq_duplicate++; return nullptr; }
+    if (d < ahead_max_) stats_.seq_reordered++;
+    pending_      = Target::STASH;
+    pending_dist_ = d;
+    return &stash_[slot * spf_];
+}
+
+void SeqReorderBuffer::end(bool ok) {
+    const Target t = pending_;
+    pending_ = Target::NONE;
+
+    if (t == Target::RING) {
+        if (ok) ring_.commit_frame(pending_ts_);
+        if (!tracking_) return;
+        advance(ok);
+        drain();
+    } else if (t == Target::STASH && ok) {
+        const size_t slot = (head_ + static_cast<size_t>(pending_dist_)) % window_;
+        stash_full_[slot] = 1;
+        stash_ts_[slot]   = pending_ts_;
+        ++stashed_;
+        ahead_max_ = std::max(ahead_max_, pending_dist_);
     }
-    // TODO: RAW12/RAW14/MIPI 等模式可在此扩展
-    return false;
 }
 
 Envelope build_envelope(const DecodedFrameRing& ring,
                         uint64_t widx_snapshot,
                         int channel,
-                        double fps,
                         double window_seconds,
                         int bins) {
     Envelope env; env.x.resize(bins); env.ymin.resize(bins); env.ymax.resize(bins); env.mean.resize(bins);
 
-    const uint64_t frames_available = std::min<uint64_t>(widx_snapshot, ring.capacity());
-    const uint64_t window_frames    = (uint64_t)std::llround(window_seconds * fps);
-    const uint64_t span             = std::min<uint64_t>(window_frames, frames_available);
+    const DecodedFrameRing::FrameRange r = ring.window_range(widx_snapshot, window_seconds);
+    const uint64_t span = r.last - r.first;
 
     if (span == 0) {
         std::fill(env.ymin.begin(), env.ymin.end(), 0.0);
@@ -60,33 +929,342 @@ Envelope build_envelope(const DecodedFrameRing& ring,
         return env;
     }
 
-    const uint64_t start_abs = widx_snapshot > span ? (widx_snapshot - span) : 0; // [start_abs, widx)
+    const uint64_t start_abs = r.first; // [start_abs, widx)
     const double frames_per_bin = (double)span / bins;
 
     for (int b = 0; b < bins; ++b) {
         uint64_t f0 = start_abs + (uint64_t)std::floor(b * frames_per_bin);
         uint64_t f1 = start_abs + (uint64_t)std::floor((b + 1) * frames_per_bin);
         if (f1 <= f0) f1 = f0 + 1;
+        f1 = std::min(f1, r.last);
 
-        double vmin = 1e300, vmax = -1e300, sum = 0.0;
-        int count = 0;
-        for (uint64_t f = f0; f < f1; ++f) {
-            double v = (double)ring.get_sample(f, channel);
-            vmin = std::min(vmin, v);
-            vmax = std::max(vmax, v);
-            sum += v; ++count;
+        const RangeStats st = ring.range_stats(f0, f1, channel, widx_snapshot);
+        if (st.count) {
+            env.ymin[b] = st.vmin;
+            env.ymax[b] = st.vmax;
+            env.mean[b] = (double)st.sum / (double)st.count;
+        } else {
+            env.ymin[b] = env.ymax[b] = env.mean[b] = 0.0;
         }
-        env.ymin[b] = vmin;
-        env.ymax[b] = vmax;
-        env.mean[b] = sum / std::max(1, count);
 
-        double t_center = -window_seconds + (b + 0.5) * (window_seconds / bins);
-        env.x[b] = t_center;
+        // bin 中心取其首尾帧时间戳的中点：帧间断档会表现为 x 上的跳变
+        const int64_t tc = (ring.timestamp_ns(f0) + ring.timestamp_ns(f1 - 1)) / 2;
+        env.x[b] = (double)(tc - r.t_end_ns) * 1e-9;
     }
 
     return env;
 }
 
+// 把升序通道切成连续段：间隔不超过 kGap 的并成一段，中间未选通道一并算（比分段调用便宜）
+template <class Run>
+static void split_channel_runs(const std::vector<int>& chs, std::vector<Run>& runs) {
+    constexpr int kGap = 8;
+    runs.clear();
+    for (size_t i = 0; i < chs.size(); ++i) {
+        if (!runs.empty() && chs[i] - (runs.back().c0 + runs.back().n - 1) <= kGap) {
+            runs.back().n = chs[i] - runs.back().c0 + 1;
+            ++runs.back().nslots;
+        } else {
+            runs.push_back({chs[i], 1, i, 1});
+        }
+    }
+}
+
+void build_envelopes(const DecodedFrameRing& ring,
+                     uint64_t widx_snapshot,
+                     const std::vector<int>& channels,
+                     double window_seconds,
+                     int bins,
+                     MultiEnvelope& out) {
+    std::vector<int>& chs = out.channels;
+    chs.clear();
+    for (int c : channels)
+        if (c >= 0 && c < ring.samples_per_frame()) chs.push_back(c);
+    std::sort(chs.begin(), chs.end());
+    chs.erase(std::unique(chs.begin(), chs.end()), chs.end());
+
+    bins = std::max(1, bins);
+    const size_t total = chs.size() * static_cast<size_t>(bins);
+    out.bins = bins;
+    out.window_seconds = window_seconds;
+    out.widx = widx_snapshot;
+    out.x.resize(static_cast<size_t>(bins));
+    out.ymin.assign(total, 0.0);
+    out.ymax.assign(total, 0.0);
+    out.mean.assign(total, 0.0);
+
+    const DecodedFrameRing::FrameRange r = ring.window_range(widx_snapshot, window_seconds);
+    const uint64_t span = r.last - r.first;
+    if (span == 0) {
+        for (int i = 0; i < bins; ++i)
+            out.x[i] = -window_seconds + (window_seconds * (i + 0.5) / bins);
+        return;
+    }
+
+    struct Run { int c0, n; size_t first_slot, nslots; };
+    std::vector<Run> runs;
+    split_channel_runs(chs, runs);
+    int widest = 0;
+    for (const Run& run : runs) widest = std::max(widest, run.n);
+    std::vector<uint16_t> mn(static_cast<size_t>(widest)), mx(static_cast<size_t>(widest));
+    std::vector<uint64_t> sm(static_cast<size_t>(widest));
+
+    const uint64_t start_abs = r.first;
+    const double frames_per_bin = (double)span / bins;
+
+    for (int b = 0; b < bins; ++b) {
+        uint64_t f0 = start_abs + (uint64_t)std::floor(b * frames_per_bin);
+        uint64_t f1 = start_abs + (uint64_t)std::floor((b + 1) * frames_per_bin);
+        if (f1 <= f0) f1 = f0 + 1;
+        f1 = std::min(f1, r.last);
+
+        for (const Run& run : runs) {
+            std::fill(mn.begin(), mn.begin() + run.n, uint16_t(0xFFFF));
+            std::fill(mx.begin(), mx.begin() + run.n, uint16_t(0));
+            std::fill(sm.begin(), sm.begin() + run.n, uint64_t(0));
+            const uint64_t cnt = ring.range_stats_span(f0, f1, run.c0, run.n, widx_snapshot, mn.data(), mx.data(), sm.data());
+            if (!cnt) continue;
+            for (size_t k = run.first_slot; k < run.first_slot + run.nslots; ++k) {
+                const int    c = chs[k] - run.c0;
+                const size_t o = k * static_cast<size_t>(bins) + static_cast<size_t>(b);
+                out.ymin[o] = mn[c];
+                out.ymax[o] = mx[c];
+                out.mean[o] = (double)sm[c] / (double)cnt;
+            }
+        }
+
+        // 与 build_envelope 相同：bin 中心取其首尾帧时间戳的中点
+        const int64_t tc = (ring.timestamp_ns(f0) + ring.timestamp_ns(f1 - 1)) / 2;
+        out.x[b] = (double)(tc - r.t_end_ns) * 1e-9;
+    }
+}
+
+void SlidingEnvelope::plan(const DecodedFrameRing& ring, uint64_t widx_snapshot, double window_seconds, int bins, Grid& g) {
+    bins = std::max(1, bins);
+    const uint64_t nb   = static_cast<uint64_t>(bins);
+    const uint64_t prev = g.widx;
+    const DecodedFrameRing::FrameRange r = ring.window_range(widx_snapshot, window_seconds);
+    g.widx     = widx_snapshot;
+    g.t_end_ns = r.t_end_ns;
+    const uint64_t span = r.last - r.first;
+    if (span == 0) { g.fpb = 0; g.bins = bins; g.window = window_seconds; return; }
+
+    // 是否沿用现有划分：设置不变，fpb 偏离不超过 ±10%，且上次规划之后的新帧仍在环内、不超过一整窗
+    const uint64_t fpb = std::max<uint64_t>(1, (span + nb - 1) / nb);
+    const uint64_t oldest = widx_snapshot > ring.capacity() ? widx_snapshot - ring.capacity() : 0;
+    const bool keep = g.fpb != 0 && bins == g.bins && window_seconds == g.window
+                   && fpb * 10 >= g.fpb * 9 && fpb * 10 <= g.fpb * 11
+                   && prev <= widx_snapshot && prev >= oldest && widx_snapshot - prev <= g.fpb * nb;
+    if (keep) return;
+
+    // 从覆盖最近 bins 个 bin 的起点开始（不早于环内最老的帧）
+    const uint64_t kh = (widx_snapshot - 1) / fpb;
+    g.bins      = bins;
+    g.window    = window_seconds;
+    g.fpb       = fpb;
+    g.start     = std::max(kh >= nb - 1 ? (kh - (nb - 1)) * fpb : 0, oldest);
+    g.first_bin = g.start / fpb;
+    ++g.gen;
+}
+
+void SlidingEnvelope::update(const DecodedFrameRing& ring,
+                             uint64_t widx_snapshot,
+                             const std::vector<int>& channels,
+                             double window_seconds,
+                             int bins,
+                             MultiEnvelope& out) {
+    plan(ring, widx_snapshot, window_seconds, bins, own_);
+    update(ring, channels, own_, out);
+}
+
+void SlidingEnvelope::update(const DecodedFrameRing& ring, const std::vector<int>& channels, const Grid& g, MultiEnvelope& out) {
+    std::vector<int>& chs = out.channels;
+    chs.clear();
+    for (int c : channels)
+        if (c >= 0 && c < ring.samples_per_frame()) chs.push_back(c);
+    std::sort(chs.begin(), chs.end());
+    chs.erase(std::unique(chs.begin(), chs.end()), chs.end());
+
+    const int bins = std::max(1, g.bins);
+    const size_t nb = static_cast<size_t>(bins);
+    const size_t nch = chs.size();
+    const uint64_t widx_snapshot = g.widx;
+    out.bins = bins;
+    out.window_seconds = g.window;
+    out.widx = widx_snapshot;
+    out.x.resize(nb);
+    out.ymin.resize(nch * nb);
+    out.ymax.resize(nch * nb);
+    out.mean.resize(nch * nb);
+
+    if (g.fpb == 0) {
+        valid_ = false;
+        std::fill(out.ymin.begin(), out.ymin.end(), 0.0);
+        std::fill(out.ymax.begin(), out.ymax.end(), 0.0);
+        std::fill(out.mean.begin(), out.mean.end(), 0.0);
+        for (int i = 0; i < bins; ++i)
+            out.x[i] = -g.window + (g.window * (i + 0.5) / bins);
+        return;
+    }
+
+    // 是否沿用已累加的数据：划分、通道不变，且新帧仍在环内、不超过一整窗（本实例可能有几轮没被调用）
+    const uint64_t oldest = widx_snapshot > ring.capacity() ? widx_snapshot - ring.capacity() : 0;
+    const bool keep = valid_ && gen_ == g.gen && chs == chs_
+                   && done_ <= widx_snapshot && done_ >= oldest && widx_snapshot - done_ <= g.fpb * nb;
+    if (!keep) {
+        chs_  = chs;
+        bins_ = bins;
+        split_channel_runs(chs_, runs_);
+        int widest = 0;
+        for (const Run& run : runs_) widest = std::max(widest, run.n);
+        tmp_mn_.resize(static_cast<size_t>(widest));
+        tmp_mx_.resize(static_cast<size_t>(widest));
+        tmp_sum_.resize(static_cast<size_t>(widest));
+        mn_.resize(nb * nch);
+        mx_.resize(nb * nch);
+        sum_.resize(nb * nch);
+        cnt_.resize(nb);
+        t0_.resize(nb);
+        t1_.resize(nb);
+        restart(ring, g);
+    }
+
+    // 只累加新到的帧，遇到 bin 边界换到下一个槽位
+    while (done_ < widx_snapshot) {
+        const uint64_t k = done_ / fpb_;
+        const size_t slot = static_cast<size_t>(k % nb);
+        if (k != head_) {
+            head_ = k;
+            cnt_[slot] = 0;
+            std::fill_n(&mn_[slot * nch], nch, uint16_t(0xFFFF));
+            std::fill_n(&mx_[slot * nch], nch, uint16_t(0));
+            std::fill_n(&sum_[slot * nch], nch, uint64_t(0));
+        }
+        const uint64_t end = std::min(widx_snapshot, (k + 1) * fpb_);
+        accumulate(ring, done_, end, widx_snapshot, slot);
+        done_ = end;
+    }
+
+    // 输出最近 bins 个 bin；划分建立后还没有数据的最老几个 bin 重复第一个有效 bin（退化为一个点）
+    const uint64_t kh = head_;
+    const uint64_t first = std::max(g.first_bin, first_bin_);
+    for (size_t b = 0; b < nb; ++b) {
+        const uint64_t back = static_cast<uint64_t>(nb - 1 - b);
+        const uint64_t k = kh >= first + back ? kh - back : first;
+        const size_t slot = static_cast<size_t>(k % nb);
+        const double inv = 1.0 / static_cast<double>(cnt_[slot]);
+        for (size_t i = 0; i < nch; ++i) {
+            const size_t src = slot * nch + i;
+            const size_t dst = i * nb + b;
+            out.ymin[dst] = mn_[src];
+            out.ymax[dst] = mx_[src];
+            out.mean[dst] = static_cast<double>(sum_[src]) * inv;
+        }
+        // 与 build_envelope 相同：bin 中心取其首尾帧时间戳的中点
+        out.x[b] = static_cast<double>((t0_[slot] + t1_[slot]) / 2 - g.t_end_ns) * 1e-9;
+    }
+}
+
+// 在划分 g 上重新累加：从最近 bins 个 bin 的起点开始，不早于划分的起点与环内最老的帧。
+// 划分没变时各实例的 bin 号仍一一对应，只是本实例少了更早的 bin
+void SlidingEnvelope::restart(const DecodedFrameRing& ring, const Grid& g) {
+    const uint64_t nb = static_cast<uint64_t>(bins_);
+    const uint64_t widx = g.widx;
+    const uint64_t kh = (widx - 1) / g.fpb;
+    const uint64_t oldest = widx > ring.capacity() ? widx - ring.capacity() : 0;
+    done_      = std::max({kh >= nb - 1 ? (kh - (nb - 1)) * g.fpb : 0, g.start, oldest});
+    fpb_       = g.fpb;
+    first_bin_ = done_ / fpb_;
+    head_      = ~uint64_t(0);
+    gen_       = g.gen;
+    valid_     = true;
+    ++rebuilds_;
+}
+
+void SlidingEnvelope::accumulate(const DecodedFrameRing& ring, uint64_t f0, uint64_t f1, uint64_t widx, size_t slot) {
+    const size_t nch = chs_.size();
+    uint64_t cnt = 0;
+    for (const Run& run : runs_) {
+        std::fill_n(tmp_mn_.begin(), run.n, uint16_t(0xFFFF));
+        std::fill_n(tmp_mx_.begin(), run.n, uint16_t(0));
+        std::fill_n(tmp_sum_.begin(), run.n, uint64_t(0));
+        cnt = ring.range_stats_span(f0, f1, run.c0, run.n, widx, tmp_mn_.data(), tmp_mx_.data(), tmp_sum_.data());
+        for (size_t k = run.first_slot; k < run.first_slot + run.nslots; ++k) {
+            const int    c = chs_[k] - run.c0;
+            const size_t o = slot * nch + k;
+            mn_[o]   = std::min(mn_[o], tmp_mn_[static_cast<size_t>(c)]);
+            mx_[o]   = std::max(mx_[o], tmp_mx_[static_cast<size_t>(c)]);
+            sum_[o] += tmp_sum_[static_cast<size_t>(c)];
+        }
+    }
+    if (runs_.empty()) cnt = f1 - f0;
+    if (cnt_[slot] == 0) t0_[slot] = ring.timestamp_ns(f0);
+    t1_[slot] = ring.timestamp_ns(f1 - 1);
+    cnt_[slot] += cnt;
+}
+
+size_t decimate_m4(const DecodedFrameRing& ring,
+                   uint64_t widx_snapshot,
+                   int channel,
+                   double window_seconds,
+                   int columns,
+                   std::vector<double>& x,
+                   std::vector<double>& y) {
+    x.clear();
+    y.clear();
+    const DecodedFrameRing::FrameRange r = ring.window_range(widx_snapshot, window_seconds);
+    if (r.last == r.first || channel < 0 || channel >= ring.samples_per_frame()) return 0;
+    columns = std::max(1, columns);
+    x.reserve(static_cast<size_t>(columns) * 4);
+    y.reserve(static_cast<size_t>(columns) * 4);
+
+    auto emit = [&](int64_t t, double v) {
+        x.push_back(static_cast<double>(t - r.t_end_ns) * 1e-9);
+        y.push_back(v);
+    };
+
+    // 第 i 列为时间 [t0 + w*i/columns, t0 + w*(i+1)/columns)，边界帧由时间索引二分得到
+    const double  w_ns = window_seconds * 1e9;
+    const int64_t t0   = r.t_end_ns - static_cast<int64_t>(std::llround(w_ns));
+    uint64_t a = r.first;
+    for (int i = 0; i < columns && a < r.last; ++i) {
+        const uint64_t b = i + 1 == columns ? r.last
+                         : ring.lower_bound_time(t0 + static_cast<int64_t>(std::llround(w_ns * (i + 1) / columns)), a, r.last);
+        if (b == a) continue;
+
+        const int64_t  ta = ring.timestamp_ns(a);
+        const int64_t  tb = ring.timestamp_ns(b - 1);
+        const uint16_t va = ring.get_sample(a, channel);
+        const uint16_t vb = ring.get_sample(b - 1, channel);
+        emit(ta, va);
+        if (b - a > 2) {
+            const RangeStats st = ring.range_stats(a, b, channel, widx_snapshot);
+            // 先到离首样本近的极值，列内少一次来回
+            const bool min_first = va - st.vmin <= st.vmax - va;
+            const int64_t tm = ta + (tb - ta) / 2;
+            emit(tm, min_first ? st.vmin : st.vmax);
+            emit(tm, min_first ? st.vmax : st.vmin);
+        }
+        if (b - a > 1) emit(tb, vb);
+        a = b;
+    }
+    return x.size();
+}
+
+void high_pass_rc(double* y, size_t n, double dt, double fc_hz) {
+    if (n == 0 || fc_hz <= 0.0) return;
+    const double tau   = 1.0 / (2.0 * M_PI * fc_hz);
+    const double alpha = tau / (tau + dt);
+    // 与 PlotWidget 原先的实现逐点一致（y[i-1] 已是上一点的输出）
+    double prevY = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        const double x = y[i];
+        const double hp = alpha * (prevY + x - (i > 0 ? y[i-1] : x));
+        prevY = x;
+        y[i] = hp;
+    }
+}
+
 void smooth_ema(std::vector<double>& y, double dt_sec, double tau_ms) {
     if (y.empty()) return;
     double tau = std::max(1e-6, tau_ms / 1000.0);
@@ -0,0 +1,191 @@
+#include "EnvelopeAggregator.hpp"
+
+#include <algorithm>
+
+namespace {
+constexpr size_t kMinChannelsPerPart = 4; // 通道太少时分段的线程开销大于收益
+}
+
+EnvelopeAggregator::EnvelopeAggregator(int threads) {
+    if (threads <= 0) threads = std::clamp(static_cast<int>(std::thread::hardware_concurrency()) / 2, 1, 4);
+    part_channels_.resize(static_cast<size_t>(threads));
+    part_env_.resize(static_cast<size_t>(threads));
+    part_slide_.resize(static_cast<size_t>(threads));
+    part_epoch_.assign(static_cast<size_t>(threads), 0);
+    for (int i = 0; i < threads; ++i) threads_.emplace_back(&EnvelopeAggregator::worker_loop, this, i);
+}
+
+EnvelopeAggregator::~EnvelopeAggregator() {
+    {
+        std::lock_guard<std::mutex> lk(mu_);
+        quit_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : threads_) t.join();
+}
+
+void EnvelopeAggregator::attachRing(const DecodedFrameRing* ring) {
+    std::unique_lock<std::mutex> lk(mu_);
+    pending_ = false;
+    idle_cv_.wait(lk, [&] { return !busy_; });
+    cfg_.ring = ring;
+    ++cfg_.epoch;
+    ++cfg_.version;
+    gui_epoch_ = cfg_.epoch;
+}
+
+void EnvelopeAggregator::setChannels(const std::vector<int>& channels) {
+    std::lock_guard<std::mutex> lk(mu_);
+    cfg_.channels = channels;
+    std::sort(cfg_.channels.begin(), cfg_.channels.end());
+    cfg_.channels.erase(std::unique(cfg_.channels.begin(), cfg_.channels.end()), cfg_.channels.end());
+    ++cfg_.version;
+}
+
+void EnvelopeAggregator::setView(double window_seconds, int bins) {
+    std::lock_guard<std::mutex> lk(mu_);
+    cfg_.windowSec = window_seconds;
+    cfg_.bins      = bins;
+    ++cfg_.version;
+}
+
+void EnvelopeAggregator::setHighPassCutHz(double hz) {
+    std::lock_guard<std::mutex> lk(mu_);
+    cfg_.hpfCutHz = hz;
+    ++cfg_.version;
+}
+
+// ------------------------ GUI 线程 ------------------------
+
+void EnvelopeAggregator::request(uint64_t widx) {
+    std::lock_guard<std::mutex> lk(mu_);
+    if (!cfg_.ring || cfg_.channels.empty()) return;
+    if (widx == last_req_widx_ && cfg_.version == last_req_version_) return; // 同一写指针、同一配置已经请求过
+    last_req_widx_    = widx;
+    last_req_version_ = cfg_.version;
+    pending_widx_ = widx;
+    pending_      = true;
+    if (!busy_) cv_.notify_all();
+}
+
+bool EnvelopeAggregator::acquire() {
+    if (!(middle_.load(std::memory_order_acquire) & kFresh)) return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & 3;
+    return true;
+}
+
+bool EnvelopeAggregator::hasSnapshot() const {
+    const Snapshot& f = bufs_[front_];
+    return f.valid && f.epoch == gui_epoch_;
+}
+
+uint64_t EnvelopeAggregator::snapshotWriteIndex() const {
+    return bufs_[front_].env.widx;
+}
+
+bool EnvelopeAggregator::slice(int ch, double window_seconds, int bins, double hpf_cut_hz, EnvelopeSlice& out) const {
+    const Snapshot& f = bufs_[front_];
+    if (!f.valid || f.epoch != gui_epoch_) return false;
+    if (bins != f.env.bins || window_seconds != f.env.window_seconds) return false;
+    const int s = f.env.slot_of(ch);
+    if (s < 0) return false;
+    const size_t o = static_cast<size_t>(s) * static_cast<size_t>(f.env.bins);
+    out.x    = f.env.x.data();
+    out.ymin = f.env.ymin.data() + o;
+    out.ymax = f.env.ymax.data() + o;
+    out.mean = f.env.mean.data() + o;
+    out.hpf  = f.hpfCutHz == hpf_cut_hz ? f.hpf.data() + o : nullptr;
+    out.bins = f.env.bins;
+    out.widx = f.env.widx;
+    return true;
+}
+
+// ------------------------ 工作线程 ------------------------
+
+void EnvelopeAggregator::worker_loop(int index) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lk(mu_);
+    for (;;) {
+        cv_.wait(lk, [&] { return quit_ || job_gen_ != seen || (index == 0 && pending_ && !busy_); });
+        if (quit_) return;
+
+        if (job_gen_ == seen) {
+            // 0 号线程开新任务：取最新的请求与配置，按通道均分给各线程
+            job_      = cfg_;
+            job_widx_ = pending_widx_;
+            job_t0_   = metrics_now_ns();
+            pending_  = false;
+            busy_     = true;
+            // bin 划分整个任务只定一次、各段共用：各段自行重建会落到不同的 bin 上，而快照只有一份 x
+            if (grid_epoch_ != job_.epoch) { grid_.fpb = 0; grid_epoch_ = job_.epoch; }
+            SlidingEnvelope::plan(*job_.ring, job_widx_, job_.windowSec, job_.bins, grid_);
+            const size_t n = job_.channels.size();
+            job_parts_ = static_cast<int>(std::clamp<size_t>(n / kMinChannelsPerPart, 1, threads_.size()));
+            for (int p = 0; p < job_parts_; ++p) {
+                const size_t a = n * static_cast<size_t>(p) / static_cast<size_t>(job_parts_);
+                const size_t b = n * static_cast<size_t>(p + 1) / static_cast<size_t>(job_parts_);
+                part_channels_[static_cast<size_t>(p)].assign(job_.channels.begin() + a, job_.channels.begin() + b);
+            }
+            parts_left_.store(job_parts_, std::memory_order_relaxed);
+            ++job_gen_;
+            cv_.notify_all();
+        }
+        seen = job_gen_;
+        if (index >= job_parts_) continue;
+
+        lk.unlock();
+        compute_part(index);
+        const bool last = parts_left_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        if (last) publish();
+        lk.lock();
+
+        if (last) {
+            busy_ = false;
+            idle_cv_.notify_all();
+            if (pending_) cv_.notify_all(); // 计算期间又来了请求
+        }
+    }
+}
+
+void EnvelopeAggregator::compute_part(int part) {
+    const size_t p = static_cast<size_t>(part);
+    if (part_epoch_[p] != job_.epoch) { // 换过环：帧号不再连续
+        part_slide_[p].reset();
+        part_epoch_[p] = job_.epoch;
+    }
+    part_slide_[p].update(*job_.ring, part_channels_[p], grid_, part_env_[p]);
+}
+
+// 由最后完成的线程调用：拼接各段结果、算高通，写进后台缓冲后与中间缓冲交换
+void EnvelopeAggregator::publish() {
+    Snapshot& b = bufs_[back_];
+    MultiEnvelope& e = b.env;
+    const MultiEnvelope& first = part_env_[0];
+    e.bins           = first.bins;
+    e.window_seconds = first.window_seconds;
+    e.widx           = first.widx;
+    e.x              = first.x;
+    e.channels.clear();
+    e.ymin.clear(); e.ymax.clear(); e.mean.clear();
+    for (int p = 0; p < job_parts_; ++p) {
+        const MultiEnvelope& pe = part_env_[static_cast<size_t>(p)];
+        e.channels.insert(e.channels.end(), pe.channels.begin(), pe.channels.end());
+        e.ymin.insert(e.ymin.end(), pe.ymin.begin(), pe.ymin.end());
+        e.ymax.insert(e.ymax.end(), pe.ymax.begin(), pe.ymax.end());
+        e.mean.insert(e.mean.end(), pe.mean.begin(), pe.mean.end());
+    }
+
+    // mean 的高通，与 PlotWidget 自行计算时的 dt 取法一致
+    const size_t bins = static_cast<size_t>(e.bins);
+    const double dt = bins > 1 ? std::max(1e-9, (e.x.back() - e.x.front()) / double(bins - 1))
+                               : e.window_seconds / double(std::max<size_t>(1, bins));
+    b.hpf = e.mean;
+    for (size_t o = 0; o + bins <= b.hpf.size(); o += bins) high_pass_rc(b.hpf.data() + o, bins, dt, job_.hpfCutHz);
+
+    b.hpfCutHz = job_.hpfCutHz;
+    b.epoch    = job_.epoch;
+    b.valid    = true;
+    back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) & 3;
+    if (PipelineMetrics* m = metrics_.load(std::memory_order_relaxed))
+        (*m)[PipelineStage::ENVELOPE_PASS].record(metrics_now_ns() - job_t0_);
+}
@@ -0,0 +1,189 @@
+#include "FrameGenerator.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+int64_t clock_ns(clockid_t id) {
+    timespec ts{};
+    ::clock_gettime(id, &ts);
+    return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+} // namespace
+
+// ------------------------ FrameGenerator ------------------------
+
+FrameGenerator::FrameGenerator(const ParserConfig& cfg, const GeneratorConfig& gen)
+: cfg_(cfg), gen_(gen) {
+    if (!validate_parser_config(cfg_, why_)) return;
+
+    const int n = cfg_.samples_per_frame;
+    scratch_.assign(static_cast<size_t>(n), 0);
+
+    // 相位用 32 位定点累加，查表代替 sin()：生成速度要跟得上线速率
+    const double fps = gen_.fps > 0 ? gen_.fps : 20000.0;
+    phase_inc_.resize(static_cast<size_t>(n));
+    for (int c = 0; c < n; ++c) {
+        const double cycles_per_frame = gen_.freq_hz * (1.0 + c / 64.0) / fps;
+        phase_inc_[c] = static_cast<uint32_t>(std::llround(std::fmod(cycles_per_frame, 1.0) * 4294967296.0));
+    }
+    const double full = cfg_.max_sample();
+    const double mid  = full / 2.0;
+    const double amp  = std::clamp(gen_.amplitude, 0.0, 1.0) * mid;
+    sine_.resize(size_t(1) << kSineLog2);
+    for (size_t i = 0; i < sine_.size(); ++i) {
+        const double v = mid + amp * std::sin(2.0 * M_PI * double(i) / double(sine_.size()));
+        sine_[i] = static_cast<uint16_t>(std::clamp(std::lround(v), 0L, static_cast<long>(full)));
+    }
+}
+
+bool FrameGenerator::ok(std::string& why) const {
+    why = why_;
+    return why_.empty();
+}
+
+void FrameGenerator::samples(uint64_t index, uint16_t* out) const {
+    const int      n    = cfg_.samples_per_frame;
+    const uint16_t mask = cfg_.max_sample();
+    switch (gen_.waveform) {
+    case GenWaveform::SINE:
+        for (int c = 0; c < n; ++c) {
+            const uint32_t ph = static_cast<uint32_t>(index * phase_inc_[c]);
+            out[c] = sine_[ph >> (32 - kSineLog2)];
+        }
+        break;
+    case GenWaveform::COUNTER: {
+        const int bits = cfg_.bits_per_sample;
+        const int k    = std::min(kCounterChannels, n);
+        for (int c = 0; c < k; ++c)
+            out[c] = static_cast<uint16_t>(bits * c < 64 ? (index >> (bits * c)) & mask : 0);
+        for (int c = k; c < n; ++c) out[c] = static_cast<uint16_t>((index + uint64_t(c)) & mask);
+        break;
+    }
+    case GenWaveform::RAMP:
+        for (int c = 0; c < n; ++c) out[c] = static_cast<uint16_t>((index + uint64_t(c)) & mask);
+        break;
+    }
+}
+
+void FrameGenerator::make(uint64_t index, uint8_t* out) {
+    std::memset(out, 0, static_cast<size_t>(cfg_.header_bytes));
+    if (cfg_.seq_offset >= 0) {
+        const uint64_t seq = gen_.seq_start + index;
+        uint8_t* p = out + cfg_.seq_offset;
+        for (int i = 0; i < cfg_.seq_bytes; ++i) {
+            const uint8_t b = static_cast<uint8_t>(seq >> (8 * i));
+            if (cfg_.seq_big_endian) p[cfg_.seq_bytes - 1 - i] = b;
+            else                     p[i] = b;
+        }
+    }
+    samples(index, scratch_.data());
+    pack_payload(scratch_.data(), out + cfg_.header_bytes, cfg_);
+    const int rest = cfg_.frame_size_bytes - cfg_.header_bytes - cfg_.payload_bytes;
+    if (rest > 0) std::memset(out + cfg_.header_bytes + cfg_.payload_bytes, 0, static_cast<size_t>(rest));
+}
+
+uint64_t FrameGenerator::decode_counter(const uint16_t* samples, const ParserConfig& cfg) {
+    const int bits = cfg.bits_per_sample;
+    const int k    = std::min(kCounterChannels, cfg.samples_per_frame);
+    uint64_t v = 0;
+    for (int c = 0; c < k && bits * c < 64; ++c) v |= uint64_t(samples[c] & cfg.max_sample()) << (bits * c);
+    return v;
+}
+
+// ------------------------ UDP 发送 ------------------------
+
+bool run_udp_sender(FrameGenerator& gen, const SenderOptions& opt, const std::atomic<bool>& running,
+                    SenderStats& stats, std::string& why, const SendCallback& on_send) {
+    sockaddr_in dst{};
+    dst.sin_family = AF_INET;
+    dst.sin_port   = htons(static_cast<uint16_t>(opt.dst_port));
+    if (::inet_pton(AF_INET, opt.dst_addr, &dst.sin_addr) != 1) {
+        why = std::string("bad destination address: ") + opt.dst_addr;
+        return false;
+    }
+    const int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) { why = std::string("socket: ") + std::strerror(errno); return false; }
+    if (opt.sndbuf_bytes > 0) {
+        int sz = opt.sndbuf_bytes;
+        if (::setsockopt(fd, SOL_SOCKET, SO_SNDBUFFORCE, &sz, sizeof(sz)) != 0)
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sz, sizeof(sz));
+    }
+    // connect 之后 sendmmsg 不必逐条带目的地址
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&dst), sizeof(dst)) != 0) {
+        why = std::string("connect: ") + std::strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    const int    batch  = std::clamp(opt.batch, 1, 1024);
+    const size_t fbytes = static_cast<size_t>(gen.frame_bytes());
+    std::vector<uint8_t> buf(fbytes * batch);
+    std::vector<iovec>   iov(batch);
+    std::vector<mmsghdr> msgs(batch);
+    for (int i = 0; i < batch; ++i) {
+        iov[i].iov_base = buf.data() + fbytes * i;
+        iov[i].iov_len  = fbytes;
+        msgs[i] = mmsghdr{};
+        msgs[i].msg_hdr.msg_iov    = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    const double ns_per_frame = opt.rate_fps > 0 ? 1e9 / opt.rate_fps : 0.0;
+    const int64_t t0 = clock_ns(CLOCK_MONOTONIC);
+    uint64_t next = 0;  // 下一个要发的帧号
+    bool ok = true;
+
+    while (running.load(std::memory_order_relaxed) && (opt.count == 0 || next < opt.count)) {
+        uint64_t want = static_cast<uint64_t>(batch);
+        if (ns_per_frame > 0) {
+            // 到期帧数 = 已过时间 * 速率；未到期则睡到下一帧（剩余不足 100us 时忙等）
+            const int64_t  el  = clock_ns(CLOCK_MONOTONIC) - t0;
+            const uint64_t due = static_cast<uint64_t>(double(el) / ns_per_frame) + 1;
+            if (due <= next) {
+                const int64_t wait = static_cast<int64_t>(double(next) * ns_per_frame) - el;
+                if (wait > 100000) {
+                    timespec ts{0, static_cast<long>(std::min<int64_t>(wait - 50000, 100000000))};
+                    ::nanosleep(&ts, nullptr);
+                }
+                continue;
+            }
+            want = std::min<uint64_t>(want, due - next);
+        }
+        if (opt.count) want = std::min<uint64_t>(want, opt.count - next);
+
+        const int n = static_cast<int>(want);
+        for (int i = 0; i < n; ++i) gen.make(next + i, buf.data() + fbytes * i);
+        if (on_send) on_send(next, n, clock_ns(CLOCK_REALTIME));
+        const int r = ::sendmmsg(fd, msgs.data(), static_cast<unsigned>(n), 0);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            if (errno == ENOBUFS || errno == EAGAIN || errno == ECONNREFUSED) {
+                // 本地队列满，或对端端口暂时没人监听（ICMP 不可达在下一次发送时报告）：
+                // 这批算发送端丢弃，帧号照常前进，接收端会记为序号缺口
+                stats.send_errors += static_cast<uint64_t>(n);
+                next += static_cast<uint64_t>(n);
+                continue;
+            }
+            why = std::string("sendmmsg: ") + std::strerror(errno);
+            ok = false;
+            break;
+        }
+        next += static_cast<uint64_t>(r);
+        stats.frames_sent += static_cast<uint64_t>(r);
+        stats.bytes_sent  += static_cast<uint64_t>(r) * fbytes;
+        stats.wall_ns.store(clock_ns(CLOCK_MONOTONIC) - t0, std::memory_order_relaxed);
+    }
+    ::close(fd);
+    return ok;
+}
@@ -1,5 +1,8 @@
 #include "MainWindow.hpp"
 #include "PlotWidget.hpp"
+#include "RepaintScheduler.hpp"
+#include "Recorder.hpp"
+#include "EnvelopeAggregator.hpp"
 
 #include <QVBoxLayout>
 #include <QHBoxLayout>
@@ -14,6 +17,15 @@
 #include <QGridLayout>
 #include <QSet>
 #include <QCheckBox>
+#include <QDialog>
+#include <QPlainTextEdit>
+#include <QFontDatabase>
+#include <QFileDialog>
+#include <QDockWidget>
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QToolButton>
+#include <QFile>
 
 // 主题色
 static QColor themeColor(int idx) {
@@ -27,9 +39,16 @@ static QColor themeColor(int idx) {
     }
 }
 
+namespace {
+constexpr int kDefaultRingMB = 512; // 约等于原先固定的 200000 帧 × 1024 样本
+}
+
 MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
-    ring_  = std::make_unique<DecodedFrameRing>(200000);
+    ring_  = std::make_unique<DecodedFrameRing>(
+        DecodedFrameRing::frames_for_budget(size_t(kDefaultRingMB) << 20, RingOptions{}), RingOptions{});
     stats_ = std::make_unique<RuntimeStats>();
+    inspector_ = std::make_unique<PacketInspector>(256);
+    metrics_   = std::make_unique<PipelineMetrics>();
 
     central_ = new QWidget(this);
     setCentralWidget(central_);
@@ -39,27 +58,59 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
     auto* row = new QHBoxLayout();
     ifEdit_ = new QLineEdit("enp3s0");
     bpfEdit_ = new QLineEdit("udp and src host 12.0.0.2 and dst host 12.0.0.1 and src port 2827 and dst port 2827 and udp[4:2] = 1307");
+    backendCombo_ = new QComboBox();
+    backendCombo_->addItem("pcap",       static_cast<int>(CaptureBackend::PCAP));
+    backendCombo_->addItem("TPACKET_V3", static_cast<int>(CaptureBackend::TPACKET_V3));
+    backendCombo_->addItem("UDP socket", static_cast<int>(CaptureBackend::UDP_SOCKET));
+    backendCombo_->addItem("Replay file", static_cast<int>(CaptureBackend::REPLAY_FILE));
+    bindEdit_ = new QLineEdit("12.0.0.1:2827");
+    bindEdit_->setEnabled(false);
+    rxThreadsSpin_ = new QSpinBox(); rxThreadsSpin_->setRange(1, RuntimeStats::kMaxRxQueues); rxThreadsSpin_->setValue(1);
+    rxThreadsSpin_->setEnabled(false);
+    fanoutCombo_ = new QComboBox();
+    fanoutCombo_->addItem("hash", static_cast<int>(FanoutMode::HASH));
+    fanoutCombo_->addItem("cpu",  static_cast<int>(FanoutMode::CPU));
+    fanoutCombo_->addItem("lb",   static_cast<int>(FanoutMode::LB));
+    fanoutCombo_->setEnabled(false);
+    replayEdit_ = new QLineEdit(); replayEdit_->setPlaceholderText(".pcap / .pcapng / .udpsrec");
+    replayBrowseBtn_ = new QPushButton("...");
+    replaySpeedSpin_ = new QDoubleSpinBox(); replaySpeedSpin_->setRange(0.0, 1000.0); replaySpeedSpin_->setDecimals(2);
+    replaySpeedSpin_->setValue(1.0); replaySpeedSpin_->setSpecialValueText("Max");
+    replayLoopCheck_ = new QCheckBox("Loop");
+    for (QWidget* w : std::initializer_list<QWidget*>{replayEdit_, replayBrowseBtn_, replaySpeedSpin_, replayLoopCheck_})
+        w->setEnabled(false);
     binsSpin_ = new QSpinBox(); binsSpin_->setRange(200, 4000); binsSpin_->setValue(1200);
     winSpin_  = new QDoubleSpinBox(); winSpin_->setRange(0.05, 60.0); winSpin_->setDecimals(2); winSpin_->setValue(1.0);
+    fpsSpin_  = new QSpinBox(); fpsSpin_->setRange(0, 240); fpsSpin_->setValue(0); fpsSpin_->setSpecialValueText("Display");
     startBtn_ = new QPushButton("Start");
     stopBtn_  = new QPushButton("Stop"); stopBtn_->setEnabled(false);
+    recordBtn_ = new QPushButton("Record..."); recordBtn_->setCheckable(true);
+    statsBtn_  = new QToolButton();
 
     row->addWidget(new QLabel("Interface:")); row->addWidget(ifEdit_, 0);
     row->addSpacing(8);
     row->addWidget(new QLabel("BPF:")); row->addWidget(bpfEdit_, 1);
+    row->addWidget(new QLabel("Backend:")); row->addWidget(backendCombo_);
+    row->addWidget(new QLabel("Bind:")); row->addWidget(bindEdit_);
+    row->addWidget(new QLabel("RX threads:")); row->addWidget(rxThreadsSpin_); row->addWidget(fanoutCombo_);
+    row->addWidget(new QLabel("File:")); row->addWidget(replayEdit_); row->addWidget(replayBrowseBtn_);
+    row->addWidget(new QLabel("Speed:")); row->addWidget(replaySpeedSpin_); row->addWidget(replayLoopCheck_);
     row->addSpacing(8);
     row->addWidget(new QLabel("Bins:")); row->addWidget(binsSpin_);
     row->addWidget(new QLabel("Window(s):")); row->addWidget(winSpin_);
+    row->addWidget(new QLabel("FPS:")); row->addWidget(fpsSpin_);
     row->addSpacing(8);
-    row->addWidget(startBtn_); row->addWidget(stopBtn_);
+    row->addWidget(startBtn_); row->addWidget(stopBtn_); row->addWidget(recordBtn_); row->addWidget(statsBtn_);
     v->addLayout(row);
 
     // 行2：解析配置
     auto* cfg = new QHBoxLayout();
     packCombo_ = new QComboBox();
-    packCombo_->addItem("RAW10_PACKED", static_cast<int>(PackMode::RAW10_PACKED));
-    packCombo_->addItem("RAW16_LE",     static_cast<int>(PackMode::RAW16_LE));
-    packCombo_->setCurrentIndex(g_cfg.pack == PackMode::RAW10_PACKED ? 0 : 1);
+    for (PackMode m : {PackMode::RAW10_PACKED, PackMode::RAW16_LE, PackMode::RAW16_BE,
+                       PackMode::RAW12_PACKED, PackMode::RAW14_PACKED,
+                       PackMode::MIPI_RAW10, PackMode::MIPI_RAW12})
+        packCombo_->addItem(pack_mode_name(m), static_cast<int>(m));
+    packCombo_->setCurrentIndex(packCombo_->findData(static_cast<int>(g_cfg.pack)));
 
     bitsSpin_ = new QSpinBox(); bitsSpin_->setRange(1, 16); bitsSpin_->setValue(g_cfg.bits_per_sample);
     samplesSpin_ = new QSpinBox(); samplesSpin_->setRange(1, 65536); samplesSpin_->setValue(g_cfg.samples_per_frame);
@@ -69,8 +120,32 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
     payloadSpin_   = new QSpinBox(); payloadSpin_->setRange(0, 1<<23); payloadSpin_->setValue(g_cfg.payload_bytes);
     tailSpin_      = new QSpinBox(); tailSpin_->setRange(0, 1<<20); tailSpin_->setValue(g_cfg.tail_bytes);
 
+    seqOffsetSpin_ = new QSpinBox(); seqOffsetSpin_->setRange(-1, 1<<20); seqOffsetSpin_->setValue(g_cfg.seq_offset);
+    seqOffsetSpin_->setSpecialValueText("Off");
+    seqBytesCombo_ = new QComboBox();
+    for (int b : {1, 2, 4, 8}) seqBytesCombo_->addItem(QString::number(b), b);
+    seqBytesCombo_->setCurrentIndex(seqBytesCombo_->findData(g_cfg.seq_bytes));
+    seqBeCheck_ = new QCheckBox("BE"); seqBeCheck_->setChecked(g_cfg.seq_big_endian);
+    reorderSpin_ = new QSpinBox(); reorderSpin_->setRange(0, 65536); reorderSpin_->setValue(g_cfg.reorder_window);
+
+    layoutCombo_ = new QComboBox();
+    layoutCombo_->addItem("Row-major", static_cast<int>(RingLayout::ROW_MAJOR));
+    layoutCombo_->addItem("Ch-tiled",  static_cast<int>(RingLayout::CHANNEL_TILED));
+    layoutCombo_->addItem("Packed",    static_cast<int>(RingLayout::PACKED));
+    ringMbSpin_ = new QSpinBox(); ringMbSpin_->setRange(16, 1 << 20); ringMbSpin_->setValue(kDefaultRingMB);
+    ringMbSpin_->setSuffix(" MB");
+    ringSecSpin_ = new QDoubleSpinBox(); ringSecSpin_->setRange(0, 86400); ringSecSpin_->setDecimals(1);
+    ringSecSpin_->setSuffix(" s"); ringSecSpin_->setSpecialValueText("Max");
+
     applyCfgBtn_ = new QPushButton("Apply Parser Config");
 
+    inspectCombo_ = new QComboBox();
+    inspectCombo_->addItem("Off",    static_cast<int>(InspectMode::OFF));
+    inspectCombo_->addItem("1 in N", static_cast<int>(InspectMode::ONE_IN_N));
+    inspectCombo_->addItem("N / s",  static_cast<int>(InspectMode::PER_SECOND));
+    inspectRateSpin_ = new QSpinBox(); inspectRateSpin_->setRange(1, 1000000); inspectRateSpin_->setValue(1000);
+    packetsBtn_ = new QPushButton("Packets...");
+
     cfg->addWidget(new QLabel("Pack:"));            cfg->addWidget(packCombo_);
     cfg->addWidget(new QLabel("Bits:"));            cfg->addWidget(bitsSpin_);
     cfg->addWidget(new QLabel("Samples/Frame:"));   cfg->addWidget(samplesSpin_);
@@ -79,8 +154,16 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
     cfg->addWidget(new QLabel("Header:"));          cfg->addWidget(headerSpin_);
     cfg->addWidget(new QLabel("Payload:"));         cfg->addWidget(payloadSpin_);
     cfg->addWidget(new QLabel("Tail:"));            cfg->addWidget(tailSpin_);
+    cfg->addWidget(new QLabel("Seq@:"));           cfg->addWidget(seqOffsetSpin_);
+    cfg->addWidget(seqBytesCombo_);                 cfg->addWidget(seqBeCheck_);
+    cfg->addWidget(new QLabel("Reorder:"));         cfg->addWidget(reorderSpin_);
+    cfg->addWidget(new QLabel("Layout:"));          cfg->addWidget(layoutCombo_);
+    cfg->addWidget(new QLabel("Ring:"));            cfg->addWidget(ringMbSpin_); cfg->addWidget(ringSecSpin_);
     cfg->addSpacing(12);
     cfg->addWidget(applyCfgBtn_);
+    cfg->addSpacing(12);
+    cfg->addWidget(new QLabel("Inspect:")); cfg->addWidget(inspectCombo_); cfg->addWidget(inspectRateSpin_);
+    cfg->addWidget(packetsBtn_);
     v->addLayout(cfg);
 
     // 行3：视图
@@ -133,14 +216,46 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
     grid_->setSpacing(6);
     v->addWidget(plotsContainer_, 1);
 
+    scheduler_ = new RepaintScheduler(this);
+    scheduler_->attachRing(ring_.get());
+    envAgg_ = std::make_unique<EnvelopeAggregator>();
+    envAgg_->attachRing(ring_.get());
+    envAgg_->setMetrics(metrics_.get());
+    scheduler_->attachEnvelopes(envAgg_.get());
+
+    buildStatsDock();
+
     rebuildPlots();
+    scheduler_->start();
 
     // 连接
     connect(startBtn_, &QPushButton::clicked, this, &MainWindow::onStart);
     connect(stopBtn_,  &QPushButton::clicked, this, &MainWindow::onStop);
     connect(applyCfgBtn_, &QPushButton::clicked, this, &MainWindow::onApplyParserConfig);
+    connect(inspectCombo_, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onInspectChanged);
+    connect(inspectRateSpin_, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::onInspectChanged);
+    connect(packetsBtn_, &QPushButton::clicked, this, &MainWindow::onShowPackets);
+    connect(recordBtn_, &QPushButton::toggled, this, &MainWindow::onToggleRecord);
+    connect(replayBrowseBtn_, &QPushButton::clicked, this, [this]{
+        const QString path = QFileDialog::getOpenFileName(this, "Replay file", replayEdit_->text(),
+                                                          "Captures (*.pcap *.pcapng *.udpsrec);;All files (*)");
+        if (!path.isEmpty()) replayEdit_->setText(path);
+    });
+    connect(backendCombo_, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this](int){
+        const auto backend = static_cast<CaptureBackend>(backendCombo_->currentData().toInt());
+        const bool udp    = backend == CaptureBackend::UDP_SOCKET;
+        const bool replay = backend == CaptureBackend::REPLAY_FILE;
+        bindEdit_->setEnabled(udp);
+        rxThreadsSpin_->setEnabled(backend == CaptureBackend::TPACKET_V3);
+        fanoutCombo_->setEnabled(backend == CaptureBackend::TPACKET_V3);
+        for (QWidget* w : std::initializer_list<QWidget*>{replayEdit_, replayBrowseBtn_, replaySpeedSpin_, replayLoopCheck_})
+            w->setEnabled(replay);
+        ifEdit_->setEnabled(!udp && !replay);
+        bpfEdit_->setEnabled(!udp);
+    });
 
     connect(binsSpin_, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::onRebuildPlots);
+    connect(fpsSpin_, QOverload<int>::of(&QSpinBox::valueChanged), this, [this](int fps){ scheduler_->setTargetFps(fps); });
     connect(winSpin_,  QOverload<double>::of(&QDoubleSpinBox::valueChanged), this, &MainWindow::onRebuildPlots);
     connect(colsSpin_, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::onRebuildPlots);
     connect(applyViewBtn_, &QPushButton::clicked, this, &MainWindow::onRebuildPlots);
@@ -165,18 +280,29 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
     resize(1360, 900);
 }
 
-MainWindow::~MainWindow() { onStop(); }
+MainWindow::~MainWindow() { stopRecording(); onStop(); }
 
 void MainWindow::onStart() {
     if (worker_) return;
     CaptureConfig cfg{};
     std::snprintf(cfg.ifname, sizeof(cfg.ifname), "%s", ifEdit_->text().toUtf8().constData());
     std::snprintf(cfg.bpf, sizeof(cfg.bpf), "%s", bpfEdit_->text().toUtf8().constData());
-    worker_ = new PcapWorker(*ring_, cfg, *stats_);
-    for (auto* w : plots_) {
-        connect(worker_, &PcapWorker::frameAdvanced, w, &PlotWidget::onFrameAdvanced, Qt::QueuedConnection);
+    cfg.backend = static_cast<CaptureBackend>(backendCombo_->currentData().toInt());
+    {
+        const QString bind = bindEdit_->text().trimmed();
+        const int colon = bind.lastIndexOf(':');
+        const QString host = colon < 0 ? bind : bind.left(colon);
+        std::snprintf(cfg.bind_addr, sizeof(cfg.bind_addr), "%s", host.toUtf8().constData());
+        if (colon >= 0) { bool ok=false; int port = bind.mid(colon+1).toInt(&ok); if (ok) cfg.bind_port = port; }
     }
+    std::snprintf(cfg.replay_path, sizeof(cfg.replay_path), "%s", replayEdit_->text().toUtf8().constData());
+    cfg.replay_speed = replaySpeedSpin_->value();
+    cfg.replay_loop  = replayLoopCheck_->isChecked();
+    cfg.rx_threads = rxThreadsSpin_->value();
+    cfg.fanout     = static_cast<FanoutMode>(fanoutCombo_->currentData().toInt());
+    worker_ = new PcapWorker(*ring_, cfg, *stats_, inspector_.get(), metrics_.get());
     connect(worker_, &PcapWorker::errorOccurred, this, &MainWindow::onError);
+    connect(worker_, &PcapWorker::statsUpdated, this, &MainWindow::onStatsUpdated);
     worker_->start();
     startBtn_->setEnabled(false);
     stopBtn_->setEnabled(true);
@@ -194,34 +320,190 @@ void MainWindow::onError(const QString& msg) {
     QMessageBox::critical(this, "pcap error", msg);
 }
 
+void MainWindow::onToggleRecord(bool on) {
+    if (!on) { stopRecording(); return; }
+    if (recorder_) return;
+    const QString path = QFileDialog::getSaveFileName(this, "Record to", "capture.udpsrec", "UDP Scope recording (*.udpsrec)");
+    if (path.isEmpty()) { recordBtn_->setChecked(false); return; }
+    recorder_ = new Recorder(*ring_, *stats_, path);
+    connect(recorder_, &Recorder::errorOccurred, this, [this](const QString& msg){
+        QMessageBox::critical(this, "record error", msg);
+        recordBtn_->setChecked(false);
+    });
+    recorder_->start();
+    recordBtn_->setText("Recording");
+}
+
+void MainWindow::stopRecording() {
+    if (!recorder_) return;
+    // 先摘下指针：stop() 可能同步发出 errorOccurred，回调里取消勾选会再次进入这里
+    Recorder* r = recorder_;
+    recorder_ = nullptr;
+    r->stop();
+    delete r;
+    recordBtn_->blockSignals(true);
+    recordBtn_->setChecked(false);
+    recordBtn_->blockSignals(false);
+    recordBtn_->setText("Record...");
+}
+
+void MainWindow::buildStatsDock() {
+    statsDock_ = new QDockWidget("Pipeline stats", this);
+    statsDock_->setObjectName("statsDock");
+    auto* w   = new QWidget(statsDock_);
+    auto* lay = new QVBoxLayout(w);
+    statsLabel_ = new QLabel("not capturing");
+    statsLabel_->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    lay->addWidget(statsLabel_);
+
+    const int n = static_cast<int>(PipelineStage::kCount);
+    statsTable_ = new QTableWidget(n, 6, w);
+    statsTable_->setHorizontalHeaderLabels({"count", "p50 µs", "p90 µs", "p99 µs", "p99.9 µs", "max µs"});
+    for (int i = 0; i < n; ++i) {
+        statsTable_->setVerticalHeaderItem(i, new QTableWidgetItem(pipeline_stage_name(static_cast<PipelineStage>(i))));
+        for (int c = 0; c < 6; ++c) {
+            auto* item = new QTableWidgetItem("-");
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            statsTable_->setItem(i, c, item);
+        }
+    }
+    statsTable_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    statsTable_->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    lay->addWidget(statsTable_, 1);
+
+    auto* btns = new QHBoxLayout();
+    auto* resetBtn = new QPushButton("Reset");
+    auto* dumpBtn  = new QPushButton("Dump JSON...");
+    btns->addWidget(resetBtn); btns->addWidget(dumpBtn); btns->addStretch(1);
+    lay->addLayout(btns);
+    statsDock_->setWidget(w);
+    addDockWidget(Qt::RightDockWidgetArea, statsDock_);
+
+    statsBtn_->setDefaultAction(statsDock_->toggleViewAction());
+    connect(resetBtn, &QPushButton::clicked, this, [this]{
+        metrics_->reset();
+        onStatsUpdated(lastFramesRx_, stats_->frames_drop.load(), lastBytesRx_);
+    });
+    connect(dumpBtn, &QPushButton::clicked, this, &MainWindow::onDumpStats);
+    statsClock_.start();
+}
+
+void MainWindow::onStatsUpdated(quint64 framesRx, quint64 framesDrop, quint64 bytesRx) {
+    // 速率按两次刷新之间的增量算；换环/重启抓包计数清零时按 0 处理
+    const double secs = statsClock_.restart() / 1000.0;
+    const double fps  = secs > 0 && framesRx >= lastFramesRx_ ? (framesRx - lastFramesRx_) / secs : 0.0;
+    const double mbps = secs > 0 && bytesRx  >= lastBytesRx_  ? (bytesRx  - lastBytesRx_)  / secs / 1e6 : 0.0;
+    lastFramesRx_ = framesRx;
+    lastBytesRx_  = bytesRx;
+
+    const RuntimeStats& s = *stats_;
+    statsLabel_->setText(QString("RX %1 fps · %2 MB/s · %3 frames\n"
+                                 "drop %4 (parse %5, size %6, kernel %7) · seq lost %8\n"
+                                 "parser epoch %9 · switches %10")
+                         .arg(fps, 0, 'f', 0).arg(mbps, 0, 'f', 1).arg(framesRx)
+                         .arg(framesDrop).arg(s.drop_parse.load()).arg(s.drop_size.load()).arg(s.kernel_drops.load())
+                         .arg(s.seq_lost.load()).arg(s.parser_epoch.load()).arg(s.parser_switches.load()));
+
+    const int n = static_cast<int>(PipelineStage::kCount);
+    for (int i = 0; i < n; ++i) {
+        const LatencyHistogram::Summary h = metrics_->stage[i].summary();
+        const auto us = [&](uint64_t ns) { return h.count ? QString::number(ns / 1000.0, 'f', 1) : QString("-"); };
+        statsTable_->item(i, 0)->setText(QString::number(h.count));
+        statsTable_->item(i, 1)->setText(us(h.p50_ns));
+        statsTable_->item(i, 2)->setText(us(h.p90_ns));
+        statsTable_->item(i, 3)->setText(us(h.p99_ns));
+        statsTable_->item(i, 4)->setText(us(h.p999_ns));
+        statsTable_->item(i, 5)->setText(us(h.max_ns));
+    }
+}
+
+void MainWindow::onDumpStats() {
+    const QString path = QFileDialog::getSaveFileName(this, "Dump stats", "udpscope-stats.json", "JSON (*.json)");
+    if (path.isEmpty()) return;
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        QMessageBox::critical(this, "stats dump", f.errorString());
+        return;
+    }
+    f.write(QByteArray::fromStdString(pipeline_stats_json(stats_.get(), metrics_.get())));
+}
+
+void MainWindow::onInspectChanged() {
+    inspector_->configure(static_cast<InspectMode>(inspectCombo_->currentData().toInt()), inspectRateSpin_->value());
+}
+
+void MainWindow::onShowPackets() {
+    const auto samples = inspector_->snapshot(256);
+    QString text;
+    if (samples.empty()) text = "没有采样到的包（Inspect 为 Off 或尚未收包）";
+    for (const auto& s : samples) text += QString::fromStdString(PacketInspector::format_sample(s)) + "\n";
+
+    auto* dlg = new QDialog(this);
+    dlg->setAttribute(Qt::WA_DeleteOnClose);
+    dlg->setWindowTitle(QString("Sampled packets (%1)").arg(samples.size()));
+    auto* lay = new QVBoxLayout(dlg);
+    auto* view = new QPlainTextEdit(text);
+    view->setReadOnly(true);
+    view->setLineWrapMode(QPlainTextEdit::NoWrap);
+    view->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    lay->addWidget(view);
+    dlg->resize(900, 600);
+    dlg->show();
+}
+
+ParserConfig MainWindow::parserConfigFromUi() const {
+    ParserConfig c = g_cfg;
+    c.pack              = static_cast<PackMode>(packCombo_->currentData().toInt());
+    c.bits_per_sample   = bitsSpin_->value();
+    c.samples_per_frame = samplesSpin_->value();
+    c.frame_size_bytes  = frameSizeSpin_->value();
+    c.header_bytes      = headerSpin_->value();
+    c.payload_bytes     = payloadSpin_->value();
+    c.tail_bytes        = tailSpin_->value();
+    c.seq_offset        = seqOffsetSpin_->value();
+    c.seq_bytes         = seqBytesCombo_->currentData().toInt();
+    c.seq_big_endian    = seqBeCheck_->isChecked();
+    c.reorder_window    = reorderSpin_->value();
+    return c;
+}
+
 bool MainWindow::validateParserConfig(QString& why) const {
-    const auto pack = static_cast<PackMode>(packCombo_->currentData().toInt());
-    const int bits = bitsSpin_->value();
-    const int samples = samplesSpin_->value();
-    const int frameSz = frameSizeSpin_->value();
-    const int hdr = headerSpin_->value();
-    const int pay = payloadSpin_->value();
-    const int tail = tailSpin_->value();
-
-    if (hdr + pay + tail != frameSz) { why = "HEADER + PAYLOAD + TAIL 必须等于 FRAME_SIZE_BYTES"; return false; }
-    if (bits < 1 || bits > 16) { why = "bits_per_sample 仅支持 1..16"; return false; }
-
-    if (pack == PackMode::RAW10_PACKED) {
-        if (pay % 5 != 0) { why = "RAW10: payload_bytes 必须是 5 的整数倍"; return false; }
-        int groups = pay / 5;
-        if (groups * 4 != samples) { why = "RAW10: (payload/5)*4 必须等于 samples_per_frame"; return false; }
-        if (bits != 10) { why = "RAW10: 建议 bits_per_sample = 10"; return false; }
-    } else if (pack == PackMode::RAW16_LE) {
-        if (pay < samples * 2) { why = "RAW16: payload_bytes 必须 >= samples_per_frame * 2"; return false; }
-        if (bits > 16) { why = "RAW16: bits_per_sample <= 16"; return false; }
-    } else { why = "未知 Pack 模式"; return false; }
+    std::string reason;
+    if (!validate_parser_config(parserConfigFromUi(), reason)) { why = QString::fromStdString(reason); return false; }
     return true;
 }
 
+RingOptions MainWindow::ringOptions() const {
+    RingOptions opt;
+    opt.layout = static_cast<RingLayout>(layoutCombo_->currentData().toInt());
+    return opt;
+}
+
+size_t MainWindow::ringFrames(const RingOptions& opt) const {
+    size_t frames = DecodedFrameRing::frames_for_budget(size_t(ringMbSpin_->value()) << 20, opt);
+    // 给了历史秒数时按当前实测帧率换算（仍不超过预算）；还没有数据时只能用满预算
+    const double secs = ringSecSpin_->value();
+    const double fps  = ring_ ? ring_->estimate_fps(ring_->snapshot_write_index()) : 0.0;
+    if (secs > 0 && fps > 0) frames = std::min(frames, std::max<size_t>(1, size_t(std::ceil(secs * fps))));
+    return frames;
+}
+
 void MainWindow::rebuildRingAndReconnect() {
+    stopRecording(); // 录制器读的是旧环，且文件头里的解析配置已不再成立
+    envAgg_->attachRing(nullptr); // 等后台包络计算离开旧环
+    const RingOptions opt = ringOptions();
+    const size_t frames = ringFrames(opt); // 秒数换算要用旧环的实测帧率，先于释放
     ring_.reset();
-    ring_ = std::make_unique<DecodedFrameRing>(200000);
+    ring_ = std::make_unique<DecodedFrameRing>(frames, opt);
+    ringBuiltLayout_ = layoutCombo_->currentData().toInt();
+    ringBuiltMb_     = ringMbSpin_->value();
+    ringBuiltSec_    = ringSecSpin_->value();
+    ringMbSpin_->setToolTip(QString("%1 frames, %2 MB mapped, %3-bit samples%4")
+                            .arg(ring_->capacity()).arg(ring_->memory_bytes() >> 20).arg(ring_->storage_bits())
+                            .arg(ring_->huge_pages() ? ", huge pages" : ""));
     for (auto* w : plots_) w->attachRing(ring_.get());
+    scheduler_->attachRing(ring_.get());
+    envAgg_->attachRing(ring_.get());
     const bool wasRunning = (worker_ != nullptr);
     if (wasRunning) { onStop(); onStart(); }
 }
@@ -251,16 +533,29 @@ QVector<int> MainWindow::parseChannelExpr(const QString& expr, int maxCh) const
 void MainWindow::onApplyParserConfig() {
     QString why;
     if (!validateParserConfig(why)) { QMessageBox::warning(this, "Invalid Parser Config", why); return; }
+    const ParserConfig cfg = parserConfigFromUi();
+
+    // 样本几何与环的设置都没变：不停抓包、不重建环，新配置从下一包起生效，环在切换处开新段，旧数据照常可看
+    const bool sameRing = ring_ && ring_->accepts(cfg) && ringBuiltLayout_ == layoutCombo_->currentData().toInt()
+                       && ringBuiltMb_ == ringMbSpin_->value() && ringBuiltSec_ == ringSecSpin_->value();
+    if (sameRing) {
+        if (same_parser_config(cfg, g_cfg)) return;
+        // 录制文件头里记的是旧配置：须在新计划发布前停下录制，否则录制线程会把按新配置解出的帧写进这个文件
+        const bool wasRecording = (recorder_ != nullptr);
+        stopRecording();
+        if (worker_ && !worker_->applyParserConfig(cfg)) return;
+        g_cfg = cfg;
+        if (wasRecording)
+            QMessageBox::information(this, "Recording stopped",
+                                     "The parser config changed, so the recording was closed at the switch point "
+                                     "(its header describes the old config). Press Record to start a new file.");
+        return;
+    }
+
     const bool wasRunning = (worker_ != nullptr);
     if (wasRunning) onStop();
 
-    g_cfg.pack = static_cast<PackMode>(packCombo_->currentData().toInt());
-    g_cfg.bits_per_sample   = bitsSpin_->value();
-    g_cfg.samples_per_frame = samplesSpin_->value();
-    g_cfg.frame_size_bytes  = frameSizeSpin_->value();
-    g_cfg.header_bytes      = headerSpin_->value();
-    g_cfg.payload_bytes     = payloadSpin_->value();
-    g_cfg.tail_bytes        = tailSpin_->value();
+    g_cfg = cfg;
 
     rebuildRingAndReconnect();
     onRebuildPlots();
@@ -269,11 +564,6 @@ void MainWindow::onApplyParserConfig() {
 
 void MainWindow::onRebuildPlots() {
     rebuildPlots();
-    if (worker_) {
-        for (auto* w : plots_) {
-            connect(worker_, &PcapWorker::frameAdvanced, w, &PlotWidget::onFrameAdvanced, Qt::QueuedConnection);
-        }
-    }
 }
 
 void MainWindow::rebuildPlots() {
@@ -282,7 +572,9 @@ void MainWindow::rebuildPlots() {
     plots_.clear();
 
     auto chs = parseChannelExpr(channelEdit_->text(), g_cfg.samples_per_frame);
-    if (chs.isEmpty()) { plotsContainer_->update(); return; }
+    envAgg_->setChannels(std::vector<int>(chs.begin(), chs.end()));
+    envAgg_->setView(winSpin_->value(), binsSpin_->value());
+    if (chs.isEmpty()) { scheduler_->setPlots(plots_); plotsContainer_->update(); return; }
 
     const int cols = colsSpin_->value();
     const int rows = (chs.size() + cols - 1) / cols;
@@ -325,11 +617,14 @@ void MainWindow::rebuildPlots() {
     double hpfHz = 50.0;
     if (auto* hpfSpin = central_->findChild<QDoubleSpinBox*>("hpfCutSpin"))
         hpfHz = hpfSpin->value();
+    envAgg_->setHighPassCutHz(hpfHz);
 
     for (int i = 0; i < chs.size(); ++i) {
         int r = i / cols, c = i % cols;
         auto* pw = new PlotWidget(plotsContainer_);
         pw->attachRing(ring_.get());
+        pw->attachEnvelopes(envAgg_.get());
+        pw->attachMetrics(metrics_.get());
         pw->setBins(binsSpin_->value());
         pw->setWindowSeconds(winSpin_->value());
         pw->setChannel(chs[i]);
@@ -351,4 +646,5 @@ void MainWindow::rebuildPlots() {
 
     plotsContainer_->setLayout(grid_);
     plotsContainer_->update();
+    scheduler_->setPlots(plots_);
 }
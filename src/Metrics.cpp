@@ -0,0 +1,112 @@
+#include "Metrics.hpp"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+
+uint64_t LatencyHistogram::bucket_lower(int i) {
+    if (i < kSub) return static_cast<uint64_t>(i);
+    const int e = i / kSub + kSubBits - 1;
+    return static_cast<uint64_t>(kSub + i % kSub) << (e - kSubBits);
+}
+
+uint64_t LatencyHistogram::bucket_width(int i) {
+    if (i < kSub) return 1;
+    return uint64_t(1) << (i / kSub - 1);
+}
+
+LatencyHistogram::Summary LatencyHistogram::summary() const {
+    Summary s;
+    uint64_t counts[kBuckets];
+    uint64_t total = 0;
+    for (int i = 0; i < kBuckets; ++i) { counts[i] = counts_[i].load(std::memory_order_relaxed); total += counts[i]; }
+    if (total == 0) return s;
+    s.count   = total;
+    s.mean_ns = double(sum_.load(std::memory_order_relaxed)) / double(std::max<uint64_t>(1, count_.load(std::memory_order_relaxed)));
+    s.max_ns  = max_.load(std::memory_order_relaxed);
+
+    // 分位数取所在桶的中点（不超过实测最大值）
+    const double   qs[4]   = {0.50, 0.90, 0.99, 0.999};
+    uint64_t*      outs[4] = {&s.p50_ns, &s.p90_ns, &s.p99_ns, &s.p999_ns};
+    uint64_t acc = 0;
+    int      q   = 0;
+    for (int i = 0; i < kBuckets && q < 4; ++i) {
+        acc += counts[i];
+        while (q < 4 && double(acc) >= qs[q] * double(total)) {
+            *outs[q++] = std::min(s.max_ns, bucket_lower(i) + bucket_width(i) / 2);
+        }
+    }
+    return s;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& c : counts_) c.store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+const char* pipeline_stage_name(PipelineStage s) {
+    switch (s) {
+    case PipelineStage::CAPTURE_TO_DEQUEUE: return "capture_to_dequeue";
+    case PipelineStage::UNPACK:             return "unpack";
+    case PipelineStage::RING_PUBLISH:       return "ring_publish";
+    case PipelineStage::ENVELOPE_PASS:      return "envelope_pass";
+    case PipelineStage::ENVELOPE_PLOT:      return "envelope_plot";
+    case PipelineStage::PAINT:              return "paint";
+    case PipelineStage::PACKET_TO_PIXEL:    return "packet_to_pixel";
+    default:                                return "?";
+    }
+}
+
+void PipelineMetrics::reset() {
+    for (auto& h : stage) h.reset();
+}
+
+namespace {
+
+void append(std::string& out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+void append(std::string& out, const char* fmt, ...) {
+    char buf[512];
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = std::vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n > 0) out.append(buf, static_cast<size_t>(std::min<int>(n, int(sizeof(buf)) - 1)));
+}
+
+unsigned long long u(const std::atomic<uint64_t>& v) {
+    return static_cast<unsigned long long>(v.load(std::memory_order_relaxed));
+}
+
+} // namespace
+
+std::string pipeline_stats_json(const RuntimeStats* stats, const PipelineMetrics* metrics) {
+    std::string out = "{\n";
+    if (stats) {
+        const RuntimeStats& s = *stats;
+        append(out, "  \"counters\": {\"frames_rx\": %llu, \"bytes_rx\": %llu, \"frames_drop\": %llu,\n",
+               u(s.frames_rx), u(s.bytes_rx), u(s.frames_drop));
+        append(out, "    \"drop_parse\": %llu, \"drop_size\": %llu, \"kernel_drops\": %llu, \"if_drops\": %llu,\n",
+               u(s.drop_parse), u(s.drop_size), u(s.kernel_drops), u(s.if_drops));
+        append(out, "    \"seq_lost\": %llu, \"seq_reordered\": %llu, \"seq_duplicate\": %llu, \"seq_late\": %llu, \"seq_resync\": %llu,\n",
+               u(s.seq_lost), u(s.seq_reordered), u(s.seq_duplicate), u(s.seq_late), u(s.seq_resync));
+        append(out, "    \"parser_epoch\": %llu, \"parser_switches\": %llu, \"rec_frames\": %llu, \"rec_overrun\": %llu}%s\n",
+               u(s.parser_epoch), u(s.parser_switches), u(s.rec_frames), u(s.rec_overrun), metrics ? "," : "");
+    }
+    if (metrics) {
+        out += "  \"stages_ns\": {\n";
+        const int n = static_cast<int>(PipelineStage::kCount);
+        for (int i = 0; i < n; ++i) {
+            const LatencyHistogram::Summary h = metrics->stage[i].summary();
+            append(out, "    \"%s\": {\"count\": %llu, \"mean\": %.0f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}%s\n",
+                   pipeline_stage_name(static_cast<PipelineStage>(i)), static_cast<unsigned long long>(h.count), h.mean_ns,
+                   static_cast<unsigned long long>(h.p50_ns), static_cast<unsigned long long>(h.p90_ns),
+                   static_cast<unsigned long long>(h.p99_ns), static_cast<unsigned long long>(h.p999_ns),
+                   static_cast<unsigned long long>(h.max_ns), i + 1 < n ? "," : "");
+        }
+        out += "  }\n";
+    }
+    out += "}\n";
+    return out;
+}
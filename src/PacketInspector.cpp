@@ -0,0 +1,246 @@
+#include "PacketInspector.hpp"
+
+#include <pcap/dlt.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// ---- 工具：大端读取 ----
+static inline uint16_t be16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+// ---- 解析各层长度（支持常见链路类型） ----
+bool decode_frame_layers(const uint8_t* pkt, size_t caplen, int linktype, FrameLayers& out) {
+    out = FrameLayers{};
+    out.linktype = linktype;
+    out.caplen   = caplen;
+    if (!pkt || caplen < 1) return false;
+
+    const uint8_t* l3 = nullptr; // 指向 IP 头
+
+    // ---- 解析 L2（链路层）----
+    switch (linktype) {
+    case DLT_EN10MB: { // 以太网
+        if (caplen < 14) return false;
+        out.link_len = 14;
+        out.ether_type = be16(pkt + 12);
+
+        // VLAN tag 0x8100/0x88a8：每个 tag 额外 4 字节
+        size_t off = 12;
+        while (out.ether_type == 0x8100 || out.ether_type == 0x88A8) {
+            if (caplen < out.link_len + 4) return false;
+            out.link_len += 4;
+            off += 4;
+            if (caplen < off + 2) return false;
+            out.ether_type = be16(pkt + off);
+        }
+        l3 = pkt + out.link_len;
+        break;
+    }
+    case DLT_LINUX_SLL: { // Linux cooked v1，proto 位于偏移 14-15
+        if (caplen < 16) return false;
+        out.link_len = 16;
+        out.ether_type = be16(pkt + 14);
+        l3 = pkt + out.link_len;
+        break;
+    }
+    case DLT_LINUX_SLL2: { // Linux cooked v2，proto 位于偏移 0-1
+        if (caplen < 20) return false;
+        out.link_len = 20;
+        out.ether_type = be16(pkt + 0);
+        l3 = pkt + out.link_len;
+        break;
+    }
+    case DLT_NULL: { // loopback/null：值平台相关，0x00000002=AF_INET, 0x00000018=AF_INET6（BSD风格）
+        if (caplen < 4) return false;
+        out.link_len = 4;
+        uint32_t af = 0; std::memcpy(&af, pkt, sizeof(af)); // 本地字节序
+        if (af == 2 || af == 0x02000000) out.ether_type = 0x0800;
+        else if (af == 24 || af == 0x18000000) out.ether_type = 0x86DD;
+        l3 = pkt + out.link_len;
+        break;
+    }
+    case DLT_RAW: { // 直接是 IP，按版本判断
+        out.link_len = 0;
+        l3 = pkt;
+        const uint8_t v = (l3[0] >> 4) & 0xF;
+        out.ether_type = (v == 4) ? 0x0800 : (v == 6) ? 0x86DD : 0;
+        break;
+    }
+    default:
+        return false; // 未覆盖的链路类型：只有总长
+    }
+
+    if (size_t(l3 - pkt) > caplen) return false;
+    const size_t remain = caplen - size_t(l3 - pkt);
+
+    // ---- 解析 L3（IPv4/IPv6）与 UDP ----
+    const uint8_t* l4 = nullptr;
+    if (out.ether_type == 0x0800) { // IPv4
+        if (remain < 20) return false;
+        const uint8_t ihl = (l3[0] & 0x0F) * 4;
+        if (ihl < 20 || remain < ihl) return false;
+        out.ip_version = 4;
+        out.ip_len = ihl;
+        out.proto  = l3[9];
+        std::memcpy(out.src, l3 + 12, 4);
+        std::memcpy(out.dst, l3 + 16, 4);
+        l4 = l3 + ihl;
+    } else if (out.ether_type == 0x86DD) { // IPv6：只处理“无扩展头 + 直接 UDP”
+        if (remain < 40) return false;
+        out.ip_version = 6;
+        out.ip_len = 40;
+        out.proto  = l3[6];
+        std::memcpy(out.src, l3 + 8, 16);
+        std::memcpy(out.dst, l3 + 24, 16);
+        l4 = l3 + 40;
+    } else {
+        return true; // 其他 EtherType：不深究
+    }
+
+    if (out.proto == 17 /*UDP*/) {
+        if (caplen - size_t(l4 - pkt) < 8) return false;
+        out.is_udp  = true;
+        out.udp_len = 8;
+        const uint16_t udp_len = be16(l4 + 4);
+        if (udp_len >= 8) out.udp_payload_len = udp_len - 8;
+        out.sport = be16(l4);
+        out.dport = be16(l4 + 2);
+    }
+    return true;
+}
+
+std::string format_frame_layers(const FrameLayers& l) {
+    char buf[320];
+    int n = std::snprintf(buf, sizeof(buf), "[LEN] total=%zu link=%zu ip=%zu udp=%zu udp_payload=%zu",
+                          l.caplen, l.link_len, l.ip_len,
+                          l.is_udp ? l.udp_len : size_t(0), l.is_udp ? l.udp_payload_len : size_t(0));
+    if (n < 0) return {};
+    size_t used = std::min(sizeof(buf) - 1, static_cast<size_t>(n));
+
+    auto append = [&](const char* fmt, auto... args) {
+        if (used >= sizeof(buf) - 1) return;
+        const int k = std::snprintf(buf + used, sizeof(buf) - used, fmt, args...);
+        if (k > 0) used = std::min(sizeof(buf) - 1, used + static_cast<size_t>(k));
+    };
+
+    if (l.ip_version == 4) {
+        append(" | IPv4 src=%u.%u.%u.%u dst=%u.%u.%u.%u",
+               l.src[0], l.src[1], l.src[2], l.src[3], l.dst[0], l.dst[1], l.dst[2], l.dst[3]);
+    } else if (l.ip_version == 6) {
+        // 简单十六进制展现，不做压缩：xxxx:xxxx:... 共8段
+        append(" | IPv6 src=");
+        for (int i = 0; i < 16; i += 2) append(i ? ":%04x" : "%04x", be16(l.src + i));
+        append(" dst=");
+        for (int i = 0; i < 16; i += 2) append(i ? ":%04x" : "%04x", be16(l.dst + i));
+    } else {
+        append(" etherType=0x%04x", l.ether_type);
+        return std::string(buf, used);
+    }
+
+    if (l.is_udp) append(" sport=%u dport=%u", l.sport, l.dport);
+    else          append(l.ip_version == 4 ? " proto=%u" : " next=%u", l.proto);
+    return std::string(buf, used);
+}
+
+// ------------------------ PacketInspector ------------------------
+
+PacketInspector::PacketInspector(size_t capacity)
+: capacity_(std::max<size_t>(1, capacity)), slots_(new Slot[std::max<size_t>(1, capacity)]) {}
+
+void PacketInspector::configure(InspectMode mode, int rate) {
+    rate_.store(std::max(1, rate), std::memory_order_relaxed);
+    mode_.store(static_cast<int>(mode), std::memory_order_relaxed);
+}
+
+bool PacketInspector::should_sample(InspectMode m, int64_t ts_ns) {
+    const int r = rate_.load(std::memory_order_relaxed);
+    if (m == InspectMode::ONE_IN_N) {
+        if (++n_counter_ < static_cast<uint64_t>(r)) return false;
+        n_counter_ = 0;
+        return true;
+    }
+    // PER_SECOND：每个 1 秒窗口（抓包时间）内最多 r 个；
+    // 无符号比较同时把时间戳回退（回放循环、时钟调整）当作新窗口
+    if (sec_count_ >= r) {
+        if (static_cast<uint64_t>(ts_ns - sec_start_ns_) < 1000000000ULL) return false;
+        sec_count_ = 0;
+    }
+    if (sec_count_ == 0) sec_start_ns_ = ts_ns;
+    ++sec_count_;
+    return true;
+}
+
+void PacketInspector::record(uint64_t idx, const uint8_t* pkt, size_t caplen, size_t wirelen, int linktype) {
+    const uint64_t w = written_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[w % capacity_];
+
+    // seqlock 写：奇数 → 写数据 → 偶数
+    const uint64_t s0 = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(s0 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    PacketSample& s = slot.sample;
+    s.packet_index = idx;
+    s.wirelen = static_cast<uint32_t>(wirelen);
+    if (linktype == kLinktypeUdpPayload) {
+        s.layers = FrameLayers{};
+        s.layers.linktype = linktype;
+        s.layers.caplen = caplen;
+        s.layers.udp_payload_len = caplen;
+        s.decoded = true;
+    } else {
+        s.decoded = decode_frame_layers(pkt, caplen, linktype, s.layers);
+    }
+    s.nbytes = static_cast<uint16_t>(std::min(caplen, sizeof(s.bytes)));
+    std::memcpy(s.bytes, pkt, s.nbytes);
+
+    slot.seq.store(s0 + 2, std::memory_order_release);
+    written_.store(w + 1, std::memory_order_release);
+}
+
+std::vector<PacketSample> PacketInspector::snapshot(size_t max) const {
+    std::vector<PacketSample> out;
+    const uint64_t w = written_.load(std::memory_order_acquire);
+    const uint64_t n = std::min<uint64_t>({w, capacity_, max});
+    out.reserve(static_cast<size_t>(n));
+    for (uint64_t i = w - n; i < w; ++i) {
+        const Slot& slot = slots_[i % capacity_];
+        const uint64_t s1 = slot.seq.load(std::memory_order_acquire);
+        if (s1 & 1) continue;
+        PacketSample copy = slot.sample;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != s1) continue; // 读的过程中被覆盖
+        out.push_back(copy);
+    }
+    return out;
+}
+
+std::string PacketInspector::format_sample(const PacketSample& s) {
+    char head[64];
+    std::snprintf(head, sizeof(head), "#%llu len=%u ", static_cast<unsigned long long>(s.packet_index), s.wirelen);
+    std::string line = head;
+
+    if (s.layers.linktype == kLinktypeUdpPayload) {
+        char b[64];
+        std::snprintf(b, sizeof(b), "[LEN] udp_payload=%zu (socket)", s.layers.udp_payload_len);
+        line += b;
+    } else if (s.decoded) {
+        line += format_frame_layers(s.layers);
+    } else {
+        char b[96];
+        std::snprintf(b, sizeof(b), "[LEN] total=%zu (unparsed, linktype=%d)", s.layers.caplen, s.layers.linktype);
+        line += b;
+    }
+
+    line += "\n   ";
+    static const char* kHex = "0123456789abcdef";
+    for (uint16_t i = 0; i < s.nbytes; ++i) {
+        if (i) line += (i % 16 == 0) ? "\n   " : " ";
+        line += kHex[s.bytes[i] >> 4];
+        line += kHex[s.bytes[i] & 0xF];
+    }
+    return line;
+}
@@ -1,191 +1,40 @@
 #include "PcapWorker.hpp"
-#include <QtCore/QDebug>
+#include "Recording.hpp"
 #include <QString>
 #include <QtGlobal>
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
 #include <cstring>
+#include <fstream>
 
 #include <pcap/pcap.h>
 #include <pcap/dlt.h>
 
-
-// ---- 工具：大端读取 ----
-static inline uint16_t be16(const u_char* p) {
-    return static_cast<uint16_t>((p[0] << 8) | p[1]);
-}
-static inline uint32_t be32(const u_char* p) {
-    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
-}
-
-// ---- 打印各层长度（支持常见链路类型） ----
-// 返回是否成功解析（解析失败不会中断流程，只是不打印）
-static bool print_frame_lengths(const u_char* pkt, size_t caplen, int linktype) {
-    if (!pkt || caplen < 1) return false;
-
-    size_t link_len = 0;
-    uint16_t ether_type = 0;
-    const u_char* l3 = nullptr;            // 指向 IP 头
-    const u_char* l4 = nullptr;            // 指向 UDP/TCP 头
-    size_t l3_len = 0;                     // IP 头长度
-    size_t l4_len = 0;                     // UDP/TCP 头长度
-    size_t udp_payload_len = 0;
-    bool is_udp = false;
-
-    // ---- 解析 L2（链路层）----
-    switch (linktype) {
-    case DLT_EN10MB: { // 以太网
-        if (caplen < 14) return false;
-        link_len = 14;
-        ether_type = be16(pkt + 12);
-
-        // VLAN tag 0x8100/0x88a8：每个 tag 额外 4 字节
-        size_t off = 12;
-        while (ether_type == 0x8100 || ether_type == 0x88A8) {
-            if (caplen < link_len + 4) return false;
-            link_len += 4;
-            off += 4;
-            if (caplen < off + 2) return false;
-            ether_type = be16(pkt + off);
-        }
-
-        l3 = pkt + link_len;
-        break;
-    }
-    case DLT_LINUX_SLL: { // Linux cooked v1
-        if (caplen < 16) return false;
-        link_len = 16;
-        // proto 位于偏移 14-15
-        ether_type = be16(pkt + 14);
-        l3 = pkt + link_len;
-        break;
-    }
-    case DLT_LINUX_SLL2: { // Linux cooked v2
-        if (caplen < 20) return false;
-        link_len = 20;
-        // proto 位于偏移 16-17
-        ether_type = be16(pkt + 16);
-        l3 = pkt + link_len;
-        break;
-    }
-    case DLT_NULL: { // loopback/null
-        if (caplen < 4) return false;
-        link_len = 4;
-        // 这里不是以太类型，值平台相关；简单判断：0x00000002=AF_INET, 0x00000018=AF_INET6（BSD风格）
-        uint32_t af = *(const uint32_t*)pkt; // 本地字节序；不跨平台时够用
-        if (af == 2 /*AF_INET*/ || af == 0x02000000) ether_type = 0x0800;      // IPv4
-        else if (af == 24 /*AF_INET6*/ || af == 0x18000000) ether_type = 0x86DD; // IPv6
-        l3 = pkt + link_len;
-        break;
-    }
-    case DLT_RAW: { // 直接是 IP
-        link_len = 0;
-        l3 = pkt;
-        // 判断版本
-        if (caplen >= 1) {
-            uint8_t v = (l3[0] >> 4) & 0xF;
-            ether_type = (v == 4) ? 0x0800 : (v == 6) ? 0x86DD : 0;
-        }
-        break;
-    }
-    default:
-        // 未覆盖的链路类型：只打印总长
-        qDebug() << "[LEN] total=" << caplen << "(unsupported linktype=" << linktype << ")";
-        return false;
-    }
-
-    if (!l3 || size_t(l3 - pkt) > caplen) return false;
-    size_t remain = caplen - size_t(l3 - pkt);
-
-    // ---- 解析 L3（IPv4/IPv6）----
-    if (ether_type == 0x0800) { // IPv4
-        if (remain < 20) return false;
-        uint8_t ver_ihl = l3[0];
-        uint8_t ihl = (ver_ihl & 0x0F) * 4;
-        if (ihl < 20 || remain < ihl) return false;
-        l3_len = ihl;
-
-        uint8_t proto = l3[9];
-        const u_char* src = l3 + 12;
-        const u_char* dst = l3 + 16;
-
-        if (proto == 17 /*UDP*/) {
-            is_udp = true;
-            l4 = l3 + l3_len;
-            if ((caplen - size_t(l4 - pkt)) < 8) return false;
-            l4_len = 8;
-            uint16_t udp_len = be16(l4 + 4);
-            if (udp_len >= 8) udp_payload_len = udp_len - 8;
-        } else {
-            // 非 UDP：粗略给出 L4 头 0（这里你只关心 UDP，其他略过）
-        }
-
-        qDebug() << "[LEN]"
-                 << "total=" << caplen
-                 << "link=" << link_len
-                 << "ip=" << l3_len
-                 << "udp=" << (is_udp ? l4_len : 0)
-                 << "udp_payload=" << (is_udp ? udp_payload_len : 0)
-                 << "| IPv4"
-                 << "src=" << QString("%1.%2.%3.%4").arg(src[0]).arg(src[1]).arg(src[2]).arg(src[3])
-                 << "dst=" << QString("%1.%2.%3.%4").arg(dst[0]).arg(dst[1]).arg(dst[2]).arg(dst[3])
-                 << (is_udp ? QString("sport=%1 dport=%2")
-                                .arg(be16(l4)).arg(be16(l4 + 2))
-                            : QString("proto=%1").arg(proto));
-    }
-    else if (ether_type == 0x86DD) { // IPv6
-        if (remain < 40) return false;
-        l3_len = 40; // IPv6 固定头 40
-        uint8_t next = l3[6];
-        const u_char* src = l3 + 8;
-        const u_char* dst = l3 + 24;
-
-        // 只处理“无扩展头 + 直接 UDP”的常见情形
-        if (next == 17 /*UDP*/) {
-            is_udp = true;
-            l4 = l3 + l3_len;
-            if ((caplen - size_t(l4 - pkt)) < 8) return false;
-            l4_len = 8;
-            uint16_t udp_len = be16(l4 + 4);
-            if (udp_len >= 8) udp_payload_len = udp_len - 8;
-        }
-
-        auto ipv6_to_str = [](const u_char* p) {
-            // 简单十六进制展现，不做压缩：xxxx:xxxx:... 共8段
-            QStringList parts;
-            for (int i = 0; i < 16; i += 2) parts << QString("%1").arg(be16(p + i), 4, 16, QChar('0'));
-            return parts.join(":");
-        };
-
-        qDebug() << "[LEN]"
-                 << "total=" << caplen
-                 << "link=" << link_len
-                 << "ip=" << l3_len
-                 << "udp=" << (is_udp ? l4_len : 0)
-                 << "udp_payload=" << (is_udp ? udp_payload_len : 0)
-                 << "| IPv6"
-                 << "src=" << ipv6_to_str(src)
-                 << "dst=" << ipv6_to_str(dst)
-                 << (is_udp ? QString("sport=%1 dport=%2")
-                                .arg(be16(l4)).arg(be16(l4 + 2))
-                            : QString("next=%1").arg(next));
-    }
-    else {
-        // 其他 EtherType：不深究
-        qDebug() << "[LEN] total=" << caplen
-                 << "link=" << link_len
-                 << "ip=0 udp=0 udp_payload=0"
-                 << "etherType=0x" << QString::number(ether_type, 16);
-    }
-
-    return true;
-}
-
+#include <arpa/inet.h>
+#include <cerrno>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
 
 
 // ------------------------ Ctor / Dtor ------------------------
 
-PcapWorker::PcapWorker(DecodedFrameRing& ring, const CaptureConfig& cfg, RuntimeStats& stats)
-: ring_(ring), cfg_(cfg), stats_(stats) {}
+PcapWorker::PcapWorker(DecodedFrameRing& ring, const CaptureConfig& cfg, RuntimeStats& stats,
+                       PacketInspector* inspector, PipelineMetrics* metrics)
+: ring_(ring), cfg_(cfg), stats_(stats), inspector_(inspector), metrics_(metrics) {
+    statsTimer_.setInterval(kStatsIntervalMs);
+    connect(&statsTimer_, &QTimer::timeout, this, &PcapWorker::emitStats);
+}
 
 PcapWorker::~PcapWorker() {
     stop();
@@ -195,16 +44,91 @@ PcapWorker::~PcapWorker() {
 
 void PcapWorker::start() {
     if (running_.exchange(true)) return;
-    rx_thread_ = std::thread(&PcapWorker::rx_loop, this);
+
+    // 校验与内核选择在发布时做一次，收包路径只经 ParserPlanView 取计划；热切换见 applyParserConfig
+    if (!applyParserConfig(g_cfg)) {
+        running_.store(false);
+        return;
+    }
+    ring_epoch_ = 0; // 第一帧写入时按当前计划开段
+    timeDequeue_ = cfg_.backend != CaptureBackend::REPLAY_FILE;
+    statsTimer_.start();
+    reorder_ = std::make_unique<SeqReorderBuffer>(ring_, g_cfg, stats_);
+
+    const int n = std::clamp(cfg_.rx_threads, 1, RuntimeStats::kMaxRxQueues);
+    if (cfg_.backend != CaptureBackend::TPACKET_V3 || n == 1) {
+        stats_.rx_queues.store(1, std::memory_order_relaxed);
+        rx_threads_.emplace_back(&PcapWorker::rx_loop, this);
+        return;
+    }
+
+    // 扇出：组号在本机内唯一即可
+    fanout_group_ = static_cast<int>((static_cast<uintptr_t>(::getpid()) ^ reinterpret_cast<uintptr_t>(this)) & 0xFFFF);
+    queues_.clear();
+    for (int i = 0; i < n; ++i)
+        queues_.push_back(std::make_unique<FrameQueue>(static_cast<size_t>(std::max(2, cfg_.fanout_queue_frames)),
+                                                       ring_.samples_per_frame()));
+    stats_.rx_queues.store(n, std::memory_order_relaxed);
+
+    merge_thread_ = std::thread(&PcapWorker::merge_loop, this);
+    for (int i = 0; i < n; ++i)
+        rx_threads_.emplace_back(&PcapWorker::rx_loop_tpacket, this, i);
 }
 
 void PcapWorker::stop() {
-    if (!running_.exchange(false)) return;
-    if (rx_thread_.joinable()) rx_thread_.join();
+    // 某个线程出错时会自行清掉 running_，这里仍需回收全部线程
+    const bool wasActive = statsTimer_.isActive();
+    statsTimer_.stop();
+    running_.store(false);
+    for (auto& t : rx_threads_) if (t.joinable()) t.join();
+    rx_threads_.clear();
+    if (merge_thread_.joinable()) merge_thread_.join();
+    queues_.clear();
+    reorder_.reset();
+    if (wasActive) emitStats();
+}
+
+void PcapWorker::emitStats() {
+    emit statsUpdated(stats_.frames_rx.load(std::memory_order_relaxed),
+                      stats_.frames_drop.load(std::memory_order_relaxed),
+                      stats_.bytes_rx.load(std::memory_order_relaxed));
+}
+
+bool PcapWorker::applyParserConfig(const ParserConfig& cfg) {
+    if (!ring_.accepts(cfg)) {
+        emit errorOccurred(QString("parser config needs a new ring (%1 samples/frame, ring has %2 at %3 bits)")
+                           .arg(cfg.samples_per_frame).arg(ring_.samples_per_frame()).arg(ring_.storage_bits()));
+        return false;
+    }
+    std::string why;
+    if (plans_.publish(cfg, why) == 0) {
+        emit errorOccurred(QString("invalid parser config: %1").arg(QString::fromStdString(why)));
+        return false;
+    }
+    return true;
+}
+
+void PcapWorker::switch_segment(const ParserPlan& plan) {
+    reorder_->reconfigure(plan.cfg);
+    ring_.begin_segment(plan.epoch, plan.cfg);
+    if (ring_epoch_ != 0) stats_.parser_switches++;
+    ring_epoch_ = plan.epoch;
+    stats_.parser_epoch.store(plan.epoch, std::memory_order_relaxed);
 }
 
 // ------------------------ Helpers ------------------------
 
+// 网卡侧丢包：sysfs 中的 rx_dropped + rx_missed_errors（读不到时为 0）
+static uint64_t read_if_rx_drops(const char* ifname) {
+    uint64_t total = 0;
+    for (const char* name : {"rx_dropped", "rx_missed_errors"}) {
+        std::ifstream f(std::string("/sys/class/net/") + ifname + "/statistics/" + name);
+        uint64_t v = 0;
+        if (f >> v) total += v;
+    }
+    return total;
+}
+
 bool PcapWorker::extract_udp_payload(const u_char* data, size_t caplen, int linktype,
                                      const u_char*& udp_payload, size_t& udp_payload_len) {
     const u_char* p = data; size_t len = caplen;
@@ -232,7 +156,7 @@ bool PcapWorker::extract_udp_payload(const u_char* data, size_t caplen, int link
 
     if (len < 20) return false; // IPv4 header
     const uint8_t ipver = p[0] >> 4; if (ipver != 4) return false;
-    const uint8_t ihl   = (p[0] & 0x0F) * 4; if (len < ihl + 8) return false;
+    const uint8_t ihl   = (p[0] & 0x0F) * 4; if (len < size_t(ihl) + 8) return false;
     const uint8_t proto = p[9]; if (proto != 17) return false; // UDP
 
     const u_char* udp = p + ihl;
@@ -247,6 +171,80 @@ bool PcapWorker::extract_udp_payload(const u_char* data, size_t caplen, int link
 // ------------------------ RX loop ------------------------
 
 void PcapWorker::rx_loop() {
+    switch (cfg_.backend) {
+    case CaptureBackend::TPACKET_V3: rx_loop_tpacket(-1); break;
+    case CaptureBackend::UDP_SOCKET: rx_loop_udp();     break;
+    case CaptureBackend::REPLAY_FILE: rx_loop_replay(); break;
+    case CaptureBackend::PCAP:
+    default:                         rx_loop_pcap();    break;
+    }
+}
+
+void PcapWorker::ingest_packet(const u_char* pkt, size_t caplen, size_t wirelen, int linktype, int64_t ts_ns,
+                               const RxSink& sink) {
+    stats_.bytes_rx += wirelen;
+    if (sink.qstats) sink.qstats->bytes_rx += wirelen;
+    if (inspector_ && sink.inspect) inspector_->offer(pkt, caplen, wirelen, linktype, ts_ns);
+
+    const u_char* udp_payload = nullptr; size_t udp_len = 0;
+    if (!extract_udp_payload(pkt, caplen, linktype, udp_payload, udp_len)) {
+        stats_.frames_drop++;
+        stats_.drop_parse++;
+        if (sink.qstats) sink.qstats->frames_drop++;
+        return;
+    }
+
+    ingest_udp_payload(reinterpret_cast<const uint8_t*>(udp_payload), udp_len, ts_ns, sink);
+}
+
+void PcapWorker::ingest_udp_payload(const uint8_t* udp_payload, size_t udp_len, int64_t ts_ns, const RxSink& sink) {
+    auto drop = [&] {
+        stats_.frames_drop++;
+        if (sink.qstats) sink.qstats->frames_drop++;
+    };
+
+    // epoch 未变时只是一次原子读比较；热切换后的第一包换到新计划
+    const ParserPlan& plan = sink.plan->current();
+    if (static_cast<int>(udp_len) != plan.frame_size_bytes) { stats_.drop_size++; drop(); return; }
+
+    const uint8_t* payload = udp_payload + plan.header_bytes;
+    const uint64_t seq = (plan.cfg.seq_offset >= 0) ? plan.cfg.read_seq(udp_payload) : 0;
+
+    // 每线程每 kSampleEvery 个包计一次时；未命中时只有一次计数比较
+    const bool timed = metrics_ && ++sink.tick % PipelineMetrics::kSampleEvery == 0;
+    if (timed && timeDequeue_) (*metrics_)[PipelineStage::CAPTURE_TO_DEQUEUE].record(metrics_realtime_ns() - ts_ns);
+
+    // 直接解码进环槽位（或重排暂存槽、扇出队列槽位），省去中间缓冲与一次 memcpy
+    if (sink.queue) {
+        uint16_t* dst = sink.queue->reserve_frame();
+        if (!dst) { // 扇出队列满：合并线程跟不上
+            sink.qstats->queue_full++;
+            drop();
+            return;
+        }
+        const int64_t t0 = timed ? metrics_now_ns() : 0;
+        plan.unpack(payload, dst); // 长度与格式已由计划校验，不会失败
+        if (timed) (*metrics_)[PipelineStage::UNPACK].record(metrics_now_ns() - t0);
+        sink.queue->commit_frame(ts_ns, seq, plan.epoch); // 序号跟踪与分段由合并线程完成
+        sink.qstats->frames_enq++; // frames_rx 由合并线程在写入主环时计数
+    } else {
+        if (plan.epoch != ring_epoch_) switch_segment(plan);
+        const int64_t t0 = timed ? metrics_now_ns() : 0;
+        uint16_t* dst = reorder_->begin(seq, ts_ns);
+        if (!dst) return; // 重复或过迟，已计入 seq_duplicate / seq_late
+        const int64_t t1 = timed ? metrics_now_ns() : 0;
+        plan.unpack(payload, dst);
+        const int64_t t2 = timed ? metrics_now_ns() : 0;
+        reorder_->end(true);
+        if (timed) {
+            (*metrics_)[PipelineStage::UNPACK].record(t2 - t1);
+            (*metrics_)[PipelineStage::RING_PUBLISH].record((t1 - t0) + (metrics_now_ns() - t2));
+        }
+        stats_.frames_rx++;
+    }
+}
+
+void PcapWorker::rx_loop_pcap() {
     char errbuf[PCAP_ERRBUF_SIZE] = {0};
     pcap_t* handle = pcap_create(cfg_.ifname, errbuf);
     if (!handle) {
@@ -258,6 +256,7 @@ void PcapWorker::rx_loop() {
     pcap_set_snaplen(handle, cfg_.snaplen);
     pcap_set_promisc(handle, cfg_.promisc ? 1 : 0);
     pcap_set_timeout(handle, cfg_.timeout_ms);
+    pcap_set_tstamp_precision(handle, PCAP_TSTAMP_PRECISION_NANO); // 不支持时保持微秒
 #ifdef pcap_set_immediate_mode
     pcap_set_immediate_mode(handle, 1);
 #endif
@@ -285,45 +284,546 @@ void PcapWorker::rx_loop() {
     pcap_freecode(&fp);
 
     int linktype = pcap_datalink(handle);
-    std::vector<uint16_t> samples(static_cast<size_t>(g_cfg.samples_per_frame));
+    const int64_t frac_ns = (pcap_get_tstamp_precision(handle) == PCAP_TSTAMP_PRECISION_NANO) ? 1 : 1000;
+
+    // ps_drop / ps_ifdrop 为自打开以来的累计值，大约每秒取一次
+    auto poll_stats = [&] {
+        pcap_stat ps{};
+        if (pcap_stats(handle, &ps) == 0) {
+            stats_.kernel_drops.store(ps.ps_drop, std::memory_order_relaxed);
+            stats_.if_drops.store(ps.ps_ifdrop, std::memory_order_relaxed);
+        }
+    };
+    timespec last_stats{}; ::clock_gettime(CLOCK_MONOTONIC, &last_stats);
+
+    ParserPlanView plan(plans_);
+    RxSink sink;
+    sink.plan = &plan;
 
     while (running_.load(std::memory_order_relaxed)) {
         pcap_pkthdr* hdr = nullptr; const u_char* pkt = nullptr;
         int rc = pcap_next_ex(handle, &hdr, &pkt);
+
+        timespec now{}; ::clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec != last_stats.tv_sec) { last_stats = now; poll_stats(); }
+
         if (rc == 1) {
-            stats_.bytes_rx += hdr->len;
+            const int64_t ts_ns = int64_t(hdr->ts.tv_sec) * 1000000000LL + int64_t(hdr->ts.tv_usec) * frac_ns;
+            ingest_packet(pkt, hdr->caplen, hdr->len, linktype, ts_ns, sink);
+        } else if (rc == 0) {
+            // timeout
+            continue;
+        } else {
+            // error or break
+            break;
+        }
+    }
+
+    poll_stats();
+    pcap_close(handle);
+}
 
-            const u_char* udp_payload = nullptr; size_t udp_len = 0;
-            if (!extract_udp_payload(pkt, hdr->caplen, linktype, udp_payload, udp_len)) {
-                stats_.frames_drop++; continue;
+// ------------------------ TPACKET_V3 ------------------------
+// AF_PACKET + PACKET_RX_RING(TPACKET_V3)：内核把包直接写进 mmap 的块环，
+// 用户态每次唤醒遍历整块（可能上千帧），无逐包系统调用与拷贝。
+// BPF 仍用 libpcap 编译（pcap_open_dead），再以 SO_ATTACH_FILTER 挂到套接字上。
+
+// 扇出时每个线程各自执行本函数：独立套接字、过滤器与块环，bind 后加入同一 PACKET_FANOUT 组。
+
+void PcapWorker::rx_loop_tpacket(int queue) {
+    auto fail = [this](const QString& what, int fd) {
+        emit errorOccurred(QString("%1: %2").arg(what).arg(std::strerror(errno)));
+        if (fd >= 0) ::close(fd);
+        running_.store(false);
+    };
+
+    // ifname 缓冲比内核的 IFNAMSIZ（16）长，超长的名字在这里拒绝，下面按 IFNAMSIZ 拷进 ifreq
+    const size_t ifname_len = ::strnlen(cfg_.ifname, sizeof(cfg_.ifname));
+    if (ifname_len >= IFNAMSIZ) { errno = ENAMETOOLONG; fail(QString("interface name %1").arg(cfg_.ifname), -1); return; }
+    const unsigned ifindex = if_nametoindex(cfg_.ifname);
+    if (ifindex == 0) { fail(QString("if_nametoindex(%1) failed").arg(cfg_.ifname), -1); return; }
+
+    int fd = ::socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (fd < 0) { fail("socket(AF_PACKET) failed", -1); return; }
+
+    // 链路类型：以太网与 lo 都带 14 字节以太头；tun 等无 L2 的设备直接是 IP
+    int linktype = DLT_EN10MB;
+    bool is_loopback = false;
+    {
+        ifreq ifr{};
+        std::memcpy(ifr.ifr_name, cfg_.ifname, ifname_len); // ifr{} 已清零，结尾的 NUL 随之而来
+        if (::ioctl(fd, SIOCGIFHWADDR, &ifr) < 0) { fail("SIOCGIFHWADDR failed", fd); return; }
+        switch (ifr.ifr_hwaddr.sa_family) {
+        case ARPHRD_ETHER:    linktype = DLT_EN10MB; break;
+        case ARPHRD_LOOPBACK: linktype = DLT_EN10MB; is_loopback = true; break;
+        case ARPHRD_NONE:
+        case ARPHRD_PPP:      linktype = DLT_RAW; break;
+        default:
+            errno = EPROTONOSUPPORT;
+            fail(QString("unsupported ARPHRD %1").arg(ifr.ifr_hwaddr.sa_family), fd);
+            return;
+        }
+    }
+
+    // 先挂过滤器再建环，避免建环与过滤之间混入无关包
+    {
+        pcap_t* dead = pcap_open_dead(linktype, cfg_.snaplen);
+        bpf_program fp{};
+        if (!dead || pcap_compile(dead, &fp, cfg_.bpf, 1, PCAP_NETMASK_UNKNOWN) < 0) {
+            emit errorOccurred(QString("pcap_compile failed: %1").arg(dead ? pcap_geterr(dead) : "pcap_open_dead"));
+            if (dead) pcap_close(dead);
+            ::close(fd);
+            running_.store(false);
+            return;
+        }
+        sock_fprog prog{};
+        prog.len    = static_cast<unsigned short>(fp.bf_len);
+        prog.filter = reinterpret_cast<sock_filter*>(fp.bf_insns); // bpf_insn 与 sock_filter 布局相同
+        const int rc = ::setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+        pcap_freecode(&fp);
+        pcap_close(dead);
+        if (rc < 0) { fail("SO_ATTACH_FILTER failed", fd); return; }
+    }
+
+    int ver = TPACKET_V3;
+    if (::setsockopt(fd, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver)) < 0) { fail("PACKET_VERSION(TPACKET_V3) failed", fd); return; }
+
+    // 扇出时 tp_block_count 是所有套接字的总预算，按线程数平分（每个至少 kMinFanoutBlocks 块），
+    // 否则 16 个线程各映射一整份默认环就是 4 GiB 锁定的内核内存
+    constexpr int kMinFanoutBlocks = 4;
+    const int nsock = (queue >= 0) ? static_cast<int>(queues_.size()) : 1;
+    const int blocks = std::max(std::min(cfg_.tp_block_count, kMinFanoutBlocks), cfg_.tp_block_count / nsock);
+
+    tpacket_req3 req{};
+    req.tp_block_size       = static_cast<unsigned>(cfg_.tp_block_size);
+    req.tp_block_nr         = static_cast<unsigned>(blocks);
+    req.tp_frame_size       = static_cast<unsigned>(cfg_.tp_frame_size);
+    req.tp_frame_nr         = (req.tp_block_size / req.tp_frame_size) * req.tp_block_nr;
+    req.tp_retire_blk_tov   = static_cast<unsigned>(std::max(1, cfg_.tp_retire_ms));
+    req.tp_feature_req_word = 0;
+    if (::setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) { fail("PACKET_RX_RING failed", fd); return; }
+
+    const size_t map_len = static_cast<size_t>(req.tp_block_size) * req.tp_block_nr;
+    auto* map = static_cast<uint8_t*>(::mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    if (map == MAP_FAILED) { fail("mmap(PACKET_RX_RING) failed", fd); return; }
+
+    sockaddr_ll sll{};
+    sll.sll_family   = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex  = static_cast<int>(ifindex);
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&sll), sizeof(sll)) < 0) {
+        ::munmap(map, map_len);
+        fail("bind(AF_PACKET) failed", fd);
+        return;
+    }
+
+    if (cfg_.promisc) {
+        packet_mreq mr{};
+        mr.mr_ifindex = static_cast<int>(ifindex);
+        mr.mr_type    = PACKET_MR_PROMISC;
+        (void)::setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mr, sizeof(mr)); // 失败不致命
+    }
+
+    ParserPlanView plan(plans_);
+    RxSink sink;
+    sink.plan = &plan;
+    if (queue >= 0) {
+        int type = PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG; // 分片重组后再按流哈希
+        if (cfg_.fanout == FanoutMode::CPU) type = PACKET_FANOUT_CPU;
+        else if (cfg_.fanout == FanoutMode::LB) type = PACKET_FANOUT_LB;
+        const int arg = (fanout_group_ & 0xFFFF) | (type << 16);
+        if (::setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) < 0) {
+            ::munmap(map, map_len);
+            fail(QString("PACKET_FANOUT(group %1) failed").arg(fanout_group_), fd);
+            return;
+        }
+        sink.queue   = queues_[static_cast<size_t>(queue)].get();
+        sink.qstats  = &stats_.queues[queue];
+        sink.inspect = (queue == 0);
+    }
+
+    // PACKET_STATISTICS 读取后内核清零，因此累加；扇出时各线程各加各的。
+    // 网卡侧丢包由 0 号（或唯一）线程按 sysfs 增量更新
+    const bool report_if = (queue <= 0);
+    const uint64_t if_base = report_if ? read_if_rx_drops(cfg_.ifname) : 0;
+    auto poll_stats = [&] {
+        tpacket_stats_v3 st{};
+        socklen_t len = sizeof(st);
+        if (::getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) == 0)
+            stats_.kernel_drops += st.tp_drops;
+        if (report_if) {
+            const uint64_t v = read_if_rx_drops(cfg_.ifname);
+            stats_.if_drops.store(v > if_base ? v - if_base : 0, std::memory_order_relaxed);
+        }
+    };
+
+    unsigned cur = 0;
+    timespec last_stats{}; ::clock_gettime(CLOCK_MONOTONIC, &last_stats);
+
+    while (running_.load(std::memory_order_relaxed)) {
+        auto* bd = reinterpret_cast<tpacket_block_desc*>(map + static_cast<size_t>(cur) * req.tp_block_size);
+        auto& status = bd->hdr.bh1.block_status;
+
+        timespec now{}; ::clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec != last_stats.tv_sec) { last_stats = now; poll_stats(); }
+
+        if ((__atomic_load_n(&status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0) {
+            pollfd pfd{fd, POLLIN | POLLERR, 0};
+            const int rc = ::poll(&pfd, 1, std::max(1, cfg_.timeout_ms));
+            if (rc < 0 && errno != EINTR) { emit errorOccurred(QString("poll failed: %1").arg(std::strerror(errno))); break; }
+            continue;
+        }
+
+        // 遍历整块
+        const uint32_t npkts = bd->hdr.bh1.num_pkts;
+        auto* ph = reinterpret_cast<const tpacket3_hdr*>(reinterpret_cast<const uint8_t*>(bd) + bd->hdr.bh1.offset_to_first_pkt);
+        for (uint32_t i = 0; i < npkts; ++i) {
+            // lo 上每个包会以 OUTGOING 与 HOST 各出现一次，与 libpcap 一致地丢弃出方向
+            const auto* sll_pkt = reinterpret_cast<const sockaddr_ll*>(reinterpret_cast<const uint8_t*>(ph) + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+            if (!(is_loopback && sll_pkt->sll_pkttype == PACKET_OUTGOING)) {
+                const u_char* pkt = reinterpret_cast<const u_char*>(ph) + ph->tp_mac;
+                const int64_t ts_ns = int64_t(ph->tp_sec) * 1000000000LL + int64_t(ph->tp_nsec);
+                ingest_packet(pkt, ph->tp_snaplen, ph->tp_len, linktype, ts_ns, sink);
             }
+            ph = reinterpret_cast<const tpacket3_hdr*>(reinterpret_cast<const uint8_t*>(ph) + ph->tp_next_offset);
+        }
 
-            (void)print_frame_lengths(pkt, hdr->caplen, linktype);
+        // 归还给内核
+        __atomic_store_n(&status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        cur = (cur + 1) % req.tp_block_nr;
+    }
 
+    poll_stats();
+    ::munmap(map, map_len);
+    ::close(fd);
+}
+
+// ------------------------ Fan-out merge ------------------------
+// 各扇出队列内部按时间有序，合并线程每次取所有队首中时间戳最小的一帧写入主环（k 路归并）。
+// 只有全部队列非空时才能确定最小者；有队列为空时，队首帧需等待 holdback 后再发布，
+// 以免空队列随后到来的更早帧被排到后面。主环因此保持单写者。
+
+void PcapWorker::merge_loop() {
+    const int64_t holdback_ns = int64_t(std::max(0, cfg_.fanout_holdback_us)) * 1000;
+    const size_t  nq = queues_.size();
+    ParserPlanView plan(plans_);
+    uint32_t tick = 0;
 
-            if (static_cast<int>(udp_len) != g_cfg.frame_size_bytes) {
-                stats_.frames_drop++; continue;
+    while (running_.load(std::memory_order_relaxed)) {
+        int best = -1; int64_t best_ts = 0; uint64_t best_seq = 0, best_epoch = 0; const uint16_t* best_frame = nullptr;
+        bool any_empty = false;
+        for (size_t i = 0; i < nq; ++i) {
+            int64_t ts = 0; uint64_t seq = 0, epoch = 0;
+            const uint16_t* f = queues_[i]->front(ts, seq, epoch);
+            if (!f) { any_empty = true; continue; }
+            if (best < 0 || ts < best_ts) {
+                best = static_cast<int>(i); best_ts = ts; best_seq = seq; best_epoch = epoch; best_frame = f;
             }
+        }
 
-            const uint8_t* frame = reinterpret_cast<const uint8_t*>(udp_payload);
-            const uint8_t* payload = frame + g_cfg.header_bytes;
+        if (best < 0) { std::this_thread::sleep_for(std::chrono::microseconds(50)); continue; }
 
-            if (!unpack_payload(payload, samples.data())) {
-                stats_.frames_drop++; continue;
+        if (any_empty && holdback_ns > 0) {
+            timespec now{}; ::clock_gettime(CLOCK_REALTIME, &now);
+            const int64_t now_ns = int64_t(now.tv_sec) * 1000000000LL + now.tv_nsec;
+            if (now_ns - best_ts < holdback_ns) { std::this_thread::sleep_for(std::chrono::microseconds(50)); continue; }
+        }
+
+        // 各线程换计划的时刻略有先后：段只向前切，切换点附近别的队列里仍按旧计划解出的帧归入新段
+        if (best_epoch > ring_epoch_) switch_segment(plan.current());
+        const bool timed = metrics_ && ++tick % PipelineMetrics::kSampleEvery == 0;
+        const int64_t t0 = timed ? metrics_now_ns() : 0;
+        if (uint16_t* dst = reorder_->begin(best_seq, best_ts)) {
+            std::memcpy(dst, best_frame, static_cast<size_t>(ring_.samples_per_frame()) * sizeof(uint16_t));
+            reorder_->end(true);
+            stats_.frames_rx++; // 与单线程路径一致：重复/过迟被丢的帧不计
+        }
+        if (timed) (*metrics_)[PipelineStage::RING_PUBLISH].record(metrics_now_ns() - t0);
+        queues_[static_cast<size_t>(best)]->pop();
+    }
+}
+
+// ------------------------ Offline replay ------------------------
+// .pcap/.pcapng 经 pcap_open_offline 读出后走与实时抓包完全相同的 ingest_packet 路径；
+// .udpsrec 录制文件里已是解码后的帧，直接按原时间戳写入主环。
+// 控速时第一帧对齐开始时刻，其后按 (ts - ts0) / speed 等待；不控速时尽快推送，
+// 结束时 replay_wall_ns 即整条流水线处理这些包的墙钟时间。
+
+namespace {
+
+class ReplayPacer {
+public:
+    explicit ReplayPacer(double speed) : speed_(speed) {}
+
+    // 等到 ts_ns 对应的墙钟时刻；等待中 running 被清掉时返回 false
+    bool wait(int64_t ts_ns, const std::atomic<bool>& running) {
+        if (speed_ <= 0.0) return true;
+        const auto now = std::chrono::steady_clock::now();
+        if (!started_) { started_ = true; ts0_ = ts_ns; t0_ = now; return true; }
+        const auto target = t0_ + std::chrono::nanoseconds(static_cast<int64_t>(double(ts_ns - ts0_) / speed_));
+        for (auto t = now; t < target; t = std::chrono::steady_clock::now()) {
+            if (!running.load(std::memory_order_relaxed)) return false;
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(target - t, std::chrono::milliseconds(50)));
+        }
+        return true;
+    }
+
+private:
+    double  speed_;
+    bool    started_ = false;
+    int64_t ts0_     = 0;
+    std::chrono::steady_clock::time_point t0_;
+};
+
+} // namespace
+
+void PcapWorker::rx_loop_replay() {
+    stats_.replay_packets.store(0, std::memory_order_relaxed);
+    stats_.replay_wall_ns.store(0, std::memory_order_relaxed);
+    stats_.replay_done.store(false, std::memory_order_relaxed);
+
+    // 按文件头魔数区分录制文件与 pcap/pcapng
+    char magic[sizeof(kRecMagic)] = {};
+    if (FILE* f = std::fopen(cfg_.replay_path, "rb")) {
+        const size_t n = std::fread(magic, 1, sizeof(magic), f);
+        std::fclose(f);
+        if (n != sizeof(magic)) std::memset(magic, 0, sizeof(magic));
+    } else {
+        emit errorOccurred(QString("cannot open %1: %2").arg(cfg_.replay_path).arg(std::strerror(errno)));
+        running_.store(false);
+        return;
+    }
+
+    const auto t0 = std::chrono::steady_clock::now();
+    if (std::memcmp(magic, kRecMagic, sizeof(kRecMagic)) == 0) replay_recording();
+    else                                                      replay_pcap();
+    stats_.replay_wall_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    std::chrono::steady_clock::now() - t0).count(), std::memory_order_relaxed);
+    stats_.replay_done.store(true, std::memory_order_release);
+    running_.store(false);
+}
+
+void PcapWorker::replay_pcap() {
+    ReplayPacer pacer(cfg_.replay_speed);
+    int64_t offset_ns = 0; // 循环回放时的时间戳顺延量
+    int64_t last_out_ns = 0;
+
+    while (running_.load(std::memory_order_relaxed)) {
+        char errbuf[PCAP_ERRBUF_SIZE] = {0};
+        pcap_t* handle = pcap_open_offline_with_tstamp_precision(cfg_.replay_path, PCAP_TSTAMP_PRECISION_NANO, errbuf);
+        if (!handle) {
+            emit errorOccurred(QString("pcap_open_offline failed: %1").arg(errbuf));
+            return;
+        }
+        if (cfg_.bpf[0]) {
+            bpf_program fp{};
+            if (pcap_compile(handle, &fp, cfg_.bpf, 1, PCAP_NETMASK_UNKNOWN) < 0 || pcap_setfilter(handle, &fp) < 0) {
+                emit errorOccurred(QString("pcap filter failed: %1").arg(pcap_geterr(handle)));
+                pcap_freecode(&fp);
+                pcap_close(handle);
+                return;
             }
+            pcap_freecode(&fp);
+        }
 
-            ring_.push_frame(samples.data());
-            stats_.frames_rx++;
-            emit frameAdvanced(static_cast<quint64>(ring_.snapshot_write_index()));
-        } else if (rc == 0) {
-            // timeout
-            continue;
-        } else {
-            // error or break
-            break;
+        const int linktype = pcap_datalink(handle);
+        const int64_t frac_ns = (pcap_get_tstamp_precision(handle) == PCAP_TSTAMP_PRECISION_NANO) ? 1 : 1000;
+        bool first = true;
+        ParserPlanView plan(plans_);
+        RxSink sink;
+        sink.plan = &plan;
+
+        while (running_.load(std::memory_order_relaxed)) {
+            pcap_pkthdr* hdr = nullptr; const u_char* pkt = nullptr;
+            const int rc = pcap_next_ex(handle, &hdr, &pkt);
+            if (rc != 1) {
+                if (rc != PCAP_ERROR_BREAK)
+                    emit errorOccurred(QString("pcap_next_ex failed: %1").arg(pcap_geterr(handle)));
+                break;
+            }
+            const int64_t ts_ns = int64_t(hdr->ts.tv_sec) * 1000000000LL + int64_t(hdr->ts.tv_usec) * frac_ns;
+            if (first) {
+                first = false;
+                if (last_out_ns != 0) offset_ns = last_out_ns + 1 - ts_ns; // 紧接上一轮
+            }
+            last_out_ns = ts_ns + offset_ns;
+            if (!pacer.wait(last_out_ns, running_)) break;
+            ingest_packet(pkt, hdr->caplen, hdr->len, linktype, last_out_ns, sink);
+            stats_.replay_packets++;
         }
+        pcap_close(handle);
+
+        if (!cfg_.replay_loop || first) break; // 空文件不循环
     }
+}
 
-    pcap_close(handle);
+void PcapWorker::replay_recording() {
+    RecordingReader rd;
+    std::string why;
+    if (!rd.open(cfg_.replay_path, why)) {
+        emit errorOccurred(QString::fromStdString(why));
+        return;
+    }
+    // 帧已按录制时的配置解码：环须能原样存下（样本数一致，Packed 下位宽也一致，否则会被截位），
+    // 并把该配置作为当前计划发布、按它开段，段标签与 parser_epoch 描述的是文件而不是 g_cfg
+    const ParserConfig rcfg = rd.parser_config();
+    if (!ring_.accepts(rcfg)) {
+        emit errorOccurred(QString("recording has %1 samples/frame at %2 bits but the ring has %3 at %4 bits; apply the recording's config first")
+                           .arg(rcfg.samples_per_frame).arg(rcfg.bits_per_sample)
+                           .arg(ring_.samples_per_frame()).arg(ring_.storage_bits()));
+        return;
+    }
+    if (!applyParserConfig(rcfg)) return;
+    {
+        ParserPlanView plan(plans_);
+        switch_segment(plan.current());
+    }
+    const int spf = static_cast<int>(rd.header().samples_per_frame); // 块布局按它算；open 已校验与 rcfg 一致
+
+    ReplayPacer pacer(cfg_.replay_speed);
+    int64_t offset_ns = 0;
+    int64_t last_out_ns = 0;
+
+    while (running_.load(std::memory_order_relaxed) && rd.chunk_count() > 0) {
+        if (last_out_ns != 0) offset_ns = last_out_ns + 1 - rd.chunk_entry(0).t_first_ns;
+        for (size_t k = 0; k < rd.chunk_count() && running_.load(std::memory_order_relaxed); ++k) {
+            const RecIndexEntry& e = rd.chunk_entry(k);
+            const int64_t*  ts = rd.chunk_timestamps(k);
+            const uint16_t* d  = rd.chunk_samples(k);
+            for (uint32_t i = 0; i < e.frames; ++i) {
+                last_out_ns = ts[i] + offset_ns;
+                if (!pacer.wait(last_out_ns, running_)) return;
+                ring_.push_frame(d + size_t(i) * size_t(spf), last_out_ns);
+                stats_.frames_rx++;
+                stats_.replay_packets++;
+            }
+        }
+        if (!cfg_.replay_loop) break;
+    }
 }
 
+// ------------------------ UDP socket (recvmmsg) ------------------------
+// 本机即目的地址时无需抓包：内核已完成 L2/L3/UDP 解析与校验，
+// 这里只按批取数据报，直接进入长度校验 → 解包 → 入环。
+
+void PcapWorker::rx_loop_udp() {
+    auto fail = [this](const QString& what, int fd) {
+        emit errorOccurred(QString("%1: %2").arg(what).arg(std::strerror(errno)));
+        if (fd >= 0) ::close(fd);
+        running_.store(false);
+    };
+
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) { fail("socket(AF_INET, SOCK_DGRAM) failed", -1); return; }
+
+    const int one = 1;
+    (void)::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    // 先尝试不受 rmem_max 限制的 FORCE 版本（需 CAP_NET_ADMIN），失败再退回普通版本
+    if (::setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &cfg_.rcvbuf_bytes, sizeof(cfg_.rcvbuf_bytes)) < 0)
+        (void)::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &cfg_.rcvbuf_bytes, sizeof(cfg_.rcvbuf_bytes));
+    if (::setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) < 0) { fail("SO_RXQ_OVFL failed", fd); return; }
+    const bool kernel_ts = ::setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) == 0; // 内核接收时间戳
+
+    // 超时用于周期性检查 running_
+    timeval tv{};
+    tv.tv_sec  = cfg_.timeout_ms / 1000;
+    tv.tv_usec = (cfg_.timeout_ms % 1000) * 1000;
+    if (tv.tv_sec == 0 && tv.tv_usec == 0) tv.tv_usec = 1000;
+    (void)::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(static_cast<uint16_t>(cfg_.bind_port));
+    if (::inet_pton(AF_INET, cfg_.bind_addr, &addr.sin_addr) != 1) {
+        errno = EINVAL;
+        fail(QString("invalid bind address %1").arg(cfg_.bind_addr), fd);
+        return;
+    }
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        fail(QString("bind(%1:%2) failed").arg(cfg_.bind_addr).arg(cfg_.bind_port), fd);
+        return;
+    }
+
+    ParserPlanView plan(plans_);
+    RxSink sink;
+    sink.plan = &plan;
+
+    // 批缓冲：每个数据报多留 1 字节，超长报文会被 MSG_TRUNC 标出；热切换到更长的帧时扩容
+    const int    batch   = std::max(1, cfg_.udp_batch);
+    size_t       dgram_cap = 0;
+    constexpr size_t kCtrlLen = CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(timespec));
+
+    std::vector<uint8_t>  bufs;
+    std::vector<uint8_t>  ctrls(static_cast<size_t>(batch) * kCtrlLen);
+    std::vector<iovec>    iovs(static_cast<size_t>(batch));
+    std::vector<mmsghdr>  msgs(static_cast<size_t>(batch));
+
+    while (running_.load(std::memory_order_relaxed)) {
+        const size_t need = static_cast<size_t>(std::max(plan.current().frame_size_bytes, cfg_.snaplen)) + 1;
+        if (need > dgram_cap) {
+            dgram_cap = need;
+            bufs.assign(static_cast<size_t>(batch) * dgram_cap, 0);
+            for (int i = 0; i < batch; ++i) {
+                iovs[i].iov_base = bufs.data() + static_cast<size_t>(i) * dgram_cap;
+                iovs[i].iov_len  = dgram_cap;
+            }
+        }
+        for (int i = 0; i < batch; ++i) {
+            msghdr& mh = msgs[i].msg_hdr;
+            mh = msghdr{};
+            mh.msg_iov        = &iovs[i];
+            mh.msg_iovlen     = 1;
+            mh.msg_control    = ctrls.data() + static_cast<size_t>(i) * kCtrlLen;
+            mh.msg_controllen = kCtrlLen;
+        }
+
+        const int n = ::recvmmsg(fd, msgs.data(), static_cast<unsigned>(batch), MSG_WAITFORONE, nullptr);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+            emit errorOccurred(QString("recvmmsg failed: %1").arg(std::strerror(errno)));
+            break;
+        }
+        if (n == 0) continue;
+
+        stats_.udp_batches++;
+        stats_.udp_batch_last.store(static_cast<uint64_t>(n), std::memory_order_relaxed);
+        if (static_cast<uint64_t>(n) > stats_.udp_batch_max.load(std::memory_order_relaxed))
+            stats_.udp_batch_max.store(static_cast<uint64_t>(n), std::memory_order_relaxed);
+
+        // 没有内核时间戳时整批共用一次取时
+        int64_t batch_ts_ns = 0;
+        if (!kernel_ts) {
+            timespec now{}; ::clock_gettime(CLOCK_REALTIME, &now);
+            batch_ts_ns = int64_t(now.tv_sec) * 1000000000LL + now.tv_nsec;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            const msghdr& mh = msgs[i].msg_hdr;
+            const size_t len = msgs[i].msg_len;
+            stats_.bytes_rx += len;
+
+            int64_t ts_ns = batch_ts_ns;
+            for (cmsghdr* c = CMSG_FIRSTHDR(&mh); c; c = CMSG_NXTHDR(const_cast<msghdr*>(&mh), c)) {
+                if (c->cmsg_level != SOL_SOCKET) continue;
+                if (c->cmsg_type == SO_RXQ_OVFL) {
+                    uint32_t drops = 0;
+                    std::memcpy(&drops, CMSG_DATA(c), sizeof(drops));
+                    stats_.sock_drops.store(drops, std::memory_order_relaxed);
+                    stats_.kernel_drops.store(drops, std::memory_order_relaxed);
+                } else if (c->cmsg_type == SCM_TIMESTAMPNS) {
+                    timespec ts{};
+                    std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+                    ts_ns = int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+                }
+            }
+
+            const auto* dgram = static_cast<const uint8_t*>(iovs[i].iov_base);
+            if (inspector_) inspector_->offer(dgram, std::min(len, dgram_cap), len, kLinktypeUdpPayload, ts_ns);
+
+            if (mh.msg_flags & MSG_TRUNC) { stats_.frames_drop++; stats_.drop_size++; continue; }
+            ingest_udp_payload(dgram, len, ts_ns, sink);
+        }
+    }
+
+    ::close(fd);
+}
@@ -2,9 +2,12 @@
 // 没有 DecodedFrameRing.hpp？这里临时从 MainWindow.hpp 把它“带进来”。
 // 若你项目里 DecodedFrameRing 的声明在别的头，请把这行改成那个头。
 #include "MainWindow.hpp"
+#include "EnvelopeAggregator.hpp"
+#include "Metrics.hpp"
 
 #include <QPainter>
 #include <QPainterPath>
+#include <QSurfaceFormat>
 #include <QMouseEvent>
 #include <QFontMetrics>
 #include <cmath>
@@ -27,63 +30,103 @@ EnvelopeQT PlotWidget::buildEnvelope() const {
         return env;
     }
 
-    const quint64 widx = ring_->snapshot_write_index();
-    const quint64 framesAvail   = std::min<quint64>(widx, ring_->capacity());
-    const quint64 windowFrames  = (quint64)std::llround(std::max(1.0, windowSec_ * 20000.0)); // 估算 20k fps
-    const quint64 span          = std::min(framesAvail, std::max<quint64>(1, windowFrames));
-    const quint64 startAbs      = widx > span ? (widx - span) : 0;
-    const double  framesPerBin  = (double)span / std::max(1, bins_);
-
-    for (int b=0;b<bins_;++b) {
-        quint64 f0 = startAbs + (quint64)std::floor(b * framesPerBin);
-        quint64 f1 = startAbs + (quint64)std::floor((b+1) * framesPerBin);
-        if (f1 <= f0) f1 = f0 + 1;
-
-        double vmin = 1e300, vmax = -1e300, sum = 0.0;
-        int cnt = 0;
-        for (quint64 f=f0; f<f1; ++f) {
-            double v = (double)ring_->get_sample(f, ch_);
-            vmin = std::min(vmin, v);
-            vmax = std::max(vmax, v);
-            sum += v; ++cnt;
-        }
-        env.ymin[b] = (cnt? vmin : 0.0);
-        env.ymax[b] = (cnt? vmax : 0.0);
-        env.mean[b] = (cnt? sum/std::max(1,cnt) : 0.0);
+    // 优先用后台算好的共享快照（RepaintScheduler 每个周期换入最新完成的一份），GUI 线程只做拷贝
+    EnvelopeSlice sl;
+    if (envAgg_ && envAgg_->slice(ch_, windowSec_, bins_, hpfCutHz_, sl)) {
+        env.x    = QVector<double>(sl.x,    sl.x    + sl.bins);
+        env.ymin = QVector<double>(sl.ymin, sl.ymin + sl.bins);
+        env.ymax = QVector<double>(sl.ymax, sl.ymax + sl.bins);
+        env.mean = QVector<double>(sl.mean, sl.mean + sl.bins);
+        if (sl.hpf) env.hpf = QVector<double>(sl.hpf, sl.hpf + sl.bins);
+        env.widx = sl.widx;
+        return env;
+    }
 
-        env.x[b] = -windowSec_ + (b + 0.5) * (windowSec_ / std::max(1, bins_));
+    // 自己维护一份单通道滑动包络：bin 固定在帧号上，每次只累加上次之后的新帧
+    if (!slide_) {
+        slide_    = std::make_unique<SlidingEnvelope>();
+        slideOut_ = std::make_unique<MultiEnvelope>();
     }
+    const quint64 widx = ring_->snapshot_write_index();
+    slide_->update(*ring_, widx, {ch_}, windowSec_, bins_, *slideOut_);
+    const MultiEnvelope& e = *slideOut_;
+    if (e.channels.empty()) return env; // 通道超出本帧样本数：保持全 0
+    env.x    = QVector<double>(e.x.begin(),    e.x.end());
+    env.ymin = QVector<double>(e.ymin.begin(), e.ymin.end());
+    env.ymax = QVector<double>(e.ymax.begin(), e.ymax.end());
+    env.mean = QVector<double>(e.mean.begin(), e.mean.end());
+    env.widx = widx;
     return env;
 }
 
+void PlotWidget::attachRing(DecodedFrameRing* ring) {
+    ring_ = ring;
+    if (slide_) slide_->reset(); // 新环的帧号与旧环无关
+}
+
 // --------- 一阶 RC 高通（对 mean 的副本） ---------
 void PlotWidget::highPassRC(QVector<double>& y, double dt, double fc_hz) {
-    if (y.isEmpty() || fc_hz <= 0.0) return;
-    const double tau   = 1.0 / (2.0 * M_PI * fc_hz);
-    const double alpha = tau / (tau + dt);
-    double prevY = 0.0;
-    for (int i=0;i<y.size();++i) {
-        const double x = y[i];
-        const double hp = alpha * (prevY + x - (i>0 ? y[i-1] : x));
-        prevY = x;
-        y[i] = hp;
-    }
+    high_pass_rc(y.data(), static_cast<size_t>(y.size()), dt, fc_hz);
 }
 
+// --------- 曲线着色器：数据坐标经 xform 线性映射到 NDC，纯色输出 ---------
+// 不写 #version、只用 attribute/gl_FragColor：桌面 GL 2.x 兼容上下文、GLES2 与 Mesa llvmpipe 都能编译
+static const char* kCurveVS =
+    "attribute highp vec2 pos;\n"
+    "uniform highp vec4 xform;\n" // (sx, ox, sy, oy)
+    "void main() {\n"
+    "    gl_Position = vec4(pos.x * xform.x + xform.y, pos.y * xform.z + xform.w, 0.0, 1.0);\n"
+    "}\n";
+static const char* kCurveFS =
+    "uniform lowp vec4 color;\n"
+    "void main() { gl_FragColor = color; }\n";
+
 PlotWidget::PlotWidget(QWidget* parent) : QOpenGLWidget(parent) {
     setMinimumHeight(120);
     setAutoFillBackground(false);
+    // 曲线不再经 QPainter 抗锯齿，改用多重采样
+    QSurfaceFormat fmt = format();
+    fmt.setSamples(4);
+    setFormat(fmt);
+}
+
+PlotWidget::~PlotWidget() {
+    if (!program_) return;
+    makeCurrent();
+    vbo_.destroy();
+    vao_.destroy();
+    program_.reset();
+    doneCurrent();
 }
 
 void PlotWidget::initializeGL() {
     initializeOpenGLFunctions();
+    if (!initCurveProgram()) {
+        qWarning("PlotWidget: curve shader unavailable, falling back to QPainterPath");
+        program_.reset();
+    }
 }
 
-void PlotWidget::onFrameAdvanced(quint64) {
-    update();
+bool PlotWidget::initCurveProgram() {
+    program_ = std::make_unique<QOpenGLShaderProgram>();
+    if (!program_->addShaderFromSourceCode(QOpenGLShader::Vertex, kCurveVS))   return false;
+    if (!program_->addShaderFromSourceCode(QOpenGLShader::Fragment, kCurveFS)) return false;
+    program_->bindAttributeLocation("pos", 0);
+    if (!program_->link()) return false;
+    locPos_   = program_->attributeLocation("pos");
+    locXform_ = program_->uniformLocation("xform");
+    locColor_ = program_->uniformLocation("color");
+
+    vao_.create(); // 兼容上下文下可能不支持，此时 Binder 什么都不做
+    if (!vbo_.create()) return false;
+    vbo_.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    return true;
 }
 
 void PlotWidget::paintGL() {
+    const int64_t paintT0 = metrics_ ? metrics_now_ns() : 0;
+    paintedWidx_ = ring_ ? ring_->snapshot_write_index() : 0;
+
     QPainter p(this);
     p.setRenderHint(QPainter::Antialiasing, true);
 
@@ -102,29 +145,64 @@ void PlotWidget::paintGL() {
     if (plotR.width() <= 1 || plotR.height() <= 1) { drawLegend(p); return; }
 
     // 数据
+    const int64_t envT0 = metrics_ ? metrics_now_ns() : 0;
     const auto env = buildEnvelope();
+    if (metrics_) (*metrics_)[PipelineStage::ENVELOPE_PLOT].record(metrics_now_ns() - envT0);
     if (env.x.isEmpty()) { drawLegend(p); return; }
+    paintedWidx_ = env.widx;
 
-    // X/Y 映射
-    const auto X = [&](double t) {
-        const double a = plotR.left();
-        const double b = plotR.right();
-        return a + (t + windowSec_) / windowSec_ * (b - a);
-    };
-    double ymin = yMin_, ymax = yMax_;
+    Curves c;
+    c.env  = &env;
+    c.ymin = yMin_;
+    c.ymax = yMax_;
     if (autoY_) {
-        ymin =  1e300; ymax = -1e300;
+        double ymin =  1e300, ymax = -1e300;
         for (int i=0;i<env.ymin.size();++i) {
             ymin = std::min(ymin, env.ymin[i]);
             ymax = std::max(ymax, env.ymax[i]);
         }
         if (ymax <= ymin) { ymin = 0; ymax = 1; }
         const double pad = (ymax - ymin) * 0.05;
-        ymin -= pad; ymax += pad;
+        c.ymin = ymin - pad; c.ymax = ymax + pad;
+    }
+    if (c.ymax <= c.ymin) c.ymax = c.ymin + 1;
+
+    // Raw 原始数据曲线：每个像素列 M4（首/min/max/尾），任意窗口长度都不超过 4 点/像素且不漏毛刺
+    if (showRaw_ && ring_) {
+        const quint64 widx2 = ring_->snapshot_write_index();
+        const int cols = std::max(1, (int)std::floor(plotR.width() * devicePixelRatioF()));
+        const size_t n = decimate_m4(*ring_, widx2, ch_, windowSec_, cols, rawX_, rawY_);
+        c.raw.reserve(int(n));
+        for (size_t i = 0; i < n; ++i) c.raw.push_back(QPointF(rawX_[i], rawY_[i]));
+    }
+
+    // HPF(mean)
+    if (showHPF_ && !env.hpf.isEmpty()) {
+        c.hpf = env.hpf;
+    } else if (showHPF_) {
+        c.hpf = env.mean; // 副本
+        const double dt_bin = env.x.size() > 1 ? std::max(1e-9, (env.x.back() - env.x.front()) / (env.x.size() - 1))
+                                               : windowSec_ / std::max(1, bins_);
+        highPassRC(c.hpf, dt_bin, hpfCutHz_);
+    }
+
+    if (gpuCurvesActive()) drawCurvesGL(p, plotR, c);
+    else                   drawCurvesPainter(p, plotR, c);
+
+    // 解析配置热切换的分段点：窗口内每个新段的起点画一条虚线，标上该段的打包格式
+    if (ring_ && paintedWidx_ > 0) {
+        const auto segs = ring_->segments(paintedWidx_);
+        const int64_t tEnd = ring_->timestamp_ns(paintedWidx_ - 1);
+        p.setPen(QPen(QColor(200,200,200,160), 1, Qt::DashLine));
+        for (size_t i = 1; i < segs.size(); ++i) {
+            if (segs[i].first >= paintedWidx_) continue; // 刚开、还没有帧
+            const double t = double(ring_->timestamp_ns(segs[i].first) - tEnd) * 1e-9;
+            if (t < -windowSec_) continue;
+            const double x = plotR.left() + (t + windowSec_) / windowSec_ * plotR.width();
+            p.drawLine(QPointF(x, plotR.top()), QPointF(x, plotR.bottom()));
+            p.drawText(QPointF(x + 3, plotR.top() + 10), QString(pack_mode_name(segs[i].cfg.pack)));
+        }
     }
-    const auto Y = [&](double v) {
-        return plotR.bottom() - (v - ymin) / (ymax - ymin) * plotR.height();
-    };
 
     // 坐标轴
     p.setPen(QPen(QColor(160,160,160), 1));
@@ -133,30 +211,132 @@ void PlotWidget::paintGL() {
 
     // y 轴上下端刻度文字
     p.setPen(QPen(QColor(180,180,180)));
-    p.drawText(QRectF(plotR.left()-38, plotR.top()-2, 36, 14), Qt::AlignRight|Qt::AlignVCenter, QString::number(ymax, 'f', 0));
-    p.drawText(QRectF(plotR.left()-38, plotR.bottom()-12, 36, 14), Qt::AlignRight|Qt::AlignVCenter, QString::number(ymin, 'f', 0));
+    p.drawText(QRectF(plotR.left()-38, plotR.top()-2, 36, 14), Qt::AlignRight|Qt::AlignVCenter, QString::number(c.ymax, 'f', 0));
+    p.drawText(QRectF(plotR.left()-38, plotR.bottom()-12, 36, 14), Qt::AlignRight|Qt::AlignVCenter, QString::number(c.ymin, 'f', 0));
 
-    // Raw 原始数据曲线（按帧直接取该通道的样本）
-    if (showRaw_ && ring_) {
-        // 估算帧率与窗口帧数（与 buildEnvelope 保持一致）
-        const quint64 widx2 = ring_->snapshot_write_index();
-        const quint64 framesAvail2   = std::min<quint64>(widx2, ring_->capacity());
-        const quint64 windowFrames2  = (quint64)std::llround(std::max(1.0, windowSec_ * 20000.0)); // 假设 20k fps
-        const quint64 span2          = std::min(framesAvail2, std::max<quint64>(1, windowFrames2));
-        const quint64 startAbs2      = widx2 > span2 ? (widx2 - span2) : 0;
+    // 通道标题（附实测帧率）
+    const double fps = ring_ ? ring_->estimate_fps(paintedWidx_) : 0.0;
+    p.setPen(QPen(QColor(200,200,200)));
+    p.drawText(QRectF(plotR.left(), rect().top()+2, plotR.width(), 14),
+               Qt::AlignLeft|Qt::AlignVCenter,
+               fps > 0 ? QString("Ch %1  ·  %2 fps").arg(ch_).arg(fps, 0, 'f', 0) : QString("Ch %1").arg(ch_));
 
-        const int wpx = std::max(1, (int)std::floor(plotR.width()));
-        const quint64 stride = std::max<quint64>(1, span2 / std::max(1, wpx)); // 降采样：每像素取1点
-        QPainterPath rpath;
-        bool hasStart=false;
-        for (quint64 f = startAbs2; f < startAbs2 + span2; f += stride) {
-            double t = -windowSec_ + ((double)(f - startAbs2) + 0.5) / (double)span2 * windowSec_;
-            double v = (double)ring_->get_sample(f, ch_);
-            double xx = X(t);
-            double yy = Y(v);
-            if (!hasStart) { rpath.moveTo(xx, yy); hasStart=true; }
-            else           { rpath.lineTo(xx, yy); }
+    drawLegend(p);
+
+    // 合成与上屏在 paintGL 之后，这里量到的是提交绘制为止
+    if (metrics_) {
+        (*metrics_)[PipelineStage::PAINT].record(metrics_now_ns() - paintT0);
+        if (ring_ && paintedWidx_ > 0)
+            (*metrics_)[PipelineStage::PACKET_TO_PIXEL].record(metrics_realtime_ns() - ring_->timestamp_ns(paintedWidx_ - 1));
+    }
+}
+
+// --------- GPU 曲线：顶点为数据坐标，换 Y 范围/窗口只改 uniform，CPU 侧不做任何细分 ---------
+void PlotWidget::drawCurvesGL(QPainter& p, const QRectF& plotR, const Curves& c) {
+    const EnvelopeQT& env = *c.env;
+    const int nb = env.x.size();
+
+    // 顶点布局（每点 2 个 float）：[ymax0, ymin0, ymax1, ymin1, ...] [mean] [hpf] [raw]
+    const int envOff  = 0;
+    const int meanOff = envOff + (showEnvelope_ ? 2 * nb : 0);
+    const int hpfOff  = meanOff + (showMean_ ? nb : 0);
+    const int rawOff  = hpfOff + c.hpf.size();
+    const int total   = rawOff + c.raw.size();
+    if (total == 0) return;
+
+    verts_.resize(size_t(total) * 2);
+    float* v = verts_.data();
+    if (showEnvelope_) {
+        for (int i=0;i<nb;++i) {
+            float* q = v + size_t(envOff + 2*i) * 2;
+            q[0] = float(env.x[i]); q[1] = float(env.ymax[i]);
+            q[2] = float(env.x[i]); q[3] = float(env.ymin[i]);
+        }
+    }
+    if (showMean_)
+        for (int i=0;i<nb;++i) { v[size_t(meanOff+i)*2] = float(env.x[i]); v[size_t(meanOff+i)*2+1] = float(env.mean[i]); }
+    for (int i=0;i<c.hpf.size();++i) { v[size_t(hpfOff+i)*2] = float(env.x[i]); v[size_t(hpfOff+i)*2+1] = float(c.hpf[i]); }
+    for (int i=0;i<c.raw.size();++i) { v[size_t(rawOff+i)*2] = float(c.raw[i].x()); v[size_t(rawOff+i)*2+1] = float(c.raw[i].y()); }
+
+    p.beginNativePainting();
+
+    // 视口与裁剪都设成绘图区（设备像素，GL 原点在左下）
+    const qreal dpr = devicePixelRatioF();
+    const GLint  vx = GLint(std::lround(plotR.left() * dpr));
+    const GLint  vy = GLint(std::lround((height() - plotR.bottom()) * dpr));
+    const GLsizei vw = GLsizei(std::lround(plotR.width() * dpr));
+    const GLsizei vh = GLsizei(std::lround(plotR.height() * dpr));
+    glViewport(vx, vy, vw, vh);
+    glScissor(vx, vy, vw, vh);
+    glEnable(GL_SCISSOR_TEST);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    QOpenGLVertexArrayObject::Binder vaoBinder(&vao_);
+    program_->bind();
+    vbo_.bind();
+    const int bytes = total * 2 * int(sizeof(float));
+    if (vbo_.size() < bytes) vbo_.allocate(bytes + bytes / 2); // 留余量，避免点数小幅变化时反复重分配
+    vbo_.write(0, verts_.data(), bytes);
+
+    // x ∈ [-window, 0] → [-1, 1]；y ∈ [ymin, ymax] → [-1, 1]
+    const float sx = float(2.0 / windowSec_);
+    const float sy = float(2.0 / (c.ymax - c.ymin));
+    program_->setUniformValue(locXform_, sx, 1.0f, sy, float(-1.0 - c.ymin * 2.0 / (c.ymax - c.ymin)));
+    program_->enableAttributeArray(locPos_);
+
+    const auto draw = [&](GLenum mode, int firstVertex, int count, int strideVerts, const QColor& col, float lineW) {
+        if (count < 2) return;
+        program_->setAttributeBuffer(locPos_, GL_FLOAT, firstVertex * 2 * int(sizeof(float)), 2,
+                                     strideVerts * 2 * int(sizeof(float)));
+        program_->setUniformValue(locColor_, col);
+        if (mode == GL_LINE_STRIP) glLineWidth(std::max(1.0f, lineW * float(dpr)));
+        glDrawArrays(mode, 0, count);
+    };
+
+    if (showRaw_) draw(GL_LINE_STRIP, rawOff, c.raw.size(), 1, rawColor_, 1.2f);
+    if (showEnvelope_) {
+        QColor fill = envColor_; fill.setAlpha(envAlpha_);
+        draw(GL_TRIANGLE_STRIP, envOff, 2 * nb, 1, fill, 1.0f);
+        if (drawOutline_) {
+            const QColor edge = envColor_.darker(110);
+            draw(GL_LINE_STRIP, envOff,     nb, 2, edge, 1.0f); // 上沿：偶数顶点
+            draw(GL_LINE_STRIP, envOff + 1, nb, 2, edge, 1.0f); // 下沿：奇数顶点
         }
+    }
+    if (showMean_) draw(GL_LINE_STRIP, meanOff, nb, 1, meanColor_, 1.8f);
+    if (showHPF_)  draw(GL_LINE_STRIP, hpfOff, c.hpf.size(), 1, hpfColor_, 1.8f);
+
+    program_->disableAttributeArray(locPos_);
+    vbo_.release();
+    program_->release();
+    glLineWidth(1.0f);
+    glDisable(GL_SCISSOR_TEST);
+
+    p.endNativePainting();
+}
+
+// --------- QPainterPath 退路：着色器不可用（或 setGpuCurves(false)）时使用 ---------
+void PlotWidget::drawCurvesPainter(QPainter& p, const QRectF& plotR, const Curves& c) {
+    const EnvelopeQT& env = *c.env;
+
+    // X/Y 映射
+    const auto X = [&](double t) {
+        const double a = plotR.left();
+        const double b = plotR.right();
+        return a + (t + windowSec_) / windowSec_ * (b - a);
+    };
+    const auto Y = [&](double v) {
+        return plotR.bottom() - (v - c.ymin) / (c.ymax - c.ymin) * plotR.height();
+    };
+
+    p.save();
+    p.setClipRect(plotR);
+
+    if (showRaw_ && !c.raw.isEmpty()) {
+        QPainterPath rpath;
+        rpath.moveTo(X(c.raw.front().x()), Y(c.raw.front().y()));
+        for (int i=1;i<c.raw.size();++i) rpath.lineTo(X(c.raw[i].x()), Y(c.raw[i].y()));
         p.setPen(QPen(rawColor_, 1.2));
         p.drawPath(rpath);
     }
@@ -192,24 +372,15 @@ void PlotWidget::paintGL() {
     }
 
     // HPF(mean)（橙色）
-    if (showHPF_) {
-        QVector<double> yhp = env.mean; // 副本
-        const double dt_bin = windowSec_ / std::max(1, bins_);
-        highPassRC(yhp, dt_bin, hpfCutHz_);
+    if (showHPF_ && !c.hpf.isEmpty()) {
         QPainterPath h;
-        h.moveTo(X(env.x.front()), Y(yhp.front()));
-        for (int i=1;i<env.x.size();++i) h.lineTo(X(env.x[i]), Y(yhp[i]));
+        h.moveTo(X(env.x.front()), Y(c.hpf.front()));
+        for (int i=1;i<env.x.size();++i) h.lineTo(X(env.x[i]), Y(c.hpf[i]));
         p.setPen(QPen(hpfColor_, 1.8));
         p.drawPath(h);
     }
 
-    // 通道标题
-    p.setPen(QPen(QColor(200,200,200)));
-    p.drawText(QRectF(plotR.left(), rect().top()+2, plotR.width(), 14),
-               Qt::AlignLeft|Qt::AlignVCenter,
-               QString("Ch %1").arg(ch_));
-
-    drawLegend(p);
+    p.restore();
 }
 
 void PlotWidget::drawLegend(QPainter& p) {
@@ -0,0 +1,83 @@
+#include "Recorder.hpp"
+
+#include <chrono>
+#include <vector>
+
+Recorder::Recorder(DecodedFrameRing& ring, RuntimeStats& stats, const QString& path, const RecordingOptions& opt)
+: ring_(ring), stats_(stats), path_(path.toStdString()), opt_(opt) {}
+
+Recorder::~Recorder() {
+    stop();
+}
+
+void Recorder::start() {
+    if (running_.exchange(true)) return;
+    std::string why;
+    if (!writer_.open(path_, g_cfg, opt_, why)) {
+        running_.store(false);
+        emit errorOccurred(QString::fromStdString(why));
+        return;
+    }
+    stats_.rec_frames.store(0, std::memory_order_relaxed);
+    stats_.rec_bytes.store(0, std::memory_order_relaxed);
+    stats_.rec_overrun.store(0, std::memory_order_relaxed);
+    start_index_ = ring_.snapshot_write_index(); // 从按下录制的时刻起
+    thread_ = std::thread(&Recorder::loop, this);
+}
+
+void Recorder::stop() {
+    running_.store(false);
+    if (thread_.joinable()) thread_.join();
+    if (writer_.is_open() && !writer_.close())
+        emit errorOccurred(QString::fromStdString(writer_.why()));
+    stats_.rec_backlog.store(0, std::memory_order_relaxed);
+}
+
+// 读帧与写盘同在本线程：一个块写盘期间积压会上升，环本身就是缓冲。
+// 读槽位时写线程可能正在覆盖它，因此读完一批后再检查一次写指针，被追上的帧整批作废。
+void Recorder::loop() {
+    const size_t   cap    = ring_.capacity();
+    const uint64_t margin = cap / 8;   // 积压超过 cap - margin 时直接跳到较新的位置
+    const int      spf    = ring_.samples_per_frame();
+    constexpr uint64_t kBatch = 256;
+
+    std::vector<uint16_t> frames(static_cast<size_t>(kBatch) * static_cast<size_t>(spf));
+    std::vector<int64_t>  ts(kBatch);
+
+    uint64_t next = start_index_;
+
+    while (running_.load(std::memory_order_relaxed)) {
+        const uint64_t w = ring_.snapshot_write_index();
+        stats_.rec_backlog.store(w - next, std::memory_order_relaxed);
+
+        if (w - next > cap - margin) {
+            const uint64_t skip_to = w - cap / 2;
+            stats_.rec_overrun += skip_to - next;
+            next = skip_to;
+        }
+        if (w == next) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); continue; }
+
+        const uint64_t n = std::min<uint64_t>(w - next, kBatch);
+        for (uint64_t i = 0; i < n; ++i) {
+            ring_.read_frame(next + i, &frames[static_cast<size_t>(i) * static_cast<size_t>(spf)]);
+            ts[i] = ring_.timestamp_ns(next + i);
+        }
+        // 写线程正在写的帧若与本批任何一帧同槽，则本批可能已被撕裂
+        if (ring_.snapshot_write_index() >= next + cap) {
+            stats_.rec_overrun += n;
+            next += n;
+            continue;
+        }
+
+        for (uint64_t i = 0; i < n; ++i) {
+            if (!writer_.append(&frames[static_cast<size_t>(i) * static_cast<size_t>(spf)], ts[i])) {
+                running_.store(false);
+                emit errorOccurred(QString::fromStdString(writer_.why()));
+                return;
+            }
+        }
+        next += n;
+        stats_.rec_frames.store(writer_.frames(), std::memory_order_relaxed);
+        stats_.rec_bytes.store(writer_.bytes_written(), std::memory_order_relaxed);
+    }
+}
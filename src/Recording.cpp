@@ -0,0 +1,324 @@
+#include "Recording.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static inline uint64_t align_up(uint64_t v, uint64_t a) { return (v + a - 1) / a * a; }
+
+RecChunkLayout rec_chunk_layout(uint32_t frames_per_chunk, uint32_t samples_per_frame, bool with_minmax) {
+    RecChunkLayout l{};
+    uint64_t off = sizeof(RecChunkHeader);
+    l.ts_offset   = static_cast<uint32_t>(off);
+    off = align_up(off + uint64_t(frames_per_chunk) * sizeof(int64_t), 64);
+    l.data_offset = static_cast<uint32_t>(off);
+    off = align_up(off + uint64_t(frames_per_chunk) * samples_per_frame * sizeof(uint16_t), 64);
+    if (with_minmax) {
+        l.minmax_offset = static_cast<uint32_t>(off);
+        off += uint64_t(samples_per_frame) * 2 * sizeof(uint16_t);
+    }
+    l.chunk_bytes = align_up(off, kRecAlign);
+    return l;
+}
+
+RecParserConfig rec_pack_parser_config(const ParserConfig& c) {
+    RecParserConfig r{};
+    r.frame_size_bytes  = c.frame_size_bytes;
+    r.header_bytes      = c.header_bytes;
+    r.payload_bytes     = c.payload_bytes;
+    r.tail_bytes        = c.tail_bytes;
+    r.bits_per_sample   = c.bits_per_sample;
+    r.samples_per_frame = c.samples_per_frame;
+    r.pack              = static_cast<int32_t>(c.pack);
+    r.seq_offset        = c.seq_offset;
+    r.seq_bytes         = c.seq_bytes;
+    r.seq_big_endian    = c.seq_big_endian ? 1 : 0;
+    r.reorder_window    = c.reorder_window;
+    return r;
+}
+
+ParserConfig rec_unpack_parser_config(const RecParserConfig& r) {
+    ParserConfig c;
+    c.frame_size_bytes  = r.frame_size_bytes;
+    c.header_bytes      = r.header_bytes;
+    c.payload_bytes     = r.payload_bytes;
+    c.tail_bytes        = r.tail_bytes;
+    c.bits_per_sample   = r.bits_per_sample;
+    c.samples_per_frame = r.samples_per_frame;
+    c.pack              = static_cast<PackMode>(r.pack);
+    c.seq_offset        = r.seq_offset;
+    c.seq_bytes         = r.seq_bytes;
+    c.seq_big_endian    = r.seq_big_endian != 0;
+    c.reorder_window    = r.reorder_window;
+    return c;
+}
+
+// ------------------------ RecordingWriter ------------------------
+
+RecordingWriter::~RecordingWriter() {
+    close();
+}
+
+bool RecordingWriter::open(const std::string& path, const ParserConfig& cfg, const RecordingOptions& opt, std::string& why) {
+    close();
+    spf_    = static_cast<uint32_t>(cfg.samples_per_frame);
+    fpc_    = std::max<uint32_t>(1, opt.frames_per_chunk);
+    minmax_ = opt.with_minmax;
+    layout_ = rec_chunk_layout(fpc_, spf_, minmax_);
+
+    // O_DIRECT 要求缓冲、偏移、长度都按块对齐；tmpfs 等不支持时退回普通写
+    direct_ = false;
+    if (opt.direct_io) {
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT | O_CLOEXEC, 0644);
+        direct_ = fd_ >= 0;
+    }
+    if (fd_ < 0) fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) { why = "打开录制文件失败: " + path + ": " + std::strerror(errno); return false; }
+
+    void* h = nullptr; void* c = nullptr;
+    if (::posix_memalign(&h, kRecAlign, kRecAlign) != 0 ||
+        ::posix_memalign(&c, kRecAlign, static_cast<size_t>(layout_.chunk_bytes)) != 0) {
+        std::free(h);
+        ::close(fd_); fd_ = -1;
+        why = "录制缓冲分配失败";
+        return false;
+    }
+    hdr_buf_   = static_cast<uint8_t*>(h);
+    chunk_buf_ = static_cast<uint8_t*>(c);
+    std::memset(hdr_buf_, 0, kRecAlign);
+    std::memset(chunk_buf_, 0, static_cast<size_t>(layout_.chunk_bytes));
+
+    auto* fh = reinterpret_cast<RecFileHeader*>(hdr_buf_);
+    std::memcpy(fh->magic, kRecMagic, sizeof(kRecMagic));
+    fh->version           = kRecVersion;
+    fh->header_bytes      = static_cast<uint32_t>(kRecAlign);
+    fh->samples_per_frame = spf_;
+    fh->frames_per_chunk  = fpc_;
+    fh->chunk_bytes       = layout_.chunk_bytes;
+    fh->flags             = minmax_ ? kRecFlagMinMax : 0;
+    fh->parser            = rec_pack_parser_config(cfg);
+
+    fill_ = 0; frames_ = 0; bytes_ = 0; next_off_ = kRecAlign;
+    index_.clear();
+    why_.clear();
+
+    // 先写一个未收尾的文件头（index_offset = 0），异常退出时仍可逐块恢复
+    if (!write_all(hdr_buf_, kRecAlign, 0)) { why = why_; return false; }
+    return true;
+}
+
+bool RecordingWriter::write_all(const void* buf, size_t len, uint64_t off) {
+    const auto* p = static_cast<const uint8_t*>(buf);
+    while (len > 0) {
+        const ssize_t n = ::pwrite(fd_, p, len, static_cast<off_t>(off));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            why_ = std::string("写录制文件失败: ") + std::strerror(errno);
+            return false;
+        }
+        p += n; off += static_cast<uint64_t>(n); len -= static_cast<size_t>(n);
+        bytes_ += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+bool RecordingWriter::append(const uint16_t* samples, int64_t ts_ns) {
+    if (fd_ < 0) return false;
+
+    auto* ts  = reinterpret_cast<int64_t*>(chunk_buf_ + layout_.ts_offset);
+    auto* row = reinterpret_cast<uint16_t*>(chunk_buf_ + layout_.data_offset) + size_t(fill_) * spf_;
+    ts[fill_] = ts_ns;
+    std::memcpy(row, samples, size_t(spf_) * sizeof(uint16_t));
+
+    if (minmax_) {
+        auto* mn = reinterpret_cast<uint16_t*>(chunk_buf_ + layout_.minmax_offset);
+        auto* mx = mn + spf_;
+        if (fill_ == 0) {
+            std::memcpy(mn, samples, size_t(spf_) * sizeof(uint16_t));
+            std::memcpy(mx, samples, size_t(spf_) * sizeof(uint16_t));
+        } else {
+            for (uint32_t c = 0; c < spf_; ++c) {
+                mn[c] = std::min(mn[c], samples[c]);
+                mx[c] = std::max(mx[c], samples[c]);
+            }
+        }
+    }
+
+    if (frames_ == 0) reinterpret_cast<RecFileHeader*>(hdr_buf_)->start_ts_ns = ts_ns;
+    ++frames_;
+    if (++fill_ == fpc_) return flush_chunk();
+    return true;
+}
+
+bool RecordingWriter::flush_chunk() {
+    if (fill_ == 0) return true;
+
+    const auto* ts = reinterpret_cast<const int64_t*>(chunk_buf_ + layout_.ts_offset);
+    auto* ch = reinterpret_cast<RecChunkHeader*>(chunk_buf_);
+    *ch = RecChunkHeader{};
+    ch->magic         = kRecChunkMagic;
+    ch->frames        = fill_;
+    ch->first_frame   = frames_ - fill_;
+    ch->t_first_ns    = ts[0];
+    ch->t_last_ns     = ts[fill_ - 1];
+    ch->ts_offset     = layout_.ts_offset;
+    ch->data_offset   = layout_.data_offset;
+    ch->minmax_offset = minmax_ ? layout_.minmax_offset : 0;
+
+    if (!write_all(chunk_buf_, static_cast<size_t>(layout_.chunk_bytes), next_off_)) return false;
+
+    RecIndexEntry e{};
+    e.offset      = next_off_;
+    e.first_frame = ch->first_frame;
+    e.t_first_ns  = ch->t_first_ns;
+    e.t_last_ns   = ch->t_last_ns;
+    e.frames      = fill_;
+    index_.push_back(e);
+
+    next_off_ += layout_.chunk_bytes;
+    fill_ = 0;
+    return true;
+}
+
+bool RecordingWriter::close() {
+    if (fd_ < 0) return true;
+
+    bool ok = flush_chunk();
+
+    // 索引补齐到 kRecAlign 后写在最后一个块之后
+    if (ok) {
+        const size_t idx_bytes = static_cast<size_t>(align_up(index_.size() * sizeof(RecIndexEntry), kRecAlign));
+        if (idx_bytes > 0) {
+            void* ib = nullptr;
+            if (::posix_memalign(&ib, kRecAlign, idx_bytes) != 0) { why_ = "索引缓冲分配失败"; ok = false; }
+            else {
+                std::memset(ib, 0, idx_bytes);
+                std::memcpy(ib, index_.data(), index_.size() * sizeof(RecIndexEntry));
+                ok = write_all(ib, idx_bytes, next_off_);
+                std::free(ib);
+            }
+        }
+        if (ok) {
+            auto* fh = reinterpret_cast<RecFileHeader*>(hdr_buf_);
+            fh->frame_count  = frames_;
+            fh->chunk_count  = index_.size();
+            fh->index_offset = idx_bytes > 0 ? next_off_ : 0;
+            ok = write_all(hdr_buf_, kRecAlign, 0);
+        }
+    }
+
+    ::close(fd_);
+    fd_ = -1;
+    std::free(hdr_buf_);   hdr_buf_ = nullptr;
+    std::free(chunk_buf_); chunk_buf_ = nullptr;
+    return ok;
+}
+
+// ------------------------ RecordingReader ------------------------
+
+RecordingReader::~RecordingReader() {
+    close();
+}
+
+void RecordingReader::close() {
+    if (base_) ::munmap(const_cast<uint8_t*>(base_), size_);
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1; base_ = nullptr; size_ = 0; hdr_ = nullptr; frames_ = 0;
+    index_.clear();
+}
+
+bool RecordingReader::open(const std::string& path, std::string& why) {
+    close();
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) { why = "打开录制文件失败: " + path + ": " + std::strerror(errno); return false; }
+
+    struct stat st{};
+    if (::fstat(fd_, &st) < 0 || static_cast<size_t>(st.st_size) < kRecAlign) {
+        why = "不是录制文件（长度不足）: " + path; close(); return false;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* m = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (m == MAP_FAILED) { base_ = nullptr; why = std::string("mmap 失败: ") + std::strerror(errno); close(); return false; }
+    base_ = static_cast<const uint8_t*>(m);
+    hdr_  = reinterpret_cast<const RecFileHeader*>(base_);
+
+    if (std::memcmp(hdr_->magic, kRecMagic, sizeof(kRecMagic)) != 0 || hdr_->version != kRecVersion) {
+        why = "不是录制文件或版本不支持: " + path; close(); return false;
+    }
+    // 块布局（及下面的越界检查）按文件头的 samples_per_frame 推出，读者按它作帧跨度；
+    // 内嵌的解析配置须与之一致且自洽，否则按它解释块数据会读出块外
+    if (hdr_->parser.samples_per_frame < 0 ||
+        static_cast<uint32_t>(hdr_->parser.samples_per_frame) != hdr_->samples_per_frame) {
+        why = "录制文件头损坏（解析配置的每帧样本数与文件头不符）"; close(); return false;
+    }
+    if (!validate_parser_config(parser_config(), why)) {
+        why = "录制文件头里的解析配置无效: " + why; close(); return false;
+    }
+    const RecChunkLayout l = rec_chunk_layout(hdr_->frames_per_chunk, hdr_->samples_per_frame, hdr_->flags & kRecFlagMinMax);
+    if (l.chunk_bytes != hdr_->chunk_bytes) { why = "录制文件头损坏（块大小不符）"; close(); return false; }
+
+    // 索引与块头都来自文件，截断或损坏时不能信：块须整块落在映射内、帧数不超过块容量、
+    // 块头里的段偏移与文件头推出的布局一致（读帧直接按这些偏移解引用）
+    auto chunk_ok = [&](uint64_t off, uint32_t frames) {
+        if (off < kRecAlign || off > size_ || hdr_->chunk_bytes > size_ - off) return false;
+        if (frames > hdr_->frames_per_chunk) return false;
+        const auto* ch = reinterpret_cast<const RecChunkHeader*>(base_ + off);
+        return ch->magic == kRecChunkMagic && ch->ts_offset == l.ts_offset && ch->data_offset == l.data_offset &&
+               ch->minmax_offset == l.minmax_offset;
+    };
+
+    // 索引须整个落在文件内（按条数比较，不做会溢出的乘法），且每一项都通过检查；
+    // 否则与未正常收尾的文件一样按块头重建（截断的文件仍能读出完整的块）
+    const uint64_t idx_off = hdr_->index_offset, idx_n = hdr_->chunk_count;
+    if (idx_off >= kRecAlign && idx_off <= size_ && idx_n <= (size_ - idx_off) / sizeof(RecIndexEntry)) {
+        const auto* idx = reinterpret_cast<const RecIndexEntry*>(base_ + idx_off);
+        index_.assign(idx, idx + idx_n);
+        for (const RecIndexEntry& e : index_) {
+            if (!chunk_ok(e.offset, e.frames)) { index_.clear(); break; }
+        }
+    }
+    if (index_.empty()) {
+        for (uint64_t off = kRecAlign; off + hdr_->chunk_bytes <= size_; off += hdr_->chunk_bytes) {
+            const auto* ch = reinterpret_cast<const RecChunkHeader*>(base_ + off);
+            if (ch->frames == 0 || !chunk_ok(off, ch->frames)) break;
+            RecIndexEntry e{};
+            e.offset = off; e.first_frame = ch->first_frame;
+            e.t_first_ns = ch->t_first_ns; e.t_last_ns = ch->t_last_ns; e.frames = ch->frames;
+            index_.push_back(e);
+        }
+    }
+    frames_ = index_.empty() ? 0 : index_.back().first_frame + index_.back().frames;
+    return true;
+}
+
+const int64_t* RecordingReader::chunk_timestamps(size_t k) const {
+    return reinterpret_cast<const int64_t*>(chunk_base(k) + chunk_header(k).ts_offset);
+}
+
+const uint16_t* RecordingReader::chunk_samples(size_t k) const {
+    return reinterpret_cast<const uint16_t*>(chunk_base(k) + chunk_header(k).data_offset);
+}
+
+const uint16_t* RecordingReader::chunk_min(size_t k) const {
+    const uint32_t off = chunk_header(k).minmax_offset;
+    return off ? reinterpret_cast<const uint16_t*>(chunk_base(k) + off) : nullptr;
+}
+
+const uint16_t* RecordingReader::chunk_max(size_t k) const {
+    const uint16_t* mn = chunk_min(k);
+    return mn ? mn + hdr_->samples_per_frame : nullptr;
+}
+
+uint64_t RecordingReader::lower_bound_time(int64_t t_ns) const {
+    // 先按块的末帧时间二分，再在块内二分
+    auto it = std::lower_bound(index_.begin(), index_.end(), t_ns,
+                               [](const RecIndexEntry& e, int64_t t) { return e.t_last_ns < t; });
+    if (it == index_.end()) return frames_;
+    const size_t k = static_cast<size_t>(it - index_.begin());
+    const int64_t* ts = chunk_timestamps(k);
+    return it->first_frame + static_cast<uint64_t>(std::lower_bound(ts, ts + it->frames, t_ns) - ts);
+}
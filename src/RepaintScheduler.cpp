@@ -0,0 +1,58 @@
+#include "RepaintScheduler.hpp"
+#include "PlotWidget.hpp"
+#include "Core.hpp"
+#include "EnvelopeAggregator.hpp"
+
+#include <QGuiApplication>
+#include <QScreen>
+#include <algorithm>
+#include <cmath>
+
+RepaintScheduler::RepaintScheduler(QObject* parent) : QObject(parent) {
+    timer_.setTimerType(Qt::PreciseTimer);
+    connect(&timer_, &QTimer::timeout, this, &RepaintScheduler::onTick);
+}
+
+void RepaintScheduler::setPlots(const QVector<PlotWidget*>& plots) {
+    plots_.clear();
+    for (auto* w : plots) plots_.push_back(w);
+}
+
+void RepaintScheduler::setTargetFps(double fps) {
+    targetFps_ = fps;
+    if (timer_.isActive()) start(); // 以新周期重启
+}
+
+double RepaintScheduler::effectiveFps() const {
+    double fps = targetFps_;
+    if (fps <= 0.0) {
+        const QScreen* scr = QGuiApplication::primaryScreen();
+        fps = scr ? scr->refreshRate() : 60.0;
+    }
+    return std::clamp(fps, 1.0, 240.0);
+}
+
+void RepaintScheduler::start() {
+    timer_.start(std::max(1, (int)std::lround(1000.0 / effectiveFps())));
+}
+
+void RepaintScheduler::stop() {
+    timer_.stop();
+}
+
+void RepaintScheduler::onTick() {
+    if (!ring_) return;
+    quint64 widx = ring_->snapshot_write_index();
+    if (envAgg_) {
+        // 投递最新写指针给后台（不等待），换入已完成的最新快照；绘图以快照为准，
+        // 后台赶不上时继续显示上一份
+        envAgg_->request(widx);
+        envAgg_->acquire();
+        if (envAgg_->hasSnapshot()) widx = envAgg_->snapshotWriteIndex();
+    }
+    for (const auto& w : plots_) {
+        if (!w || !w->isVisible()) continue;
+        if (w->paintedWriteIndex() == widx) continue; // 上次绘制后没有新数据
+        w->update();
+    }
+}
@@ -0,0 +1,332 @@
+#include "Unpack.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define UDPSCOPE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// ------------------------ 标量参考实现 ------------------------
+// RAW10 / RAW16 的内核写成以 N 为模板参数：N > 0 时组数（样本数）是编译期常量，循环可完全展开，
+// 供解析计划的定长特化使用；N = 0 时用运行时参数，即下面导出的通用版本。
+
+namespace {
+
+template <int N>
+inline void raw10_scalar_n(const uint8_t* p, int groups_rt, uint16_t* out) {
+    const int groups = N ? N : groups_rt;
+    for (int g = 0, o = 0; g < groups; ++g) {
+        const uint8_t b0 = p[g*5 + 0];
+        const uint8_t b1 = p[g*5 + 1];
+        const uint8_t b2 = p[g*5 + 2];
+        const uint8_t b3 = p[g*5 + 3];
+        const uint8_t b4 = p[g*5 + 4];
+        out[o++] = static_cast<uint16_t>( b0 | ((b4 & 0x03) << 8) );
+        out[o++] = static_cast<uint16_t>( b1 | ((b4 & 0x0C) << 6) );
+        out[o++] = static_cast<uint16_t>( b2 | ((b4 & 0x30) << 4) );
+        out[o++] = static_cast<uint16_t>( b3 | ((b4 & 0xC0) << 2) );
+    }
+}
+
+template <int N, bool BigEndian>
+inline void raw16_n(const uint8_t* p, int samples_rt, uint16_t* out) {
+    const int samples = N ? N : samples_rt;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // 小端主机上 LE 就是 memcpy；BE 先整段拷贝再原地换字节序，后者可向量化为 pshufb
+    std::memcpy(out, p, static_cast<size_t>(samples) * 2);
+    if (BigEndian)
+        for (int i = 0; i < samples; ++i) out[i] = __builtin_bswap16(out[i]);
+    return;
+#endif
+    for (int i = 0; i < samples; ++i)
+        out[i] = BigEndian ? static_cast<uint16_t>((p[2*i] << 8) | p[2*i + 1])
+                           : static_cast<uint16_t>(p[2*i] | (p[2*i + 1] << 8));
+}
+
+} // namespace
+
+void unpack_raw10_scalar(const uint8_t* p, int groups, uint16_t* out) {
+    raw10_scalar_n<0>(p, groups, out);
+}
+
+void unpack_raw12_scalar(const uint8_t* p, int groups, uint16_t* out) {
+    for (int g = 0; g < groups; ++g, p += 3, out += 2) {
+        out[0] = static_cast<uint16_t>( p[0] | ((p[1] & 0x0F) << 8) );
+        out[1] = static_cast<uint16_t>( (p[1] >> 4) | (p[2] << 4) );
+    }
+}
+
+void unpack_raw14_scalar(const uint8_t* p, int groups, uint16_t* out) {
+    for (int g = 0; g < groups; ++g, p += 7, out += 4) {
+        uint64_t w = 0;
+        for (int i = 0; i < 7; ++i) w |= uint64_t(p[i]) << (8 * i);
+        out[0] = static_cast<uint16_t>( w        & 0x3FFF);
+        out[1] = static_cast<uint16_t>((w >> 14) & 0x3FFF);
+        out[2] = static_cast<uint16_t>((w >> 28) & 0x3FFF);
+        out[3] = static_cast<uint16_t>((w >> 42) & 0x3FFF);
+    }
+}
+
+void unpack_mipi_raw10_scalar(const uint8_t* p, int groups, uint16_t* out) {
+    for (int g = 0; g < groups; ++g, p += 5, out += 4) {
+        const uint8_t lo = p[4];
+        out[0] = static_cast<uint16_t>( (p[0] << 2) | ( lo       & 0x03) );
+        out[1] = static_cast<uint16_t>( (p[1] << 2) | ((lo >> 2) & 0x03) );
+        out[2] = static_cast<uint16_t>( (p[2] << 2) | ((lo >> 4) & 0x03) );
+        out[3] = static_cast<uint16_t>( (p[3] << 2) | ((lo >> 6) & 0x03) );
+    }
+}
+
+void unpack_mipi_raw12_scalar(const uint8_t* p, int groups, uint16_t* out) {
+    for (int g = 0; g < groups; ++g, p += 3, out += 2) {
+        out[0] = static_cast<uint16_t>( (p[0] << 4) | (p[2] & 0x0F) );
+        out[1] = static_cast<uint16_t>( (p[1] << 4) | (p[2] >> 4) );
+    }
+}
+
+void unpack_raw16le_scalar(const uint8_t* p, int samples, uint16_t* out) {
+    raw16_n<0, false>(p, samples, out);
+}
+
+void unpack_raw16be_scalar(const uint8_t* p, int samples, uint16_t* out) {
+    raw16_n<0, true>(p, samples, out);
+}
+
+// ------------------------ 打包（解包的逆） ------------------------
+
+void pack_raw10_scalar(const uint16_t* in, int groups, uint8_t* p) {
+    for (int g = 0; g < groups; ++g, in += 4, p += 5) {
+        p[0] = static_cast<uint8_t>(in[0]);
+        p[1] = static_cast<uint8_t>(in[1]);
+        p[2] = static_cast<uint8_t>(in[2]);
+        p[3] = static_cast<uint8_t>(in[3]);
+        p[4] = static_cast<uint8_t>( ((in[0] >> 8) & 0x03)       | (((in[1] >> 8) & 0x03) << 2)
+                                   | (((in[2] >> 8) & 0x03) << 4) | (((in[3] >> 8) & 0x03) << 6) );
+    }
+}
+
+void pack_raw12_scalar(const uint16_t* in, int groups, uint8_t* p) {
+    for (int g = 0; g < groups; ++g, in += 2, p += 3) {
+        p[0] = static_cast<uint8_t>(in[0]);
+        p[1] = static_cast<uint8_t>(((in[0] >> 8) & 0x0F) | ((in[1] & 0x0F) << 4));
+        p[2] = static_cast<uint8_t>(in[1] >> 4);
+    }
+}
+
+void pack_raw14_scalar(const uint16_t* in, int groups, uint8_t* p) {
+    for (int g = 0; g < groups; ++g, in += 4, p += 7) {
+        const uint64_t w =  uint64_t(in[0] & 0x3FFF)        | (uint64_t(in[1] & 0x3FFF) << 14)
+                         | (uint64_t(in[2] & 0x3FFF) << 28) | (uint64_t(in[3] & 0x3FFF) << 42);
+        for (int i = 0; i < 7; ++i) p[i] = static_cast<uint8_t>(w >> (8 * i));
+    }
+}
+
+void pack_mipi_raw10_scalar(const uint16_t* in, int groups, uint8_t* p) {
+    for (int g = 0; g < groups; ++g, in += 4, p += 5) {
+        for (int i = 0; i < 4; ++i) p[i] = static_cast<uint8_t>((in[i] >> 2) & 0xFF);
+        p[4] = static_cast<uint8_t>( (in[0] & 0x03)       | ((in[1] & 0x03) << 2)
+                                   | ((in[2] & 0x03) << 4) | ((in[3] & 0x03) << 6) );
+    }
+}
+
+void pack_mipi_raw12_scalar(const uint16_t* in, int groups, uint8_t* p) {
+    for (int g = 0; g < groups; ++g, in += 2, p += 3) {
+        p[0] = static_cast<uint8_t>((in[0] >> 4) & 0xFF);
+        p[1] = static_cast<uint8_t>((in[1] >> 4) & 0xFF);
+        p[2] = static_cast<uint8_t>((in[0] & 0x0F) | ((in[1] & 0x0F) << 4));
+    }
+}
+
+void pack_raw16le_scalar(const uint16_t* in, int samples, uint8_t* p) {
+    for (int i = 0; i < samples; ++i) { p[2*i] = static_cast<uint8_t>(in[i]); p[2*i + 1] = static_cast<uint8_t>(in[i] >> 8); }
+}
+
+void pack_raw16be_scalar(const uint16_t* in, int samples, uint8_t* p) {
+    for (int i = 0; i < samples; ++i) { p[2*i] = static_cast<uint8_t>(in[i] >> 8); p[2*i + 1] = static_cast<uint8_t>(in[i]); }
+}
+
+// ------------------------ RAW10 SIMD ------------------------
+// 每个 128 位通道处理 2 组（10 字节 → 8 个 uint16）：
+//   lo = pshufb 取每个样本的低字节 b0..b3（高字节置 0）
+//   hi = pshufb 把该组的 b4 放进每个样本，再乘 {256,64,16,4} 相当于左移 {8,6,4,2}，
+//        与 0x0300 相与后正好是该样本的 2 个高位
+//   out = lo | hi
+// 每次加载 16 字节但只用 10 字节，因此主循环要求后面还有足够字节可读，剩余组走标量。
+// 各级同样以 N 为模板参数：N > 0 时主循环次数与交给下一级的余数都在编译期确定。
+
+// 主循环（至少还剩 need 组时每次 step 组）结束时已处理的组数
+constexpr int simd_done(int groups, int need, int step) {
+    return groups >= need ? ((groups - need) / step + 1) * step : 0;
+}
+constexpr int simd_rest(int n, int need, int step) { return n ? n - simd_done(n, need, step) : 0; }
+
+#ifdef UDPSCOPE_X86_SIMD
+
+namespace {
+
+alignas(16) const int8_t kLoShuf[16] = { 0,-1, 1,-1, 2,-1, 3,-1,  5,-1, 6,-1, 7,-1, 8,-1 };
+alignas(16) const int8_t kHiShuf[16] = { 4,-1, 4,-1, 4,-1, 4,-1,  9,-1, 9,-1, 9,-1, 9,-1 };
+alignas(16) const int16_t kMul[8]    = { 256, 64, 16, 4, 256, 64, 16, 4 };
+
+template <int N>
+__attribute__((target("ssse3")))
+void unpack_raw10_ssse3(const uint8_t* p, int groups_rt, uint16_t* out) {
+    const int groups = N ? N : groups_rt;
+    const __m128i lo_shuf = _mm_load_si128(reinterpret_cast<const __m128i*>(kLoShuf));
+    const __m128i hi_shuf = _mm_load_si128(reinterpret_cast<const __m128i*>(kHiShuf));
+    const __m128i mul     = _mm_load_si128(reinterpret_cast<const __m128i*>(kMul));
+    const __m128i mask    = _mm_set1_epi16(0x0300);
+
+    int g = 0;
+    // 读 16 字节、消费 10 字节：至少还剩 4 组（20 字节）时才走向量路径
+    for (; g + 4 <= groups; g += 2) {
+        const __m128i v  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + g*5));
+        const __m128i lo = _mm_shuffle_epi8(v, lo_shuf);
+        const __m128i hi = _mm_and_si128(_mm_mullo_epi16(_mm_shuffle_epi8(v, hi_shuf), mul), mask);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + g*4), _mm_or_si128(lo, hi));
+    }
+    raw10_scalar_n<simd_rest(N, 4, 2)>(p + g*5, groups - g, out + g*4);
+}
+
+template <int N>
+__attribute__((target("avx2")))
+void unpack_raw10_avx2(const uint8_t* p, int groups_rt, uint16_t* out) {
+    const int groups = N ? N : groups_rt;
+    const __m256i lo_shuf = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kLoShuf)));
+    const __m256i hi_shuf = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kHiShuf)));
+    const __m256i mul     = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(kMul)));
+    const __m256i mask    = _mm256_set1_epi16(0x0300);
+
+    int g = 0;
+    // 每次 4 组（20 字节），第二个通道从 +10 读 16 字节：至少还剩 6 组时才走向量路径
+    for (; g + 6 <= groups; g += 4) {
+        const uint8_t* q = p + g*5;
+        const __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(q))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + 10)), 1);
+        const __m256i lo = _mm256_shuffle_epi8(v, lo_shuf);
+        const __m256i hi = _mm256_and_si256(_mm256_mullo_epi16(_mm256_shuffle_epi8(v, hi_shuf), mul), mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + g*4), _mm256_or_si256(lo, hi));
+    }
+    // 余下交给 SSSE3 内核：它是非 VEX 编码，GCC 在这个尾调用前不会自动插 vzeroupper，
+    // 高半部分的脏状态会让其中每条 SSE 指令都付出 AVX→SSE 切换代价（实测通用版因此比 SSSE3 还慢 2~3 倍）
+    _mm256_zeroupper();
+    unpack_raw10_ssse3<simd_rest(N, 6, 4)>(p + g*5, groups - g, out + g*4);
+}
+
+template <int N>
+__attribute__((target("avx512f,avx512bw")))
+void unpack_raw10_avx512(const uint8_t* p, int groups_rt, uint16_t* out) {
+    const int groups = N ? N : groups_rt;
+    // maskz 形式以全 0 为底：非掩码的 _mm512_broadcast_i32x4 / _mm512_castsi128_si512 以未定义值为底，
+    // GCC 会报 -Wuninitialized
+    const __m512i lo_shuf = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_load_si128(reinterpret_cast<const __m128i*>(kLoShuf)));
+    const __m512i hi_shuf = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_load_si128(reinterpret_cast<const __m128i*>(kHiShuf)));
+    const __m512i mul     = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_load_si128(reinterpret_cast<const __m128i*>(kMul)));
+    const __m512i mask    = _mm512_set1_epi16(0x0300);
+
+    int g = 0;
+    // 每次 8 组（40 字节），最后一个通道从 +30 读 16 字节：至少还剩 10 组时才走向量路径
+    for (; g + 10 <= groups; g += 8) {
+        const uint8_t* q = p + g*5;
+        __m512i v = _mm512_zextsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i*>(q)));
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + 10)), 1);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + 20)), 2);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(q + 30)), 3);
+        const __m512i lo = _mm512_shuffle_epi8(v, lo_shuf);
+        const __m512i hi = _mm512_and_si512(_mm512_mullo_epi16(_mm512_shuffle_epi8(v, hi_shuf), mul), mask);
+        _mm512_storeu_si512(reinterpret_cast<void*>(out + g*4), _mm512_or_si512(lo, hi));
+    }
+    unpack_raw10_avx2<simd_rest(N, 10, 8)>(p + g*5, groups - g, out + g*4);
+}
+
+} // namespace
+
+#endif // UDPSCOPE_X86_SIMD
+
+// ------------------------ 运行时分发 ------------------------
+
+namespace {
+
+using Raw10Kernel = void (*)(const uint8_t*, int, uint16_t*);
+
+constexpr int kFixedRaw10Groups  = 256;  // 1280 B / 1024 样本
+constexpr int kFixedRaw16Samples = 1024;
+
+struct KernelEntry { const char* name; Raw10Kernel fn; Raw10Kernel fixed; bool (*supported)(); };
+
+bool always() { return true; }
+#ifdef UDPSCOPE_X86_SIMD
+bool has_ssse3()  { __builtin_cpu_init(); return __builtin_cpu_supports("ssse3"); }
+bool has_avx2()   { __builtin_cpu_init(); return __builtin_cpu_supports("avx2"); }
+bool has_avx512() { __builtin_cpu_init(); return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"); }
+#endif
+
+// 按优先级从高到低
+const KernelEntry kKernels[] = {
+#ifdef UDPSCOPE_X86_SIMD
+    { "avx512", unpack_raw10_avx512<0>, unpack_raw10_avx512<kFixedRaw10Groups>, has_avx512 },
+    { "avx2",   unpack_raw10_avx2<0>,   unpack_raw10_avx2<kFixedRaw10Groups>,   has_avx2   },
+    { "ssse3",  unpack_raw10_ssse3<0>,  unpack_raw10_ssse3<kFixedRaw10Groups>,  has_ssse3  },
+#endif
+    { "scalar", unpack_raw10_scalar,    raw10_scalar_n<kFixedRaw10Groups>,      always     },
+};
+
+const KernelEntry* find_kernel(const char* name) {
+    for (const auto& k : kKernels)
+        if (std::strcmp(k.name, name) == 0) return &k;
+    return nullptr;
+}
+
+const KernelEntry* initial_kernel() {
+    if (const char* env = std::getenv("UDPSCOPE_UNPACK")) {
+        const KernelEntry* k = find_kernel(env);
+        if (k && k->supported()) return k;
+    }
+    for (const auto& k : kKernels)
+        if (k.supported()) return &k;
+    return &kKernels[sizeof(kKernels) / sizeof(kKernels[0]) - 1];
+}
+
+const KernelEntry* g_raw10 = initial_kernel();
+
+} // namespace
+
+void unpack_raw10(const uint8_t* p, int groups, uint16_t* out) {
+    g_raw10->fn(p, groups, out);
+}
+
+const char* unpack_kernel_name() {
+    return g_raw10->name;
+}
+
+std::vector<const char*> available_unpack_kernels() {
+    std::vector<const char*> out;
+    for (const auto& k : kKernels)
+        if (k.supported()) out.push_back(k.name);
+    return out;
+}
+
+bool select_unpack_kernel(const char* name) {
+    const KernelEntry* k = find_kernel(name);
+    if (!k || !k->supported()) return false;
+    g_raw10 = k;
+    return true;
+}
+
+UnpackKernel raw10_plan_kernel(int groups, bool* fixed) {
+    const bool hit = groups == kFixedRaw10Groups;
+    if (fixed) *fixed = hit;
+    return hit ? g_raw10->fixed : g_raw10->fn;
+}
+
+UnpackKernel raw16_plan_kernel(bool big_endian, int samples, bool* fixed) {
+    const bool hit = samples == kFixedRaw16Samples;
+    if (fixed) *fixed = hit;
+    if (big_endian) return hit ? raw16_n<kFixedRaw16Samples, true> : unpack_raw16be_scalar;
+    // LE 不特化：定长 memcpy 会被 GCC 内联成 rep movsq，反而比 libc 按运行时长度选的向量拷贝慢
+    if (fixed) *fixed = false;
+    return unpack_raw16le_scalar;
+}
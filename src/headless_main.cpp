@@ -0,0 +1,297 @@
+// udpscope_headless：无显示环境下的抓包/录制/统计守护进程
+//
+//   udpscope_headless [--config FILE] [--backend pcap|tpacket|udp|replay] [--if IFNAME] [--bpf EXPR] [--no-promisc]
+//                     [--bind ADDR:PORT] [--rx-threads N] [--fanout hash|cpu|lb]
+//                     [--replay FILE] [--speed X] [--loop]
+//                     [--pack MODE] [--spf N] [--header N] [--tail N] [--payload N] [--bits N]
+//                     [--seq-offset N] [--seq-bytes N] [--seq-le] [--reorder N]
+//                     [--ring-mb N] [--layout row|tiled|packed] [--record FILE]
+//                     [--duration SEC] [--interval SEC] [--stats-json FILE]
+//
+// 与 GUI 完全相同的采集路径（PcapWorker → 解析计划 → 主环 → 录制器），只链接 QtCore：
+// 没有绘图，环照常维护（录制器与统计读它），吞吐与丢包因此与 GUI 下的收包路径可比。
+// 配置文件每行 `key = value`（key 即去掉 `--` 的选项名，无参数的选项写 `loop = 1`），`#` 起为注释；
+// 参数按出现顺序生效，--config 之后的命令行选项覆盖文件里的同名项。
+// 每个 --interval 向 stderr 打一行吞吐/丢包/p99；给了 --stats-json 时同时重写该文件；退出时完整 JSON 输出到 stdout。
+// --duration 0（默认）一直运行到 SIGINT/SIGTERM；回放不循环时放完即退出。
+
+#include "Metrics.hpp"
+#include "PcapWorker.hpp"
+#include "Recorder.hpp"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+std::atomic<bool> g_quit{false};
+
+void on_signal(int) { g_quit.store(true); }
+
+struct Options {
+    CaptureConfig cap;
+    ParserConfig  cfg;
+    bool          derive      = false; // 给了 --pack/--spf 时按格式推出 payload/位宽，再由显式选项覆盖
+    int           header      = -1;
+    int           tail        = -1;
+    int           payload     = -1;
+    int           bits        = -1;
+    size_t        ring_mb     = 512;
+    RingLayout    layout      = RingLayout::ROW_MAJOR;
+    std::string   record_path;
+    std::string   stats_json;
+    double        duration    = 0;   // 0 = 直到收到信号
+    double        interval    = 1.0;
+};
+
+int usage(const char* argv0) {
+    std::fprintf(stderr,
+        "usage: %s [--config FILE] [--backend pcap|tpacket|udp|replay] [--if IFNAME] [--bpf EXPR] [--no-promisc]\n"
+        "          [--bind ADDR:PORT] [--rx-threads N] [--fanout hash|cpu|lb] [--replay FILE] [--speed X] [--loop]\n"
+        "          [--pack MODE] [--spf N] [--header N] [--tail N] [--payload N] [--bits N]\n"
+        "          [--seq-offset N] [--seq-bytes N] [--seq-le] [--reorder N]\n"
+        "          [--ring-mb N] [--layout row|tiled|packed] [--record FILE]\n"
+        "          [--duration SEC] [--interval SEC] [--stats-json FILE]\n",
+        argv0);
+    return 2;
+}
+
+bool is_flag(const std::string& key) {
+    return key == "loop" || key == "seq-le" || key == "no-promisc";
+}
+
+bool truthy(const std::string& v) {
+    return v.empty() || v == "1" || v == "true" || v == "yes" || v == "on";
+}
+
+bool load_config_file(const std::string& path, std::vector<std::pair<std::string, std::string>>& out, std::string& why);
+
+// 应用一个选项（命令行或配置文件）；失败时 why 给出原因
+bool apply_option(Options& o, const std::string& key, const std::string& val, std::string& why) {
+    CaptureConfig& c = o.cap;
+    if      (key == "if")          std::snprintf(c.ifname, sizeof(c.ifname), "%s", val.c_str());
+    else if (key == "bpf")         std::snprintf(c.bpf, sizeof(c.bpf), "%s", val.c_str());
+    else if (key == "rx-threads")  c.rx_threads = std::atoi(val.c_str());
+    else if (key == "replay")      { std::snprintf(c.replay_path, sizeof(c.replay_path), "%s", val.c_str()); c.backend = CaptureBackend::REPLAY_FILE; }
+    else if (key == "speed")       c.replay_speed = std::atof(val.c_str());
+    else if (key == "loop")        c.replay_loop = truthy(val);
+    else if (key == "no-promisc")  c.promisc = !truthy(val);
+    else if (key == "spf")         { o.cfg.samples_per_frame = std::atoi(val.c_str()); o.derive = true; }
+    else if (key == "header")      o.header = std::atoi(val.c_str());
+    else if (key == "tail")        o.tail = std::atoi(val.c_str());
+    else if (key == "payload")     o.payload = std::atoi(val.c_str());
+    else if (key == "bits")        o.bits = std::atoi(val.c_str());
+    else if (key == "seq-offset")  o.cfg.seq_offset = std::atoi(val.c_str());
+    else if (key == "seq-bytes")   o.cfg.seq_bytes = std::atoi(val.c_str());
+    else if (key == "seq-le")      o.cfg.seq_big_endian = !truthy(val);
+    else if (key == "reorder")     o.cfg.reorder_window = std::atoi(val.c_str());
+    else if (key == "ring-mb")     o.ring_mb = std::strtoull(val.c_str(), nullptr, 10);
+    else if (key == "record")      o.record_path = val;
+    else if (key == "duration")    o.duration = std::atof(val.c_str());
+    else if (key == "interval")    o.interval = std::atof(val.c_str());
+    else if (key == "stats-json")  o.stats_json = val;
+    else if (key == "pack") {
+        if (!pack_mode_from_name(val, o.cfg.pack)) { why = "unknown pack mode: " + val; return false; }
+        o.derive = true;
+    } else if (key == "bind") {
+        const size_t colon = val.rfind(':');
+        std::snprintf(c.bind_addr, sizeof(c.bind_addr), "%s", val.substr(0, colon).c_str());
+        if (colon != std::string::npos) c.bind_port = std::atoi(val.c_str() + colon + 1);
+    } else if (key == "backend") {
+        if      (val == "pcap")    c.backend = CaptureBackend::PCAP;
+        else if (val == "tpacket") c.backend = CaptureBackend::TPACKET_V3;
+        else if (val == "udp")     c.backend = CaptureBackend::UDP_SOCKET;
+        else if (val == "replay")  c.backend = CaptureBackend::REPLAY_FILE;
+        else { why = "unknown backend: " + val; return false; }
+    } else if (key == "fanout") {
+        if      (val == "hash") c.fanout = FanoutMode::HASH;
+        else if (val == "cpu")  c.fanout = FanoutMode::CPU;
+        else if (val == "lb")   c.fanout = FanoutMode::LB;
+        else { why = "unknown fanout mode: " + val; return false; }
+    } else if (key == "layout") {
+        if      (val == "row")    o.layout = RingLayout::ROW_MAJOR;
+        else if (val == "tiled")  o.layout = RingLayout::CHANNEL_TILED;
+        else if (val == "packed") o.layout = RingLayout::PACKED;
+        else { why = "unknown ring layout: " + val; return false; }
+    } else if (key == "config") {
+        std::vector<std::pair<std::string, std::string>> kv;
+        if (!load_config_file(val, kv, why)) return false;
+        for (const auto& e : kv)
+            if (!apply_option(o, e.first, e.second, why)) { why = val + ": " + why; return false; }
+    } else {
+        why = "unknown option: " + key;
+        return false;
+    }
+    return true;
+}
+
+std::string trim(const std::string& s) {
+    const size_t a = s.find_first_not_of(" \t\r");
+    if (a == std::string::npos) return {};
+    return s.substr(a, s.find_last_not_of(" \t\r") - a + 1);
+}
+
+bool load_config_file(const std::string& path, std::vector<std::pair<std::string, std::string>>& out, std::string& why) {
+    std::ifstream f(path);
+    if (!f) { why = "cannot open config file " + path; return false; }
+    std::string line;
+    for (int n = 1; std::getline(f, line); ++n) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+        const size_t eq = line.find('=');
+        const std::string key = trim(line.substr(0, eq));
+        const std::string val = eq == std::string::npos ? std::string() : trim(line.substr(eq + 1));
+        if (eq == std::string::npos && !is_flag(key)) {
+            why = path + ":" + std::to_string(n) + ": expected key = value";
+            return false;
+        }
+        out.emplace_back(key, val);
+    }
+    return true;
+}
+
+// 解析配置：给了 --pack/--spf 时先按格式推出自洽的一组，再叠加显式给出的长度/位宽
+ParserConfig resolve_parser_config(const Options& o) {
+    ParserConfig c = o.cfg;
+    if (o.derive) {
+        const ParserConfig d = parser_config_for(c.pack, c.samples_per_frame,
+                                                 o.header >= 0 ? o.header : c.header_bytes,
+                                                 o.tail >= 0 ? o.tail : c.tail_bytes);
+        c.header_bytes = d.header_bytes; c.payload_bytes = d.payload_bytes; c.tail_bytes = d.tail_bytes;
+        c.bits_per_sample = d.bits_per_sample;
+    }
+    if (o.header >= 0)  c.header_bytes    = o.header;
+    if (o.tail >= 0)    c.tail_bytes      = o.tail;
+    if (o.payload >= 0) c.payload_bytes   = o.payload;
+    if (o.bits >= 0)    c.bits_per_sample = o.bits;
+    c.frame_size_bytes = c.header_bytes + c.payload_bytes + c.tail_bytes;
+    return c;
+}
+
+void print_progress(double t, const RuntimeStats& s, const PipelineMetrics& m, uint64_t d_frames, uint64_t d_bytes, double dt) {
+    const auto p99_us = [&](PipelineStage st) { return double(m[st].summary().p99_ns) / 1e3; };
+    std::fprintf(stderr,
+                 "t=%.1fs rx %.0f fps %.1f MB/s frames %llu drop %llu (parse %llu size %llu kernel %llu) seq_lost %llu"
+                 " | p99 us: dequeue %.1f unpack %.2f publish %.2f\n",
+                 t, dt > 0 ? double(d_frames) / dt : 0.0, dt > 0 ? double(d_bytes) / dt / 1e6 : 0.0,
+                 static_cast<unsigned long long>(s.frames_rx.load()), static_cast<unsigned long long>(s.frames_drop.load()),
+                 static_cast<unsigned long long>(s.drop_parse.load()), static_cast<unsigned long long>(s.drop_size.load()),
+                 static_cast<unsigned long long>(s.kernel_drops.load()), static_cast<unsigned long long>(s.seq_lost.load()),
+                 p99_us(PipelineStage::CAPTURE_TO_DEQUEUE), p99_us(PipelineStage::UNPACK), p99_us(PipelineStage::RING_PUBLISH));
+}
+
+// 先写临时文件再改名，读者不会看到写了一半的 JSON
+void write_stats_json(const std::string& path, const std::string& json) {
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::trunc);
+        if (!f) return;
+        f << json;
+    }
+    std::rename(tmp.c_str(), path.c_str());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    Options o;
+    o.cfg = g_cfg;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "-h" || a == "--help" || a.rfind("--", 0) != 0) return usage(argv[0]);
+        const std::string key = a.substr(2);
+        std::string val;
+        if (!is_flag(key)) {
+            if (i + 1 >= argc) return usage(argv[0]);
+            val = argv[++i];
+        }
+        std::string why;
+        if (!apply_option(o, key, val, why)) { std::fprintf(stderr, "%s\n", why.c_str()); return 2; }
+    }
+
+    const ParserConfig cfg = resolve_parser_config(o);
+    std::string why;
+    if (!validate_parser_config(cfg, why)) { std::fprintf(stderr, "invalid parser config: %s\n", why.c_str()); return 2; }
+    g_cfg = cfg;
+
+    RingOptions ro;
+    ro.layout         = o.layout;
+    ro.enable_pyramid = false; // 没有绘图查询包络，金字塔只是 RX 线程的额外开销
+    DecodedFrameRing ring(DecodedFrameRing::frames_for_budget(o.ring_mb << 20, ro), ro);
+    RuntimeStats     stats;
+    PipelineMetrics  metrics;
+    std::fprintf(stderr, "%s x%d, %d bytes/frame, ring %zu frames (%zu MB, %d-bit%s)\n",
+                 pack_mode_name(cfg.pack), cfg.samples_per_frame, cfg.frame_size_bytes, ring.capacity(),
+                 ring.memory_bytes() >> 20, ring.storage_bits(), ring.huge_pages() ? ", huge pages" : "");
+
+    // 错误可能从抓包线程发出：只置标志，由主线程的定时器退出
+    std::atomic<bool> failed{false};
+    const auto report = [&](const char* who) {
+        return [&failed, who](const QString& msg) {
+            std::fprintf(stderr, "%s error: %s\n", who, msg.toStdString().c_str());
+            failed.store(true);
+        };
+    };
+
+    std::unique_ptr<Recorder> recorder;
+    if (!o.record_path.empty()) {
+        recorder = std::make_unique<Recorder>(ring, stats, QString::fromStdString(o.record_path));
+        QObject::connect(recorder.get(), &Recorder::errorOccurred, report("record"));
+        recorder->start();
+        if (failed.load()) return 1;
+    }
+
+    PcapWorker worker(ring, o.cap, stats, nullptr, &metrics);
+    QObject::connect(&worker, &PcapWorker::errorOccurred, report("capture"));
+    worker.start();
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    QElapsedTimer clock;
+    clock.start();
+    double   last_t = 0;
+    uint64_t last_frames = 0, last_bytes = 0;
+    const auto report_interval = [&] {
+        const double   t = clock.elapsed() / 1000.0;
+        const uint64_t f = stats.frames_rx.load(), b = stats.bytes_rx.load();
+        print_progress(t, stats, metrics, f - last_frames, b - last_bytes, t - last_t);
+        if (!o.stats_json.empty()) write_stats_json(o.stats_json, pipeline_stats_json(&stats, &metrics));
+        last_t = t; last_frames = f; last_bytes = b;
+    };
+
+    // 100 ms 检查一次退出条件，每 interval 报告一次
+    QTimer tick;
+    tick.setInterval(100);
+    QObject::connect(&tick, &QTimer::timeout, [&] {
+        const double t = clock.elapsed() / 1000.0;
+        const bool replay_over = o.cap.backend == CaptureBackend::REPLAY_FILE && !o.cap.replay_loop
+                              && stats.replay_done.load(std::memory_order_acquire);
+        if (g_quit.load() || failed.load() || replay_over || (o.duration > 0 && t >= o.duration)) {
+            app.quit();
+            return;
+        }
+        if (o.interval > 0 && t - last_t >= o.interval) report_interval();
+    });
+    tick.start();
+    app.exec();
+
+    worker.stop();
+    if (recorder) recorder->stop();
+    report_interval();
+    std::fputs(pipeline_stats_json(&stats, &metrics).c_str(), stdout);
+    return failed.load() ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+// envelope_test：滑动包络对 range_stats 的逐 bin 比对，以及 EnvelopeAggregator 分段计算后各通道的 bin 对齐
+//
+//   envelope_test          全部通过返回 0，否则打印每处不一致并返回 1
+//
+// 帧间隔随时间缓慢漂移，让 fpb 在 ±10% 以内变化（沿用划分）与超出（重建）两种情况都被走到。
+
+#include "Core.hpp"
+#include "EnvelopeAggregator.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int g_failures = 0;
+
+void fail(const std::string& what) {
+    if (++g_failures <= 50) std::fprintf(stderr, "FAIL %s\n", what.c_str());
+}
+
+constexpr int kSamples = 16;
+
+// 追加 n 帧随机样本，时间戳每帧前进 period_ns
+void push_frames(DecodedFrameRing& ring, std::mt19937& rng, int n, int64_t period_ns, int64_t& t_ns) {
+    std::vector<uint16_t> f(kSamples);
+    for (int i = 0; i < n; ++i) {
+        for (auto& v : f) v = static_cast<uint16_t>(rng() & 0x3FF);
+        t_ns += period_ns;
+        ring.push_frame(f.data(), t_ns);
+    }
+}
+
+bool near(double a, double b) { return std::fabs(a - b) <= 1e-9 * std::max(1.0, std::fabs(b)); }
+
+// 第 k 个 bin 为 [k*fpb, (k+1)*fpb)（头 bin 截到 widx），每通道的 min/max/mean 与 x 须与 range_stats 一致
+void test_sliding_vs_range_stats() {
+    constexpr int    kBins   = 20;
+    constexpr double kWindow = 1.0;
+    DecodedFrameRing ring(1 << 15);
+    std::mt19937 rng(19);
+    int64_t t = 0;
+    push_frames(ring, rng, 2000, 1000000, t);
+
+    const std::vector<int> chs = {0, 1, 2, 5, 9, 15};
+    SlidingEnvelope slide;
+    MultiEnvelope out;
+    for (int step = 0; step < 300; ++step) {
+        // 帧间隔在 0.8..1.2 ms 间正弦漂移
+        const int64_t period = static_cast<int64_t>(1e6 * (1.0 + 0.2 * std::sin(step / 25.0)));
+        push_frames(ring, rng, 37, period, t);
+        const uint64_t widx = ring.snapshot_write_index();
+        slide.update(ring, widx, chs, kWindow, kBins, out);
+
+        const uint64_t fpb = slide.frames_per_bin();
+        const uint64_t kh  = (widx - 1) / fpb;
+        const int64_t  t_end = ring.timestamp_ns(widx - 1);
+        for (int b = 0; b < kBins; ++b) {
+            const uint64_t k  = kh - static_cast<uint64_t>(kBins - 1 - b);
+            const uint64_t f0 = k * fpb, f1 = std::min((k + 1) * fpb, widx);
+            const double x = static_cast<double>((ring.timestamp_ns(f0) + ring.timestamp_ns(f1 - 1)) / 2 - t_end) * 1e-9;
+            if (!near(out.x[static_cast<size_t>(b)], x)) {
+                fail("sliding x step " + std::to_string(step) + " bin " + std::to_string(b));
+                return;
+            }
+            for (size_t s = 0; s < chs.size(); ++s) {
+                const RangeStats rs = ring.range_stats(f0, f1, chs[s], widx);
+                const size_t o = s * kBins + static_cast<size_t>(b);
+                if (out.ymin[o] != rs.vmin || out.ymax[o] != rs.vmax ||
+                    !near(out.mean[o], static_cast<double>(rs.sum) / static_cast<double>(rs.count))) {
+                    fail("sliding ch " + std::to_string(chs[s]) + " step " + std::to_string(step) + " bin " + std::to_string(b));
+                    return;
+                }
+            }
+        }
+    }
+    if (slide.rebuilds() < 2) fail("sliding: rate drift never forced a rebuild");
+}
+
+// 等到后台算完 widx 对应的快照
+bool wait_snapshot(EnvelopeAggregator& agg, uint64_t widx) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        agg.acquire();
+        if (agg.hasSnapshot() && agg.snapshotWriteIndex() == widx) return true;
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    return false;
+}
+
+// 通道分成两段并行计算；帧率漂移（fpb 仍在 ±10% 内）之后只有第二段的通道集合变化。
+// 各段须仍在同一套 bin 上：每个通道都与单个 SlidingEnvelope 对全部通道算出的结果逐 bin 相同，x 也相同
+void test_aggregator_alignment() {
+    constexpr int    kBins   = 20;
+    constexpr double kWindow = 1.0;
+    DecodedFrameRing ring(1 << 15);
+    std::mt19937 rng(20);
+    int64_t t = 0;
+    push_frames(ring, rng, 2000, 1000000, t);
+
+    EnvelopeAggregator agg(2);
+    agg.attachRing(&ring);
+    agg.setView(kWindow, kBins);
+    std::vector<int> chs = {0, 1, 2, 3, 4, 5, 6, 7};
+    agg.setChannels(chs);
+
+    SlidingEnvelope ref;
+    MultiEnvelope ro;
+    for (int step = 0; step < 160; ++step) {
+        if (step == 80) { chs = {0, 1, 2, 3, 8, 9, 10, 11}; agg.setChannels(chs); }
+        // 帧间隔 1.0 → 1.08 ms：fpb 从 50 降到 47，不触发重建
+        const int64_t period = 1000000 + std::min(step, 80) * 1000;
+        push_frames(ring, rng, 50, period, t);
+        const uint64_t widx = ring.snapshot_write_index();
+        agg.request(widx);
+        if (!wait_snapshot(agg, widx)) { fail("aggregator: no snapshot for step " + std::to_string(step)); return; }
+        ref.update(ring, widx, chs, kWindow, kBins, ro);
+
+        for (size_t s = 0; s < chs.size(); ++s) {
+            EnvelopeSlice sl;
+            if (!agg.slice(chs[s], kWindow, kBins, 0.0, sl)) { fail("aggregator: no slice for ch " + std::to_string(chs[s])); return; }
+            for (int b = 0; b < kBins; ++b) {
+                const size_t o = s * kBins + static_cast<size_t>(b);
+                if (sl.x[b] != ro.x[static_cast<size_t>(b)] || sl.ymin[b] != ro.ymin[o] || sl.ymax[b] != ro.ymax[o] ||
+                    !near(sl.mean[b], ro.mean[o])) {
+                    fail("aggregator ch " + std::to_string(chs[s]) + " step " + std::to_string(step) + " bin " + std::to_string(b));
+                    return;
+                }
+            }
+        }
+    }
+    agg.attachRing(nullptr);
+}
+
+} // namespace
+
+int main() {
+    g_cfg = parser_config_for(PackMode::RAW10_PACKED, kSamples, 8, 0);
+    test_sliding_vs_range_stats();
+    test_aggregator_alignment();
+    if (g_failures) {
+        std::fprintf(stderr, "%d failure(s)\n", g_failures);
+        return 1;
+    }
+    std::printf("envelope_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,123 @@
+// unpack_test：解包内核对标量参考实现的逐样本比对，以及各打包格式的打包/解包往返
+//
+//   unpack_test            全部通过返回 0，否则打印每处不一致并返回 1
+//
+// 输入缓冲都按内核需要的字节数精确分配：SIMD 内核若越界读到缓冲之后，ASan 构建下会直接报错。
+
+#include "Core.hpp"
+#include "Unpack.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int g_failures = 0;
+
+void fail(const std::string& what) {
+    if (++g_failures <= 50) std::fprintf(stderr, "FAIL %s\n", what.c_str());
+}
+
+std::string at(const char* name, int count, size_t i, uint16_t got, uint16_t want) {
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "%s count=%d sample %zu: got %u want %u", name, count, i, got, want);
+    return buf;
+}
+
+// 逐样本比较，只报第一处不一致
+bool same(const char* name, int count, const std::vector<uint16_t>& got, const std::vector<uint16_t>& want) {
+    for (size_t i = 0; i < want.size(); ++i) {
+        if (got[i] != want[i]) { fail(at(name, count, i, got[i], want[i])); return false; }
+    }
+    return true;
+}
+
+// 每个可用的 RAW10 内核（通用与解析计划取到的版本）对标量参考，组数 0..kMaxGroups 逐一覆盖，
+// 让各级主循环的进入条件与交给下一级的余数都被走到；再加上定长特化的 256 组
+void test_raw10_kernels() {
+    constexpr int kMaxGroups = 300;
+    std::mt19937 rng(10);
+    std::vector<int> counts;
+    for (int g = 0; g <= kMaxGroups; ++g) counts.push_back(g);
+    counts.push_back(1024);
+
+    const std::string dflt = unpack_kernel_name();
+    for (const char* k : available_unpack_kernels()) {
+        if (!select_unpack_kernel(k)) { fail(std::string("select_unpack_kernel ") + k); continue; }
+        for (int groups : counts) {
+            std::vector<uint8_t> in(static_cast<size_t>(groups) * 5);
+            for (auto& b : in) b = static_cast<uint8_t>(rng());
+            std::vector<uint16_t> want(static_cast<size_t>(groups) * 4), got(want.size(), 0xDEAD);
+            unpack_raw10_scalar(in.data(), groups, want.data());
+
+            unpack_raw10(in.data(), groups, got.data());
+            same((std::string("unpack_raw10/") + k).c_str(), groups, got, want);
+
+            bool fixed = false;
+            const UnpackKernel plan = raw10_plan_kernel(groups, &fixed);
+            std::fill(got.begin(), got.end(), 0xDEAD);
+            plan(in.data(), groups, got.data());
+            same((std::string("raw10_plan_kernel/") + k + (fixed ? "/fixed" : "")).c_str(), groups, got, want);
+        }
+    }
+    select_unpack_kernel(dflt.c_str());
+}
+
+// 随机样本（截到格式位宽）→ pack_payload → 通用解包、标量解包与解析计划各解一遍，须还原出原样本
+void test_round_trip() {
+    const PackMode modes[] = {PackMode::RAW10_PACKED, PackMode::RAW12_PACKED, PackMode::RAW14_PACKED,
+                              PackMode::MIPI_RAW10, PackMode::MIPI_RAW12, PackMode::RAW16_LE, PackMode::RAW16_BE};
+    std::mt19937 rng(16);
+    const ParserConfig saved = g_cfg;
+    for (PackMode m : modes) {
+        const PackGeometry geo = pack_geometry(m);
+        for (int groups : {1, 2, 3, 7, 64, 255, 256, 257, 1024}) {
+            const int samples = groups * geo.group_samples;
+            const ParserConfig cfg = parser_config_for(m, samples, 8, 3);
+            std::string why;
+            if (!validate_parser_config(cfg, why)) { fail(std::string(pack_mode_name(m)) + ": " + why); continue; }
+
+            const uint32_t mask = (1u << geo.bits) - 1u;
+            std::vector<uint16_t> want(static_cast<size_t>(samples));
+            for (auto& v : want) v = static_cast<uint16_t>(rng() & mask);
+            std::vector<uint8_t> payload(static_cast<size_t>(cfg.payload_bytes));
+            if (!pack_payload(want.data(), payload.data(), cfg)) { fail(std::string("pack_payload ") + pack_mode_name(m)); continue; }
+
+            const std::string name = pack_mode_name(m);
+            std::vector<uint16_t> got(want.size(), 0xDEAD);
+            g_cfg = cfg;
+            if (!unpack_payload(payload.data(), got.data())) fail("unpack_payload " + name);
+            else same(("unpack_payload/" + name).c_str(), samples, got, want);
+
+            std::fill(got.begin(), got.end(), 0xDEAD);
+            if (!unpack_payload_scalar(payload.data(), got.data())) fail("unpack_payload_scalar " + name);
+            else same(("unpack_payload_scalar/" + name).c_str(), samples, got, want);
+
+            ParserPlan plan;
+            if (!make_parser_plan(cfg, plan, why)) { fail("make_parser_plan " + name + ": " + why); continue; }
+            std::fill(got.begin(), got.end(), 0xDEAD);
+            plan.unpack(payload.data(), got.data());
+            same(("plan/" + name + "/" + plan.kernel_name).c_str(), samples, got, want);
+        }
+    }
+    g_cfg = saved;
+}
+
+} // namespace
+
+int main() {
+    test_raw10_kernels();
+    test_round_trip();
+    if (g_failures) {
+        std::fprintf(stderr, "%d failure(s)\n", g_failures);
+        return 1;
+    }
+    std::printf("unpack_test: ok (kernels: ");
+    const std::vector<const char*> ks = available_unpack_kernels();
+    for (size_t i = 0; i < ks.size(); ++i) std::printf("%s%s", i ? ", " : "", ks[i]);
+    std::printf(")\n");
+    return 0;
+}
@@ -0,0 +1,214 @@
+// udpscope_loopback：生成器 → 本机回环 → 抓包路径 → 主环 的端到端吞吐/延迟测试
+//
+//   udpscope_loopback [--backend udp|pcap|tpacket] [--if lo] [--port 2827] [--rx-threads N]
+//                     [--pack raw10] [--spf 1024] [--rate 20000] [--duration 5] [--batch 32]
+//                     [--ring-frames 262144]
+//
+// 同一进程内：发送线程用 COUNTER 波形发帧并记下每批的发送时刻，PcapWorker 按所选后端收包写主环，
+// 观察线程忙轮询主环，从样本还原帧号，得到
+//   send→ring     调用 sendmmsg 到帧在主环可见（整条路径）
+//   capture→ring  内核抓包时间戳到环内可见（用户态解析/重排/合并部分）
+// 的分位数。结果 JSON 输出到 stdout，进度到 stderr。
+
+#include "FrameGenerator.hpp"
+#include "PcapWorker.hpp"
+
+#include <QCoreApplication>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int64_t realtime_ns() {
+    timespec ts{};
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+struct Percentiles {
+    size_t n = 0;
+    double p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0; // 微秒
+};
+
+Percentiles percentiles(std::vector<int64_t>& v) {
+    Percentiles p;
+    p.n = v.size();
+    if (v.empty()) return p;
+    std::sort(v.begin(), v.end());
+    auto at = [&](double q) { return double(v[std::min(v.size() - 1, static_cast<size_t>(q * double(v.size())))]) / 1e3; };
+    p.p50 = at(0.50); p.p90 = at(0.90); p.p99 = at(0.99); p.p999 = at(0.999);
+    p.max = double(v.back()) / 1e3;
+    return p;
+}
+
+void print_percentiles(const char* name, const Percentiles& p, bool last) {
+    std::printf("    \"%s\": {\"samples\": %zu, \"p50_us\": %.1f, \"p90_us\": %.1f, \"p99_us\": %.1f, "
+                "\"p999_us\": %.1f, \"max_us\": %.1f}%s\n",
+                name, p.n, p.p50, p.p90, p.p99, p.p999, p.max, last ? "" : ",");
+}
+
+int usage(const char* argv0) {
+    std::fprintf(stderr,
+        "usage: %s [--backend udp|pcap|tpacket] [--if IFNAME] [--port N] [--rx-threads N]\n"
+        "          [--pack MODE] [--spf N] [--rate FPS] [--duration SEC] [--batch N] [--ring-frames N]\n",
+        argv0);
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+
+    CaptureConfig cap;
+    cap.backend = CaptureBackend::UDP_SOCKET;
+    std::snprintf(cap.ifname, sizeof(cap.ifname), "lo");
+    std::snprintf(cap.bind_addr, sizeof(cap.bind_addr), "127.0.0.1");
+    SenderOptions snd;
+    PackMode pack = PackMode::RAW10_PACKED;
+    int spf = 1024;
+    double duration = 5.0;
+    size_t ring_frames = 1 << 18;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const bool has = i + 1 < argc;
+        if      (a == "--if" && has)          std::snprintf(cap.ifname, sizeof(cap.ifname), "%s", argv[++i]);
+        else if (a == "--port" && has)        snd.dst_port = std::atoi(argv[++i]);
+        else if (a == "--rx-threads" && has)  cap.rx_threads = std::atoi(argv[++i]);
+        else if (a == "--spf" && has)         spf = std::atoi(argv[++i]);
+        else if (a == "--rate" && has)        snd.rate_fps = std::atof(argv[++i]);
+        else if (a == "--duration" && has)    duration = std::atof(argv[++i]);
+        else if (a == "--batch" && has)       snd.batch = std::atoi(argv[++i]);
+        else if (a == "--ring-frames" && has) ring_frames = std::strtoull(argv[++i], nullptr, 10);
+        else if (a == "--pack" && has) {
+            if (!pack_mode_from_name(argv[++i], pack)) { std::fprintf(stderr, "unknown pack mode: %s\n", argv[i]); return 2; }
+        } else if (a == "--backend" && has) {
+            const std::string b = argv[++i];
+            if      (b == "udp")     cap.backend = CaptureBackend::UDP_SOCKET;
+            else if (b == "pcap")    cap.backend = CaptureBackend::PCAP;
+            else if (b == "tpacket") cap.backend = CaptureBackend::TPACKET_V3;
+            else return usage(argv[0]);
+        } else return usage(argv[0]);
+    }
+    cap.bind_port = snd.dst_port;
+    cap.promisc   = false;
+    std::snprintf(cap.bpf, sizeof(cap.bpf), "udp and dst port %d", snd.dst_port);
+
+    // 收发两端用同一帧格式；头部偏移 0 放 4 字节序号，丢包/乱序由 RuntimeStats 的 seq_* 给出
+    ParserConfig cfg = parser_config_for(pack, spf, 8, 11);
+    cfg.seq_offset = 0;
+    cfg.seq_bytes  = 4;
+    std::string why;
+    if (!validate_parser_config(cfg, why)) { std::fprintf(stderr, "invalid frame config: %s\n", why.c_str()); return 2; }
+    g_cfg = cfg;
+
+    GeneratorConfig gcfg;
+    gcfg.waveform = GenWaveform::COUNTER;
+    FrameGenerator gen(cfg, gcfg);
+    if (!gen.ok(why)) { std::fprintf(stderr, "invalid frame config: %s\n", why.c_str()); return 2; }
+
+    RingOptions ro;
+    ro.enable_pyramid = false;
+    DecodedFrameRing ring(ring_frames, ro);
+    RuntimeStats stats;
+    PcapWorker worker(ring, cap, stats);
+    std::atomic<bool> failed{false};
+    QObject::connect(&worker, &PcapWorker::errorOccurred, [&](const QString& msg) {
+        std::fprintf(stderr, "capture error: %s\n", msg.toStdString().c_str());
+        failed = true;
+    });
+    worker.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200)); // 等套接字/环就绪
+    if (failed) return 1;
+
+    // 帧号 → 发送时刻；按 2 的幂取模，环绕前帧早已被观察线程看到
+    constexpr size_t kSendSlots = size_t(1) << 20;
+    std::vector<std::atomic<int64_t>> send_ns(kSendSlots);
+
+    std::atomic<bool> observing{true};
+    std::vector<int64_t> lat_send, lat_capture;
+    uint64_t observed = 0, overrun = 0;
+    std::thread observer([&] {
+        const size_t est = static_cast<size_t>(std::max(0.0, snd.rate_fps * duration)) + 1024;
+        lat_send.reserve(est);
+        lat_capture.reserve(est);
+        std::vector<uint16_t> frame(static_cast<size_t>(spf));
+        uint64_t r = ring.snapshot_write_index();
+        while (observing.load(std::memory_order_relaxed)) {
+            const uint64_t w = ring.snapshot_write_index();
+            if (w == r) { std::this_thread::yield(); continue; }
+            const int64_t now = realtime_ns();
+            if (w - r > ring.capacity()) { overrun += w - r - ring.capacity(); r = w - ring.capacity(); }
+            for (; r < w; ++r) {
+                ring.read_frame(r, frame.data());
+                const uint64_t idx  = FrameGenerator::decode_counter(frame.data(), cfg);
+                const int64_t  sent = send_ns[idx & (kSendSlots - 1)].load(std::memory_order_relaxed);
+                if (sent > 0 && sent <= now) lat_send.push_back(now - sent);
+                lat_capture.push_back(now - ring.timestamp_ns(r));
+                ++observed;
+            }
+        }
+    });
+
+    std::fprintf(stderr, "%s x%d, %d bytes/frame, %s, %.1f s\n", pack_mode_name(pack), spf, cfg.frame_size_bytes,
+                 snd.rate_fps > 0 ? (std::to_string(static_cast<long long>(snd.rate_fps)) + " fps").c_str() : "max rate",
+                 duration);
+
+    std::atomic<bool> sending{true};
+    std::thread timer([&] {
+        const auto until = std::chrono::steady_clock::now() + std::chrono::duration<double>(duration);
+        while (sending && std::chrono::steady_clock::now() < until) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        sending = false;
+    });
+    SenderStats sst;
+    const bool sent_ok = run_udp_sender(gen, snd, sending, sst, why, [&](uint64_t first, int n, int64_t ts) {
+        for (int i = 0; i < n; ++i) send_ns[(first + i) & (kSendSlots - 1)].store(ts, std::memory_order_relaxed);
+    });
+    sending = false;
+    timer.join();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300)); // 让在途的帧落进环
+    worker.stop();
+    observing = false;
+    observer.join();
+    if (!sent_ok) { std::fprintf(stderr, "sender: %s\n", why.c_str()); return 1; }
+
+    const uint64_t sent     = sst.frames_sent.load();
+    const uint64_t received = stats.frames_rx.load();
+    const double   secs     = double(sst.wall_ns.load()) / 1e9;
+    const double   lost     = sent > received ? double(sent - received) : 0.0;
+    const Percentiles ps = percentiles(lat_send);
+    const Percentiles pc = percentiles(lat_capture);
+
+    std::printf("{\n");
+    std::printf("  \"backend\": \"%s\",\n", cap.backend == CaptureBackend::UDP_SOCKET ? "udp"
+                                          : cap.backend == CaptureBackend::TPACKET_V3 ? "tpacket" : "pcap");
+    std::printf("  \"pack\": \"%s\", \"samples_per_frame\": %d, \"frame_bytes\": %d,\n",
+                pack_mode_name(pack), spf, cfg.frame_size_bytes);
+    std::printf("  \"target_fps\": %.0f, \"seconds\": %.3f,\n", snd.rate_fps, secs);
+    std::printf("  \"frames_sent\": %llu, \"send_errors\": %llu, \"frames_rx\": %llu, \"frames_observed\": %llu,\n",
+                static_cast<unsigned long long>(sent), static_cast<unsigned long long>(sst.send_errors.load()),
+                static_cast<unsigned long long>(received), static_cast<unsigned long long>(observed));
+    std::printf("  \"sustained_fps\": %.0f, \"drop_rate\": %.6f,\n",
+                secs > 0 ? double(received) / secs : 0.0, sent ? lost / double(sent) : 0.0);
+    std::printf("  \"drops\": {\"parse\": %llu, \"size\": %llu, \"kernel\": %llu, "
+                "\"seq_lost\": %llu, \"seq_reordered\": %llu, \"observer_overrun\": %llu},\n",
+                static_cast<unsigned long long>(stats.drop_parse.load()),
+                static_cast<unsigned long long>(stats.drop_size.load()),
+                static_cast<unsigned long long>(stats.kernel_drops.load()),
+                static_cast<unsigned long long>(stats.seq_lost.load()),
+                static_cast<unsigned long long>(stats.seq_reordered.load()),
+                static_cast<unsigned long long>(overrun));
+    std::printf("  \"latency\": {\n");
+    print_percentiles("send_to_ring", ps, false);
+    print_percentiles("capture_to_ring", pc, true);
+    std::printf("  }\n}\n");
+    return 0;
+}